@@ -0,0 +1,417 @@
+// ============================================================================
+// libraw — connection pool, pipelining and batching (see raw.h)
+// ============================================================================
+#define _GNU_SOURCE
+#include "raw.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RAW_OUT_BUF 65536           // queued requests per connection
+#define RAW_IN_BUF 16384            // > any server reply (MSG_LEN_CAP + 16)
+
+enum conn_state { CONN_DOWN, CONN_CONNECTING, CONN_UP };
+
+struct pending {
+    raw_callback cb;
+    void *arg;
+    uint64_t deadline_ms;           // 0 = none
+};
+
+struct rconn {
+    int fd;
+    int state;                      // enum conn_state
+    uint64_t since_ms;              // connect started / went down
+    unsigned head, tail;            // pending requests, free-running (ring: & mask)
+    struct pending *ring;
+    size_t out_off, out_len;
+    size_t in_len;
+    char out[RAW_OUT_BUF];
+    char in[RAW_IN_BUF];
+};
+
+struct raw_client {
+    struct sockaddr_in addr;
+    struct raw_options o;
+    int epfd;
+    unsigned next;                  // where the least-loaded scan starts
+    unsigned fired;                 // callbacks run, for raw_poll()'s result
+    unsigned mask;                  // ring slots - 1: a power of two >= max_inflight
+    char end[2];                    // request terminator
+    size_t end_len;
+    char term;                      // reply terminator
+    struct raw_client_stats st;
+    struct rconn *conns;
+};
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static void complete(struct raw_client *rc, struct pending *p, int status,
+                     const char *reply, size_t len) {
+    if (status == RAW_OK) {
+        rc->st.replies++;
+    } else {
+        rc->st.failures++;
+    }
+    rc->fired++;
+    p->cb(p->arg, status, reply, len);
+}
+
+// ============================================================================
+// Connections
+// ============================================================================
+static int conn_open(struct raw_client *rc, struct rconn *c) {
+    c->since_ms = now_ms();
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0) return -1;
+    if (rc->o.nodelay) {
+        int one = 1;
+        setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    // Edge-triggered in both directions, like the server's cluster links: no
+    // epoll_ctl as the connection's state changes, reads and writes go to
+    // EAGAIN instead.
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLET,
+                             .data.u64 = (uint64_t)(c - rc->conns)};
+    if ((connect(c->fd, (const struct sockaddr *)&rc->addr, sizeof(rc->addr)) < 0 &&
+         errno != EINPROGRESS) ||
+        epoll_ctl(rc->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+    c->state = CONN_CONNECTING;
+    c->in_len = c->out_off = c->out_len = 0;
+    rc->st.connects++;
+    return 0;
+}
+
+// Closes c and completes everything in flight on it: with RAW_ETIMEDOUT
+// where the request's deadline has passed, 'status' otherwise.
+static void conn_fail(struct raw_client *rc, struct rconn *c, int status) {
+    close(c->fd);
+    c->fd = -1;
+    c->state = CONN_DOWN;
+    c->since_ms = now_ms();
+    c->in_len = c->out_off = c->out_len = 0;
+    rc->st.conn_failures++;
+
+    // Callbacks may queue new requests (on other connections, or on this one
+    // once retry_ms is 0): only fail the ones that were here before.
+    unsigned end = c->tail;
+    while (c->head != end) {
+        struct pending p = c->ring[c->head++ & rc->mask];
+        int st = p.deadline_ms && p.deadline_ms <= c->since_ms ? RAW_ETIMEDOUT : status;
+        complete(rc, &p, st, NULL, 0);
+    }
+}
+
+// Sends queued output until done or EAGAIN. Returns -1 on a socket error.
+static int conn_write(struct raw_client *rc, struct rconn *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        rc->st.writes++;
+        c->out_off += (size_t)n;
+    }
+    c->out_off = c->out_len = 0;
+    return 0;
+}
+
+// Reads to EAGAIN and completes one request per reply line. Returns -1 when
+// the connection must be failed.
+static int conn_read(struct raw_client *rc, struct rconn *c) {
+    for (;;) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, RAW_IN_BUF - c->in_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        if (n == 0) {
+            // Closed by the server. Between requests that is just an idle
+            // close: reopen on demand, without waiting out retry_ms.
+            if (c->head != c->tail || c->in_len > 0) return -1;
+            close(c->fd);
+            c->fd = -1;
+            c->state = CONN_DOWN;
+            c->since_ms = 0;
+            return 0;
+        }
+        c->in_len += (size_t)n;
+
+        char *p = c->in, *end = c->in + c->in_len, *e;
+        while ((e = memchr(p, rc->term, (size_t)(end - p)))) {
+            if (c->head == c->tail) return -1;      // a reply nobody asked for
+            size_t len = (size_t)(e - p);
+            if (rc->o.delimiter == RAW_DELIM_CRLF && len > 0 && p[len - 1] == '\r') len--;
+            // Pop first: the callback may queue the next request here.
+            struct pending pd = c->ring[c->head++ & rc->mask];
+            complete(rc, &pd, RAW_OK, p, len);
+            p = e + 1;
+        }
+        c->in_len = (size_t)(end - p);
+        memmove(c->in, p, c->in_len);
+        if (c->in_len == RAW_IN_BUF) return -1;    // longer than any reply
+    }
+}
+
+static void conn_event(struct raw_client *rc, struct rconn *c, uint32_t events) {
+    if (c->state == CONN_CONNECTING) {
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err) {
+            conn_fail(rc, c, RAW_ECONN);
+            return;
+        }
+        c->state = CONN_UP;
+    }
+    if (c->state == CONN_UP && conn_write(rc, c) < 0) {
+        conn_fail(rc, c, RAW_ECONN);
+        return;
+    }
+    if (c->state == CONN_UP && (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+        conn_read(rc, c) < 0) {
+        conn_fail(rc, c, RAW_ECONN);
+    }
+}
+
+// Fails connections whose connect or oldest request is overdue. Returns the
+// milliseconds until the next such deadline, or -1 if there is none.
+static int expire(struct raw_client *rc) {
+    uint64_t now = now_ms(), next = UINT64_MAX;
+    for (int i = 0; i < rc->o.pool_size; i++) {
+        struct rconn *c = &rc->conns[i];
+        uint64_t due = UINT64_MAX;
+        if (c->state == CONN_CONNECTING) {
+            due = c->since_ms + (uint64_t)rc->o.connect_timeout_ms;
+        }
+        if (c->state != CONN_DOWN && c->head != c->tail) {
+            // The oldest request has the earliest deadline.
+            uint64_t d = c->ring[c->head & rc->mask].deadline_ms;
+            if (d && d < due) due = d;
+        }
+        if (due <= now) {
+            conn_fail(rc, c, c->state == CONN_CONNECTING ? RAW_ECONN : RAW_ETIMEDOUT);
+        } else if (due < next) {
+            next = due;
+        }
+    }
+    return next == UINT64_MAX ? -1 : (int)(next - now);
+}
+
+// ============================================================================
+// API
+// ============================================================================
+void raw_options_init(struct raw_options *o) {
+    o->pool_size = 4;
+    o->max_inflight = 64;
+    o->connect_timeout_ms = 1000;
+    o->request_timeout_ms = 1000;
+    o->retry_ms = 100;
+    o->delimiter = RAW_DELIM_LF;
+    o->nodelay = 1;
+}
+
+struct raw_client *raw_client_new(const char *addr, const struct raw_options *o) {
+    char ip[64];
+    const char *colon = strrchr(addr, ':');
+    struct sockaddr_in sa = {.sin_family = AF_INET};
+    long port = colon ? strtol(colon + 1, NULL, 10) : 0;
+    if (!colon || (size_t)(colon - addr) >= sizeof(ip) || port <= 0 || port > 65535) {
+        errno = EINVAL;
+        return NULL;
+    }
+    memcpy(ip, addr, (size_t)(colon - addr));
+    ip[colon - addr] = '\0';
+    if (inet_pton(AF_INET, ip, &sa.sin_addr) != 1) {
+        errno = EINVAL;
+        return NULL;
+    }
+    sa.sin_port = htons((uint16_t)port);
+
+    struct raw_options opts;
+    if (o) {
+        opts = *o;
+    } else {
+        raw_options_init(&opts);
+    }
+    if (opts.pool_size < 1 || opts.max_inflight < 1 || opts.connect_timeout_ms < 1 ||
+        opts.request_timeout_ms < 0 || opts.retry_ms < 0 || opts.delimiter < RAW_DELIM_LF ||
+        opts.delimiter > RAW_DELIM_NUL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct raw_client *rc = calloc(1, sizeof(*rc));
+    if (!rc) return NULL;
+    rc->addr = sa;
+    rc->o = opts;
+    switch (opts.delimiter) {
+    case RAW_DELIM_LF: memcpy(rc->end, "\n", 1); rc->end_len = 1; rc->term = '\n'; break;
+    case RAW_DELIM_CRLF: memcpy(rc->end, "\r\n", 2); rc->end_len = 2; rc->term = '\n'; break;
+    default: rc->end[0] = '\0'; rc->end_len = 1; rc->term = '\0'; break;
+    }
+    // The counters wrap at 2^32, which only a power-of-two ring survives.
+    while (rc->mask + 1 < (unsigned)opts.max_inflight) rc->mask = rc->mask << 1 | 1;
+    rc->epfd = epoll_create1(EPOLL_CLOEXEC);
+    rc->conns = calloc((size_t)opts.pool_size, sizeof(*rc->conns));
+    // Before any failure path: raw_client_free() must not close fd 0.
+    for (int i = 0; rc->conns && i < opts.pool_size; i++) rc->conns[i].fd = -1;
+    if (rc->epfd < 0 || !rc->conns) goto fail;
+    for (int i = 0; i < opts.pool_size; i++) {
+        struct rconn *c = &rc->conns[i];
+        c->ring = calloc((size_t)rc->mask + 1, sizeof(*c->ring));
+        if (!c->ring) goto fail;
+        if (conn_open(rc, c) < 0) c->state = CONN_DOWN;     // retried on demand
+    }
+    return rc;
+fail:
+    raw_client_free(rc);                // keeps epoll_create1()'s or calloc()'s errno
+    return NULL;
+}
+
+void raw_client_free(struct raw_client *rc) {
+    if (!rc) return;
+    int saved = errno;
+    for (int i = 0; rc->conns && i < rc->o.pool_size; i++) {
+        if (rc->conns[i].fd >= 0) close(rc->conns[i].fd);
+        free(rc->conns[i].ring);
+    }
+    free(rc->conns);
+    if (rc->epfd >= 0) close(rc->epfd);
+    free(rc);
+    errno = saved;
+}
+
+int raw_send(struct raw_client *rc, const char *msg, size_t len, raw_callback cb, void *arg) {
+    // A delimiter inside msg would make the server answer twice and shift
+    // every later reply onto the wrong request.
+    if (len > RAW_MSG_MAX || memchr(msg, rc->term, len) ||
+        (rc->o.delimiter == RAW_DELIM_LF && memchr(msg, '\r', len))) {
+        return RAW_EINVAL;
+    }
+
+    // Least-loaded connection with room, starting after the last pick so
+    // ties rotate. Connections that are down are reopened once retry_ms has
+    // passed.
+    uint64_t now = now_ms();
+    unsigned n = (unsigned)rc->o.pool_size, depth = (unsigned)rc->o.max_inflight;
+    struct rconn *best = NULL;
+    int full = 0;
+    for (unsigned k = 0; k < n; k++) {
+        struct rconn *c = &rc->conns[(rc->next + k) % n];
+        if (c->state == CONN_DOWN) {
+            if (now - c->since_ms < (uint64_t)rc->o.retry_ms || conn_open(rc, c) < 0) continue;
+        }
+        if (c->tail - c->head == depth || RAW_OUT_BUF - c->out_len < len + rc->end_len) {
+            full = 1;
+            continue;
+        }
+        if (!best || c->tail - c->head < best->tail - best->head) best = c;
+        if (best->tail == best->head) break;
+    }
+    if (!best) return full ? RAW_EBUSY : RAW_EUNAVAIL;
+    rc->next = (unsigned)(best - rc->conns) + 1;
+
+    memcpy(best->out + best->out_len, msg, len);
+    memcpy(best->out + best->out_len + len, rc->end, rc->end_len);
+    best->out_len += len + rc->end_len;
+    struct pending *p = &best->ring[best->tail++ & rc->mask];
+    p->cb = cb;
+    p->arg = arg;
+    p->deadline_ms = rc->o.request_timeout_ms ? now + (uint64_t)rc->o.request_timeout_ms : 0;
+    rc->st.requests++;
+    return 0;
+}
+
+void raw_flush(struct raw_client *rc) {
+    for (int i = 0; i < rc->o.pool_size; i++) {
+        struct rconn *c = &rc->conns[i];
+        if (c->state == CONN_UP && c->out_len > c->out_off && conn_write(rc, c) < 0) {
+            conn_fail(rc, c, RAW_ECONN);
+        }
+    }
+}
+
+int raw_poll(struct raw_client *rc, int timeout_ms) {
+    unsigned fired = rc->fired;
+    raw_flush(rc);
+    int due = expire(rc);
+    if (due >= 0 && (timeout_ms < 0 || due < timeout_ms)) timeout_ms = due;
+    if (rc->fired != fired) timeout_ms = 0;     // something to report already
+
+    struct epoll_event evs[64];
+    int n = epoll_wait(rc->epfd, evs, 64, timeout_ms);
+    if (n < 0 && errno != EINTR) return -1;
+    for (int i = 0; i < n; i++) {
+        struct rconn *c = &rc->conns[evs[i].data.u64];
+        if (c->fd >= 0) conn_event(rc, c, evs[i].events);
+    }
+    expire(rc);
+    raw_flush(rc);                              // what the callbacks queued
+    return (int)(rc->fired - fired);
+}
+
+int raw_fd(const struct raw_client *rc) {
+    return rc->epfd;
+}
+
+struct call {
+    int done, status;
+    char *reply;
+    size_t cap, len;
+};
+
+static void call_done(void *arg, int status, const char *reply, size_t len) {
+    struct call *k = arg;
+    k->done = 1;
+    k->status = status;
+    k->len = len;
+    if (status != RAW_OK) return;
+    if (len > k->cap) {
+        k->status = RAW_ETOOLONG;
+        len = k->cap;
+    }
+    memcpy(k->reply, reply, len);
+}
+
+int raw_call(struct raw_client *rc, const char *msg, size_t len, char *reply, size_t cap,
+             size_t *reply_len) {
+    struct call k = {0, 0, reply, cap, 0};
+    int st = raw_send(rc, msg, len, call_done, &k);
+    if (st < 0) return st;
+    while (!k.done) {
+        if (raw_poll(rc, -1) < 0) return RAW_ECONN;
+    }
+    if (reply_len) *reply_len = k.len;
+    return k.status;
+}
+
+void raw_client_stats(const struct raw_client *rc, struct raw_client_stats *st) {
+    *st = rc->st;
+}
+
+const char *raw_strerror(int status) {
+    switch (status) {
+    case RAW_OK: return "ok";
+    case RAW_ETIMEDOUT: return "timed out";
+    case RAW_ECONN: return "connection failed";
+    case RAW_EBUSY: return "all connections busy";
+    case RAW_EUNAVAIL: return "no connection available";
+    case RAW_EINVAL: return "invalid request";
+    case RAW_ETOOLONG: return "reply too long";
+    default: return "unknown error";
+    }
+}
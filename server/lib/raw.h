@@ -0,0 +1,112 @@
+#ifndef RAW_CLIENT_H
+#define RAW_CLIENT_H
+
+// ============================================================================
+// libraw — C client for raw_server
+// ----------------------------------------------------------------------------
+// A client object owns a small pool of keepalive connections to one server
+// (server keepalive = 1) and runs them from its own epoll set:
+//
+//   raw_send()   queues one request on the least-loaded connection and
+//                returns at once; its callback fires when the reply line
+//                arrives, fails, or times out. Requests are pipelined up to
+//                max_inflight per connection, and replies match requests by
+//                order, as the server answers them.
+//   raw_poll()   writes everything queued since the last call (one send() per
+//                connection, however many requests that is), waits up to
+//                timeout_ms for replies and runs their callbacks. raw_fd()
+//                is the epoll fd, for embedding in an outer event loop.
+//   raw_call()   blocking round trip on top of the two.
+//
+// Failures never surface as a stuck pipeline: a connection that errors, is
+// closed by the server, or has a request older than request_timeout_ms is
+// closed, everything on it completes with an error, and it is reopened on
+// demand after retry_ms. A server-side close with nothing in flight (idle
+// timeout, keepalive = 0) is not a failure: the connection reopens on the
+// next request.
+//
+// A client is not thread-safe: use one per thread, as raw_bench does.
+// Callbacks run inside raw_poll(), raw_flush() and raw_call(), never inside
+// raw_send(); they may call raw_send() but not raw_client_free().
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest request raw_send() accepts (the server's MSG_LEN_CAP).
+#define RAW_MSG_MAX 4096
+
+enum raw_status {
+    RAW_OK = 0,
+    RAW_ETIMEDOUT = -1,             // no reply within request_timeout_ms
+    RAW_ECONN = -2,                 // connection failed or closed first
+    RAW_EBUSY = -3,                 // raw_send: every connection is full
+    RAW_EUNAVAIL = -4,              // raw_send: no connection up or due a retry
+    RAW_EINVAL = -5,                // raw_send: too long or holds a delimiter
+    RAW_ETOOLONG = -6,              // raw_call: reply did not fit the buffer
+};
+
+// Must match the server's delimiter key.
+enum raw_delimiter {
+    RAW_DELIM_LF,                   // requests must not contain '\n' or '\r'
+    RAW_DELIM_CRLF,
+    RAW_DELIM_NUL,
+};
+
+struct raw_options {
+    int pool_size;                  // connections (default 4)
+    int max_inflight;               // pipelined requests per connection (64)
+    int connect_timeout_ms;         // (1000)
+    int request_timeout_ms;         // send to reply, 0 = none (1000)
+    int retry_ms;                   // before reopening a failed connection (100)
+    int delimiter;                  // enum raw_delimiter (RAW_DELIM_LF)
+    int nodelay;                    // TCP_NODELAY (1)
+};
+
+struct raw_client_stats {
+    uint64_t requests;              // accepted by raw_send()
+    uint64_t replies;               // completed with RAW_OK
+    uint64_t failures;              // completed with an error
+    uint64_t writes;                // send() calls: requests / writes = batching
+    uint64_t connects;
+    uint64_t conn_failures;
+};
+
+// status is RAW_OK or a negative enum raw_status; reply is only valid during
+// the call and excludes the delimiter.
+typedef void (*raw_callback)(void *arg, int status, const char *reply, size_t len);
+
+struct raw_client;
+
+void raw_options_init(struct raw_options *o);
+
+// addr is "A.B.C.D:port"; o may be NULL for the defaults. Starts connecting
+// the whole pool. Returns NULL with errno set on failure.
+struct raw_client *raw_client_new(const char *addr, const struct raw_options *o);
+
+// Closes every connection. Callbacks of requests still in flight do not run.
+void raw_client_free(struct raw_client *rc);
+
+// Queues msg (without its delimiter). Returns 0, or a negative enum
+// raw_status, in which case cb will not be called.
+int raw_send(struct raw_client *rc, const char *msg, size_t len, raw_callback cb, void *arg);
+
+// Writes queued requests now instead of at the next raw_poll().
+void raw_flush(struct raw_client *rc);
+
+// Flushes, waits up to timeout_ms (-1 = until something happens) and
+// processes replies and timeouts. Returns the number of callbacks run, or -1
+// with errno set if epoll_wait() failed.
+int raw_poll(struct raw_client *rc, int timeout_ms);
+
+int raw_fd(const struct raw_client *rc);
+
+// Sends msg and waits for its reply, copied to reply[0, cap). Returns
+// RAW_OK with *reply_len set, or a negative enum raw_status.
+int raw_call(struct raw_client *rc, const char *msg, size_t len, char *reply, size_t cap,
+             size_t *reply_len);
+
+void raw_client_stats(const struct raw_client *rc, struct raw_client_stats *st);
+
+// "ok", "timed out", ...
+const char *raw_strerror(int status);
+
+#endif
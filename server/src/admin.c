@@ -0,0 +1,257 @@
+// ============================================================================
+// Admin listener and command dispatch
+// ----------------------------------------------------------------------------
+// Connections are served one at a time on a dedicated thread. Each command
+// writes its reply through a stdio stream wrapped around the connected socket,
+// which keeps handlers as simple as fprintf() while still batching the output
+// into large send() calls.
+#define _GNU_SOURCE
+#include "admin.h"
+#include "cluster.h"
+#include "config.h"
+#include "flight.h"
+#include "io.h"
+#include "journal.h"
+#include "kv.h"
+#include "prof.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define ADMIN_LINE_MAX 256
+#define ADMIN_RECV_TIMEOUT_SEC 5
+
+// The config as of the current command's accept: commands read this copy, so
+// the thread is offline (never delays a reload) while one runs.
+static struct raw_config cmd_cfg;
+
+struct admin_cmd {
+    const char *name;
+    const char *usage;
+    void (*run)(FILE *out, char *args);
+};
+
+static void cmd_help(FILE *out, char *args);
+static void cmd_config(FILE *out, char *args);
+static void cmd_profile(FILE *out, char *args);
+static void cmd_stats(FILE *out, char *args);
+static void cmd_workers(FILE *out, char *args);
+static void cmd_journal(FILE *out, char *args);
+static void cmd_kv(FILE *out, char *args);
+static void cmd_snapshot(FILE *out, char *args);
+static void cmd_cluster(FILE *out, char *args);
+static void cmd_tcpinfo(FILE *out, char *args);
+static void cmd_trace(FILE *out, char *args);
+static void cmd_flight(FILE *out, char *args);
+
+static const struct admin_cmd admin_cmds[] = {
+    {"HELP", "HELP", cmd_help},
+    {"CONFIG", "CONFIG", cmd_config},
+    {"PROFILE", "PROFILE [secs] [hz]", cmd_profile},
+    {"STATS", "STATS", cmd_stats},
+    {"WORKERS", "WORKERS", cmd_workers},
+    {"JOURNAL", "JOURNAL", cmd_journal},
+    {"KV", "KV", cmd_kv},
+    {"SNAPSHOT", "SNAPSHOT", cmd_snapshot},
+    {"CLUSTER", "CLUSTER", cmd_cluster},
+    {"TCPINFO", "TCPINFO", cmd_tcpinfo},
+    {"TRACE", "TRACE", cmd_trace},
+    {"FLIGHT", "FLIGHT", cmd_flight},
+};
+
+#define ADMIN_NCMDS (sizeof(admin_cmds) / sizeof(admin_cmds[0]))
+
+// ============================================================================
+// Commands
+// ============================================================================
+static void cmd_help(FILE *out, char *args) {
+    (void)args;
+    for (size_t i = 0; i < ADMIN_NCMDS; i++) {
+        fprintf(out, "%s\n", admin_cmds[i].usage);
+    }
+}
+
+static void cmd_config(FILE *out, char *args) {
+    (void)args;
+    config_dump(&cmd_cfg, out);
+}
+
+static void cmd_profile(FILE *out, char *args) {
+    unsigned secs = 0, hz = 0;
+    char *end;
+    char *tok = strtok_r(args, " \t", &end);
+    if (tok) secs = (unsigned)strtoul(tok, NULL, 10);
+    tok = strtok_r(NULL, " \t", &end);
+    if (tok) hz = (unsigned)strtoul(tok, NULL, 10);
+
+    printf("🔬  profiling for %us at %u Hz (admin request)\n",
+           secs ? secs : PROF_DEFAULT_SECS, hz ? hz : PROF_DEFAULT_HZ);
+    if (prof_run(out, secs, hz) < 0) {
+        fprintf(out, "ERR profile: %s\n", strerror(errno));
+    }
+}
+
+static void cmd_stats(FILE *out, char *args) {
+    (void)args;
+    stats_dump(out, &cmd_cfg);
+}
+
+static void cmd_workers(FILE *out, char *args) {
+    (void)args;
+    io_current()->dump(out);
+}
+
+static void cmd_journal(FILE *out, char *args) {
+    (void)args;
+    journal_dump(out);
+}
+
+static void cmd_kv(FILE *out, char *args) {
+    (void)args;
+    kv_dump(out);
+}
+
+static void cmd_snapshot(FILE *out, char *args) {
+    (void)args;
+    char msg[CONFIG_PATH_LEN + 128];
+    if (snapshot_save(msg, sizeof(msg)) == 0) {
+        printf("💾  snapshot %s (admin request)\n", msg);
+        fprintf(out, "OK %s\n", msg);
+    } else {
+        fprintf(out, "ERR %s\n", msg);
+    }
+}
+
+static void cmd_cluster(FILE *out, char *args) {
+    (void)args;
+    cluster_dump(out);
+}
+
+static void cmd_tcpinfo(FILE *out, char *args) {
+    (void)args;
+    stats_hist_dump(out);
+}
+
+static void cmd_trace(FILE *out, char *args) {
+    (void)args;
+    uint64_t n = trace_export(out);
+    printf("🧵  exported %llu trace spans (admin request)\n", (unsigned long long)n);
+}
+
+static void cmd_flight(FILE *out, char *args) {
+    (void)args;
+    fflush(out);                        // the dump writes to the socket directly
+    flight_dump(fileno(out), 0);
+}
+
+// ============================================================================
+// Connection handling
+// ============================================================================
+static int read_line(int fd, char *line, size_t cap) {
+    size_t len = 0;
+    for (;;) {
+        ssize_t n = recv(fd, line + len, cap - 1 - len, 0);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;                          // includes SO_RCVTIMEO expiry
+        }
+        len += (size_t)n;
+        if (memchr(line, '\n', len) || len == cap - 1) break;
+    }
+    line[len] = '\0';
+    line[strcspn(line, "\r\n")] = '\0';
+    return 0;
+}
+
+// Owns cfd: it is closed on every path, by fclose() once a stream exists.
+static void admin_serve(int cfd) {
+    char line[ADMIN_LINE_MAX];
+    FILE *out = NULL;
+    if (read_line(cfd, line, sizeof(line)) < 0 || !(out = fdopen(cfd, "w"))) {
+        close(cfd);
+        return;
+    }
+
+    char *args;
+    char *name = strtok_r(line, " \t", &args);
+    const struct admin_cmd *cmd = NULL;
+    for (size_t i = 0; name && i < ADMIN_NCMDS; i++) {
+        if (strcasecmp(name, admin_cmds[i].name) == 0) cmd = &admin_cmds[i];
+    }
+
+    if (cmd) cmd->run(out, args ? args : "");
+    else fprintf(out, "ERR unknown command (try HELP)\n");
+
+    fclose(out);                                // flushes, then closes cfd
+}
+
+static void *admin_thread(void *arg) {
+    int s = (int)(intptr_t)arg;
+    pthread_setname_np(pthread_self(), "raw-admin");
+    // Online only to copy the config: PROFILE and SNAPSHOT block for seconds,
+    // and reloads meanwhile would pile up in the retired list.
+    struct config_reader *rcu = config_reader_register();
+    config_reader_offline(rcu);
+
+    for (;;) {
+        int cfd = accept(s, NULL, NULL);
+        if (cfd < 0) {
+            if (errno != EINTR) perror("admin accept");
+            continue;
+        }
+        struct timeval tv = {ADMIN_RECV_TIMEOUT_SEC, 0};
+        setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        config_reader_online(rcu);
+        cmd_cfg = *config_current();
+        config_reader_offline(rcu);
+        admin_serve(cfd);
+    }
+    return NULL;
+}
+
+int admin_start(const char *bind_ip, int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, bind_ip, &addr.sin_addr) != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int s = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s < 0) return -1;
+    int yes = 1;
+    if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0 ||
+        bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(s, 8) < 0) {
+        int saved = errno;
+        close(s);
+        errno = saved;
+        return -1;
+    }
+
+    pthread_t tid;
+    int rc = pthread_create(&tid, NULL, admin_thread, (void *)(intptr_t)s);
+    if (rc != 0) {
+        close(s);
+        errno = rc;
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef RAW_ADMIN_H
+#define RAW_ADMIN_H
+
+// ============================================================================
+// Admin interface
+// ----------------------------------------------------------------------------
+// A second, separate listening socket for operators. It runs on its own thread
+// so a slow admin command (a 30 s profile, say) never stalls the data path,
+// and it speaks the same shape of protocol as the echo port: one text command
+// per connection, terminated by '\n', answered and then closed.
+//
+//     $ echo "PROFILE 10" | nc 127.0.0.1 9001 > raw.folded
+//     $ flamegraph.pl raw.folded > raw.svg
+//
+// Commands:
+//   HELP                  list commands
+//   CONFIG                print the live configuration and its generation
+//   PROFILE [secs] [hz]   sample all worker threads, reply with folded stacks
+//   STATS                 counters as "name value" lines, incl. TIME_WAIT census
+//   WORKERS               per-worker connections, load and migrations
+//   JOURNAL               journal commits, batch sizes and fdatasync latency
+//   KV                    key-value store items, memory, load and probe lengths
+//   SNAPSHOT              fork and save the KV store to snapshot_path now
+//   CLUSTER               cluster members and forwarding counters
+//   TCPINFO               TCP_INFO histograms: RTT, retransmits, cwnd, backlog
+//   TRACE                 sampled request spans as Chrome trace JSON
+//   FLIGHT                flight recorder: recent events of every worker
+//
+// Exposure:
+//   - The admin port is opt-in and meant to be bound to loopback (reach it via
+//     `kubectl exec` / `docker exec`). There is no authentication.
+//
+// admin_start(bind_ip, port)
+//   - Creates the admin listener and spawns the serving thread. Returns 0 on
+//     success or -1 with errno set; the caller decides whether that is fatal.
+int admin_start(const char *bind_ip, int port);
+
+#endif
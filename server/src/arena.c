@@ -0,0 +1,77 @@
+// ============================================================================
+// Per-request scratch arena: block setup, spills and formatting
+// ============================================================================
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct arena_spill {
+    struct arena_spill *next;
+    _Alignas(16) char data[];
+};
+
+int arena_init(struct arena *a, size_t cap, struct raw_stats *st) {
+    a->base = aligned_alloc(64, cap);
+    if (!a->base) return -1;
+    a->cap = cap;
+    a->used = 0;
+    a->spill = NULL;
+    a->stats = st;
+    return 0;
+}
+
+void *arena_alloc_slow(struct arena *a, size_t n) {
+    struct arena_spill *s = malloc(sizeof(*s) + n);
+    if (!s) return NULL;
+    s->next = a->spill;
+    a->spill = s;
+    STAT_INC(a->stats, arena_spills);
+    return s->data;
+}
+
+void arena_reset_slow(struct arena *a) {
+    while (a->spill) {
+        struct arena_spill *next = a->spill->next;
+        free(a->spill);
+        a->spill = next;
+    }
+}
+
+char *arena_vprintf(struct arena *a, size_t *len, const char *fmt, va_list ap) {
+    // Format straight into whatever is left of the block; only a record that
+    // does not fit is formatted a second time, into an allocation of its size.
+    size_t off = (a->used + 15) & ~(size_t)15;
+    size_t room = off < a->cap ? a->cap - off : 0;
+    va_list again;
+    va_copy(again, ap);
+    int n = vsnprintf(room ? a->base + off : NULL, room, fmt, ap);
+
+    char *out = NULL;
+    if (n >= 0 && (size_t)n < room) {
+        out = a->base + off;
+        a->used = off + (size_t)n + 1;
+    } else if (n >= 0 && (out = arena_alloc(a, (size_t)n + 1))) {
+        vsnprintf(out, (size_t)n + 1, fmt, again);
+    }
+    va_end(again);
+    if (out && len) *len = (size_t)n;
+    return out;
+}
+
+char *arena_printf(struct arena *a, size_t *len, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    char *out = arena_vprintf(a, len, fmt, ap);
+    va_end(ap);
+    return out;
+}
+
+void arena_log(struct arena *a, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    size_t n;
+    char *line = arena_vprintf(a, &n, fmt, ap);
+    va_end(ap);
+    if (line) fwrite(line, 1, n, stdout);
+}
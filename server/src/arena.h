@@ -0,0 +1,72 @@
+#ifndef RAW_ARENA_H
+#define RAW_ARENA_H
+
+// ============================================================================
+// Per-request scratch arena
+// ----------------------------------------------------------------------------
+// Handlers need short-lived memory: parsed tokens, transformed payloads, log
+// records, error strings. None of it outlives the request, so instead of
+// malloc/free per message every serving thread owns one bump-pointer arena:
+//
+//   arena_alloc()   advances a pointer in a preallocated block (16-byte
+//                   aligned); no locks, no headers, no free()
+//   arena_reset()   once the request's reply has been copied to the
+//                   connection's output buffer, forgets everything in O(1)
+//
+// Rule for handler code: nothing allocated from the arena may be referenced
+// after the request it was allocated for has been answered. Replies are
+// always copied into the connection's own buffer, so they never point here.
+//
+// A request that needs more than the block spills into malloc'd chunks,
+// counted in arena_spills and freed at the next reset; a steady nonzero rate
+// means ARENA_BYTES is too small for the handlers in use.
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stats.h"
+
+#define ARENA_BYTES (64 * 1024)     // per serving thread
+
+struct arena_spill;
+
+struct arena {
+    char *base;
+    size_t cap, used;
+    struct arena_spill *spill;      // oversized requests' chunks, until reset
+    struct raw_stats *stats;        // the owning thread's (arena_spills)
+};
+
+// Allocates the block. Returns 0, or -1 with errno set.
+int arena_init(struct arena *a, size_t cap, struct raw_stats *st);
+
+void *arena_alloc_slow(struct arena *a, size_t n);
+void arena_reset_slow(struct arena *a);
+
+// n bytes, 16-byte aligned. NULL only if a spill chunk cannot be allocated.
+static inline void *arena_alloc(struct arena *a, size_t n) {
+    size_t off = (a->used + 15) & ~(size_t)15;
+    if (off <= a->cap && n <= a->cap - off) {
+        a->used = off + n;
+        return a->base + off;
+    }
+    return arena_alloc_slow(a, n);
+}
+
+static inline void arena_reset(struct arena *a) {
+    a->used = 0;
+    if (a->spill) arena_reset_slow(a);
+}
+
+// Formats into the arena. Returns the NUL-terminated string (its length in
+// *len, if len is not NULL), or NULL if it could not be allocated.
+char *arena_printf(struct arena *a, size_t *len, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+char *arena_vprintf(struct arena *a, size_t *len, const char *fmt, va_list ap)
+    __attribute__((format(printf, 3, 0)));
+
+// A log record (log_messages): formatted in the arena, outside stdout's
+// lock, which is then held only to copy the finished line.
+void arena_log(struct arena *a, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#endif
@@ -0,0 +1,103 @@
+// ============================================================================
+// Cluster mode: member list and rendezvous routing
+// ============================================================================
+#define _GNU_SOURCE
+#include "cluster.h"
+#include "kv.h"
+#include "stats.h"
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <string.h>
+
+static int enabled;
+static int self;
+static int npeers;
+static char names[CONFIG_MAX_PEERS][CONFIG_ADDR_LEN + 8];
+static uint64_t seeds[CONFIG_MAX_PEERS];
+static struct sockaddr_in addrs[CONFIG_MAX_PEERS];
+
+// splitmix64 finalizer: turns (key hash ^ seed) into an independent score
+// per member.
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+int cluster_start(const struct raw_config *cfg) {
+    if (cfg->cluster_self < 0 && cfg->npeers == 0) return 0;
+    if (cfg->cluster_self < 0 || cfg->cluster_self >= cfg->npeers) {
+        fprintf(stderr, "❌ cluster: cluster_self = %d does not index the %d peer entries\n",
+                cfg->cluster_self, cfg->npeers);
+        return -1;
+    }
+    if (cfg->kv_max_mb == 0) {
+        fprintf(stderr, "❌ cluster: peers are set but the KV store is off (kv_max_mb = 0)\n");
+        return -1;
+    }
+    npeers = cfg->npeers;
+    self = cfg->cluster_self;
+    for (int i = 0; i < npeers; i++) {
+        const struct raw_listen_addr *p = &cfg->peers[i];
+        snprintf(names[i], sizeof(names[i]), "%s:%d", p->ip, p->port);
+        // The seed comes from the address, so every member derives the same
+        // one whatever its position in the list.
+        seeds[i] = mix(kv_hash(names[i], strlen(names[i])));
+
+        addrs[i].sin_family = AF_INET;
+        addrs[i].sin_port = htons((uint16_t)p->port);
+        if (inet_pton(AF_INET, p->ip, &addrs[i].sin_addr) != 1) {
+            fprintf(stderr, "❌ cluster: peer '%s' is not an IPv4 address\n", names[i]);
+            return -1;
+        }
+    }
+    enabled = 1;
+    printf("🕸️  cluster: member %d of %d (%s)\n", self, npeers, names[self]);
+    return 0;
+}
+
+int cluster_enabled(void) {
+    return enabled;
+}
+
+int cluster_npeers(void) {
+    return npeers;
+}
+
+const struct sockaddr_in *cluster_peer_addr(int peer) {
+    return &addrs[peer];
+}
+
+int cluster_route(const char *line, size_t len) {
+    uint64_t h;
+    if (!kv_command_hash(line, len, &h)) return -1;
+    int best = 0;
+    uint64_t best_score = 0;
+    for (int i = 0; i < npeers; i++) {
+        uint64_t score = mix(h ^ seeds[i]);
+        if (i == 0 || score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    return best == self ? -1 : best;
+}
+
+void cluster_dump(FILE *out) {
+    if (!enabled) {
+        fprintf(out, "cluster disabled (set peer and cluster_self)\n");
+        return;
+    }
+    for (int i = 0; i < npeers; i++) {
+        fprintf(out, "peer %d %s%s\n", i, names[i], i == self ? " self" : "");
+    }
+    struct raw_stats_snapshot s;
+    stats_read(-1, &s);
+    fprintf(out, "fwd_out %llu\n", (unsigned long long)s.fwd_out);
+    fprintf(out, "fwd_in %llu\n", (unsigned long long)s.fwd_in);
+    fprintf(out, "fwd_errors %llu\n", (unsigned long long)s.fwd_errors);
+    fprintf(out, "peer_connects %llu\n", (unsigned long long)s.peer_connects);
+}
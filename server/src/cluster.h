@@ -0,0 +1,55 @@
+#ifndef RAW_CLUSTER_H
+#define RAW_CLUSTER_H
+
+// ============================================================================
+// Cluster mode: key ownership across raw_server instances
+// ----------------------------------------------------------------------------
+// Several instances (on one host or many) share a static member list:
+//
+//     peer = 127.0.0.1:9100        # identical on every member, same order
+//     peer = 127.0.0.1:9200
+//     peer = 127.0.0.1:9300
+//     cluster_self = 1             # differs: which entry is me
+//
+// Every KV command (SET/GET/DEL) has exactly one owner, chosen by rendezvous
+// (highest-random-weight) hashing: each member scores mix(key hash ^ member
+// seed) and the highest score wins. Any member can take any request; one that
+// does not own the key forwards it to the owner (worker.c) and relays the
+// reply, so clients need no sharding library.
+//
+// Rationale for rendezvous hashing over a ring or jump hash:
+//   - Removing a member moves only that member's keys, and adding one takes
+//     roughly 1/N of the keys, the same as a consistent-hash ring but
+//     without virtual nodes to tune.
+//   - Unlike jump hash, the outcome depends on the member addresses, not on
+//     their positions in the list, so the list can be edited anywhere.
+//   - The cost is O(members) per request; with at most CONFIG_MAX_PEERS
+//     members that is a few multiplies.
+//
+// Forwarded requests arrive at the owner on connections that open with
+// "PEER"; the owner always answers those locally, so a member with a
+// different list cannot bounce a request back and forth.
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "config.h"
+
+// Validates the member list (cluster_self set, KV store on) and precomputes
+// member seeds and addresses. Returns 0 (also when cluster mode is off), or
+// -1 with a message printed.
+int cluster_start(const struct raw_config *cfg);
+
+int cluster_enabled(void);
+int cluster_npeers(void);
+const struct sockaddr_in *cluster_peer_addr(int peer);
+
+// Index of the member that owns the key of KV command 'line', or -1 when the
+// line is not a KV command or this instance owns the key.
+int cluster_route(const char *line, size_t len);
+
+// Member list and per-worker forwarding counters for the admin CLUSTER
+// command.
+void cluster_dump(FILE *out);
+
+#endif
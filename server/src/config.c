@@ -0,0 +1,527 @@
+// ============================================================================
+// Runtime configuration: parsing, publication and hot reload
+// ----------------------------------------------------------------------------
+// Keys are described by a table (name, offset into struct raw_config, bounds,
+// live-or-restart) so parsing, validation, dumping and the restart-only check
+// all come from one place. Adding a tunable means adding a struct field and a
+// table row.
+#define _GNU_SOURCE
+#include "config.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define CONFIG_MAX_READERS 2048     // io_backend = blocking: one per conn thread
+#define CONFIG_LINE_MAX 512
+#define CONFIG_RETIRED_MAX 64
+#define CONFIG_POLL_MS 100          // watcher tick: debounce + reclamation
+
+enum key_type { KEY_INT, KEY_ENUM, KEY_LISTEN, KEY_PEER, KEY_STRING };
+
+struct config_key {
+    const char *name;
+    enum key_type type;
+    size_t off;                     // offset of the field (not KEY_LISTEN/PEER)
+    long min, max;                  // KEY_STRING: max is the buffer size
+    int live;                       // 0: restart-only
+    const char *const *names;       // KEY_ENUM: value i is spelled names[i]
+};
+
+#define INT_KEY(field, lo, hi, is_live) \
+    {#field, KEY_INT, offsetof(struct raw_config, field), lo, hi, is_live, NULL}
+#define ENUM_KEY(field, spellings, is_live)                                  \
+    {#field, KEY_ENUM, offsetof(struct raw_config, field), 0,                \
+     (long)(sizeof(spellings) / sizeof(spellings[0])) - 1, is_live, spellings}
+
+#define STRING_KEY(field, is_live)                                             \
+    {#field, KEY_STRING, offsetof(struct raw_config, field), 0,                \
+     (long)sizeof(((struct raw_config *)0)->field), is_live, NULL}
+
+static const char *const close_mode_names[] = {"server", "client", "abort"};
+static const char *const accept_mode_names[] = {"reuseport", "exclusive"};
+static const char *const io_backend_names[] = {"epoll", "blocking", "uring"};
+static const char *const text_mode_names[] = {"bytes", "utf8"};
+static const char *const delimiter_names[] = {"lf", "crlf", "nul"};
+
+static const struct config_key config_keys[] = {
+    {"listen", KEY_LISTEN, 0, 0, 0, 0, NULL},
+    INT_KEY(workers, 1, 256, 0),
+    INT_KEY(admin_port, 0, 65535, 0),
+    INT_KEY(cpu_pin, -1, 4095, 0),
+    ENUM_KEY(accept_mode, accept_mode_names, 0),
+    ENUM_KEY(io_backend, io_backend_names, 0),
+    STRING_KEY(journal_dir, 0),
+    INT_KEY(journal_segment_mb, 1, 4096, 0),
+    INT_KEY(journal_direct, 0, 1, 0),
+    INT_KEY(kv_max_mb, 0, 1 << 20, 0),
+    STRING_KEY(snapshot_path, 0),
+    {"peer", KEY_PEER, 0, 0, 0, 0, NULL},
+    INT_KEY(cluster_self, -1, CONFIG_MAX_PEERS - 1, 0),
+    STRING_KEY(metrics_path, 0),
+    STRING_KEY(flight_path, 0),
+    INT_KEY(max_msg_len, 1, MSG_LEN_CAP, 1),
+    ENUM_KEY(text_mode, text_mode_names, 1),
+    ENUM_KEY(delimiter, delimiter_names, 1),
+    INT_KEY(backlog, 1, 65535, 1),
+    INT_KEY(tcp_nodelay, 0, 1, 1),
+    INT_KEY(rcvbuf, 0, 64 << 20, 1),
+    INT_KEY(sndbuf, 0, 64 << 20, 1),
+    INT_KEY(recv_timeout_ms, 0, 3600 * 1000, 1),
+    INT_KEY(keepalive, 0, 1, 1),
+    INT_KEY(deadlines, 0, 1, 1),
+    ENUM_KEY(close_mode, close_mode_names, 1),
+    INT_KEY(close_wait_ms, 1, 60 * 1000, 1),
+    INT_KEY(rebalance_ms, 0, 60 * 1000, 1),
+    INT_KEY(rebalance_threshold_pct, 1, 100, 1),
+    INT_KEY(rate_limit_cps, 0, 10000000, 1),
+    INT_KEY(rate_limit_burst, 0, 10000000, 1),
+    INT_KEY(log_messages, 0, 1, 1),
+    INT_KEY(journal_commit_us, 0, 100000, 1),
+    INT_KEY(snapshot_interval_s, 0, 86400, 1),
+    INT_KEY(tcp_info_ms, 0, 3600 * 1000, 1),
+    INT_KEY(tcp_info_conns, 1, 65536, 1),
+    INT_KEY(trace_sample, 0, 1000000, 1),
+    INT_KEY(slow_request_us, 0, 60 * 1000 * 1000, 1),
+    INT_KEY(metrics_interval_ms, 10, 60 * 1000, 1),
+};
+
+#define CONFIG_NKEYS (sizeof(config_keys) / sizeof(config_keys[0]))
+
+static int *int_field(struct raw_config *cfg, const struct config_key *k) {
+    return (int *)((char *)cfg + k->off);
+}
+
+static int int_value(const struct raw_config *cfg, const struct config_key *k) {
+    return *(const int *)((const char *)cfg + k->off);
+}
+
+static char *str_field(struct raw_config *cfg, const struct config_key *k) {
+    return (char *)cfg + k->off;
+}
+
+static const char *str_value(const struct raw_config *cfg, const struct config_key *k) {
+    return (const char *)cfg + k->off;
+}
+
+// ============================================================================
+// Defaults and parsing
+// ============================================================================
+void config_defaults(struct raw_config *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    snprintf(cfg->listen[0].ip, sizeof(cfg->listen[0].ip), "0.0.0.0");
+    cfg->listen[0].port = 9000;
+    cfg->nlisten = 1;
+    cfg->workers = 1;
+    cfg->cpu_pin = -1;
+    cfg->cluster_self = -1;
+    cfg->max_msg_len = 20;
+    cfg->backlog = 128;
+    cfg->recv_timeout_ms = 5000;
+    cfg->close_mode = CLOSE_MODE_SERVER;
+    cfg->close_wait_ms = 2000;
+    cfg->rebalance_ms = 1000;
+    cfg->rebalance_threshold_pct = 20;
+    cfg->log_messages = 1;
+    cfg->journal_segment_mb = 64;
+    cfg->journal_direct = 1;
+    cfg->tcp_info_ms = 1000;
+    cfg->tcp_info_conns = 16;
+    cfg->metrics_interval_ms = 1000;
+    cfg->generation = 1;
+}
+
+// The default listen address is a placeholder: the first explicit "listen"
+// (from argv or the file) replaces it instead of adding a second socket.
+static int listen_is_default = 1;
+
+int config_add_listen(struct raw_config *cfg, const char *ip, int port) {
+    if (listen_is_default) {
+        cfg->nlisten = 0;
+        listen_is_default = 0;
+    }
+    if (cfg->nlisten >= CONFIG_MAX_LISTEN || port <= 0 || port > 65535 ||
+        strlen(ip) >= CONFIG_ADDR_LEN) {
+        return -1;
+    }
+    struct raw_listen_addr *a = &cfg->listen[cfg->nlisten++];
+    snprintf(a->ip, sizeof(a->ip), "%s", ip);
+    a->port = port;
+    return 0;
+}
+
+static char *trim(char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' ||
+                       end[-1] == '\r' || end[-1] == '\n')) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+// Splits "ip:port" in place. Returns the port, or -1.
+static int split_addr(char *val) {
+    char *colon = strrchr(val, ':');
+    if (!colon) return -1;
+    *colon = '\0';
+    char *end;
+    long port = strtol(colon + 1, &end, 10);
+    if (*end != '\0' || port <= 0 || port > 65535) return -1;
+    return (int)port;
+}
+
+static int parse_listen(struct raw_config *cfg, char *val) {
+    int port = split_addr(val);
+    if (port < 0) return -1;
+    return config_add_listen(cfg, val, port);
+}
+
+static int parse_peer(struct raw_config *cfg, char *val) {
+    int port = split_addr(val);
+    if (port < 0 || cfg->npeers >= CONFIG_MAX_PEERS || strlen(val) >= CONFIG_ADDR_LEN) return -1;
+    struct raw_listen_addr *a = &cfg->peers[cfg->npeers++];
+    snprintf(a->ip, sizeof(a->ip), "%s", val);
+    a->port = port;
+    return 0;
+}
+
+int config_load(struct raw_config *cfg, const char *path, char *err, size_t errlen) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        snprintf(err, errlen, "%s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    char line[CONFIG_LINE_MAX];
+    int lineno = 0, rc = 0;
+    listen_is_default = 1;
+    while (rc == 0 && fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *s = trim(line);
+        if (*s == '\0') continue;
+
+        char *eq = strchr(s, '=');
+        if (!eq) {
+            snprintf(err, errlen, "%s:%d: expected 'key = value'", path, lineno);
+            rc = -1;
+            break;
+        }
+        *eq = '\0';
+        char *key = trim(s), *val = trim(eq + 1);
+
+        const struct config_key *k = NULL;
+        for (size_t i = 0; i < CONFIG_NKEYS; i++) {
+            if (strcmp(key, config_keys[i].name) == 0) k = &config_keys[i];
+        }
+        if (!k) {
+            snprintf(err, errlen, "%s:%d: unknown key '%s'", path, lineno, key);
+            rc = -1;
+        } else if (k->type == KEY_LISTEN) {
+            if (parse_listen(cfg, val) < 0) {
+                snprintf(err, errlen, "%s:%d: bad listen address '%s'",
+                         path, lineno, val);
+                rc = -1;
+            }
+        } else if (k->type == KEY_PEER) {
+            if (parse_peer(cfg, val) < 0) {
+                snprintf(err, errlen, "%s:%d: bad peer address '%s' (ip:port, at most %d)",
+                         path, lineno, val, CONFIG_MAX_PEERS);
+                rc = -1;
+            }
+        } else if (k->type == KEY_STRING) {
+            if (strlen(val) >= (size_t)k->max) {
+                snprintf(err, errlen, "%s:%d: %s is longer than %ld bytes",
+                         path, lineno, key, k->max - 1);
+                rc = -1;
+            } else {
+                memcpy(str_field(cfg, k), val, strlen(val) + 1);
+            }
+        } else if (k->type == KEY_ENUM) {
+            long v = -1;
+            for (long i = 0; i <= k->max; i++) {
+                if (strcmp(val, k->names[i]) == 0) v = i;
+            }
+            if (v < 0) {
+                snprintf(err, errlen, "%s:%d: bad value '%s' for %s",
+                         path, lineno, val, key);
+                rc = -1;
+            } else {
+                *int_field(cfg, k) = (int)v;
+            }
+        } else {
+            char *end;
+            errno = 0;
+            long v = strtol(val, &end, 10);
+            if (errno || end == val || *end != '\0' || v < k->min || v > k->max) {
+                snprintf(err, errlen, "%s:%d: %s must be an integer in [%ld, %ld]",
+                         path, lineno, key, k->min, k->max);
+                rc = -1;
+            } else {
+                *int_field(cfg, k) = (int)v;
+            }
+        }
+    }
+    fclose(f);
+    return rc;
+}
+
+void config_dump(const struct raw_config *cfg, FILE *out) {
+    fprintf(out, "# generation %llu\n", (unsigned long long)cfg->generation);
+    for (int i = 0; i < cfg->nlisten; i++) {
+        fprintf(out, "listen = %s:%d\n", cfg->listen[i].ip, cfg->listen[i].port);
+    }
+    for (int i = 0; i < cfg->npeers; i++) {
+        fprintf(out, "peer = %s:%d  # restart\n", cfg->peers[i].ip, cfg->peers[i].port);
+    }
+    for (size_t i = 0; i < CONFIG_NKEYS; i++) {
+        const struct config_key *k = &config_keys[i];
+        const char *restart = k->live ? "" : "  # restart";
+        if (k->type == KEY_INT) {
+            fprintf(out, "%s = %d%s\n", k->name, int_value(cfg, k), restart);
+        } else if (k->type == KEY_ENUM) {
+            fprintf(out, "%s = %s%s\n", k->name, k->names[int_value(cfg, k)], restart);
+        } else if (k->type == KEY_STRING) {
+            fprintf(out, "%s = %s%s\n", k->name, str_value(cfg, k), restart);
+        }
+    }
+}
+
+// Copies restart-only settings from 'old' into 'next', reporting each one the
+// file tried to change. Returns the number of ignored changes.
+static int carry_restart_only(const struct raw_config *old, struct raw_config *next) {
+    int ignored = 0;
+    for (size_t i = 0; i < CONFIG_NKEYS; i++) {
+        const struct config_key *k = &config_keys[i];
+        if (k->live) continue;
+        if (k->type == KEY_LISTEN) {
+            if (next->nlisten != old->nlisten ||
+                memcmp(next->listen, old->listen, sizeof(old->listen)) != 0) {
+                fprintf(stderr, "⚠️  config: 'listen' changed; takes effect on restart\n");
+                ignored++;
+            }
+            memcpy(next->listen, old->listen, sizeof(old->listen));
+            next->nlisten = old->nlisten;
+        } else if (k->type == KEY_PEER) {
+            if (next->npeers != old->npeers ||
+                memcmp(next->peers, old->peers, sizeof(old->peers)) != 0) {
+                fprintf(stderr, "⚠️  config: 'peer' changed; takes effect on restart\n");
+                ignored++;
+            }
+            memcpy(next->peers, old->peers, sizeof(old->peers));
+            next->npeers = old->npeers;
+        } else if (k->type == KEY_STRING) {
+            if (strcmp(str_value(next, k), str_value(old, k)) != 0) {
+                fprintf(stderr, "⚠️  config: '%s' changed; takes effect on restart\n",
+                        k->name);
+                ignored++;
+            }
+            memcpy(str_field(next, k), str_value(old, k), (size_t)k->max);
+        } else {
+            if (int_value(next, k) != int_value(old, k)) {
+                fprintf(stderr, "⚠️  config: '%s' changed; takes effect on restart\n",
+                        k->name);
+                ignored++;
+            }
+            *int_field(next, k) = int_value(old, k);
+        }
+    }
+    return ignored;
+}
+
+// ============================================================================
+// Publication and quiescent-state-based reclamation
+// ----------------------------------------------------------------------------
+// Each reader slot holds the global epoch it last observed at a quiescent
+// point, or 0 while offline. A config retired when the epoch became E can be
+// freed once every slot is either 0 or >= E: each reader has since dropped any
+// pointer it loaded before the swap.
+// ============================================================================
+struct config_reader {
+    _Alignas(64) _Atomic uint64_t seen;     // one cache line per reader
+};
+
+static _Atomic(struct raw_config *) current_cfg;
+static _Atomic uint64_t qsbr_epoch = 1;
+static struct config_reader readers[CONFIG_MAX_READERS];
+static _Atomic int nreaders;
+
+struct retired {
+    struct raw_config *cfg;
+    uint64_t epoch;
+};
+static struct retired retired_list[CONFIG_RETIRED_MAX];
+static int nretired;
+
+const struct raw_config *config_current(void) {
+    return atomic_load_explicit(&current_cfg, memory_order_acquire);
+}
+
+void config_publish_initial(struct raw_config *cfg) {
+    atomic_store(&current_cfg, cfg);
+}
+
+struct config_reader *config_reader_register(void) {
+    int i = atomic_fetch_add(&nreaders, 1);
+    if (i >= CONFIG_MAX_READERS) {
+        fprintf(stderr, "config: more than %d readers\n", CONFIG_MAX_READERS);
+        abort();
+    }
+    config_reader_online(&readers[i]);
+    return &readers[i];
+}
+
+void config_reader_online(struct config_reader *r) {
+    atomic_store(&r->seen, atomic_load(&qsbr_epoch));
+}
+
+void config_reader_quiescent(struct config_reader *r) {
+    config_reader_online(r);
+}
+
+void config_reader_offline(struct config_reader *r) {
+    atomic_store_explicit(&r->seen, 0, memory_order_release);
+}
+
+static int grace_period_over(uint64_t epoch) {
+    int n = atomic_load(&nreaders);
+    for (int i = 0; i < n && i < CONFIG_MAX_READERS; i++) {
+        uint64_t seen = atomic_load(&readers[i].seen);
+        if (seen != 0 && seen < epoch) return 0;
+    }
+    return 1;
+}
+
+static void reclaim(void) {
+    int kept = 0;
+    for (int i = 0; i < nretired; i++) {
+        if (grace_period_over(retired_list[i].epoch)) free(retired_list[i].cfg);
+        else retired_list[kept++] = retired_list[i];
+    }
+    nretired = kept;
+}
+
+// Swaps in 'next' and queues the previous snapshot for reclamation.
+static struct raw_config *publish(struct raw_config *next) {
+    struct raw_config *old = atomic_exchange(&current_cfg, next);
+    uint64_t epoch = atomic_fetch_add(&qsbr_epoch, 1) + 1;
+
+    // A stuck reader (blocked mid-connection) only delays frees; if it stays
+    // stuck across CONFIG_RETIRED_MAX reloads we keep the memory rather than
+    // risk a use-after-free.
+    if (nretired < CONFIG_RETIRED_MAX) {
+        retired_list[nretired].cfg = old;
+        retired_list[nretired].epoch = epoch;
+        nretired++;
+    }
+    return old;
+}
+
+// ============================================================================
+// inotify watcher
+// ----------------------------------------------------------------------------
+// The *directory* is watched rather than the file: editors and config
+// management tools usually write a temp file and rename(2) it over the
+// original, which would orphan a watch on the old inode.
+// ============================================================================
+struct watch_ctx {
+    char path[PATH_MAX];
+    char dir[PATH_MAX];
+    const char *base;
+    config_reload_fn on_reload;
+};
+
+static void reload(struct watch_ctx *w) {
+    const struct raw_config *old = config_current();
+    struct raw_config *next = malloc(sizeof(*next));
+    if (!next) return;
+
+    char err[256];
+    config_defaults(next);
+    if (config_load(next, w->path, err, sizeof(err)) < 0) {
+        fprintf(stderr, "⚠️  config reload rejected: %s (keeping generation %llu)\n",
+                err, (unsigned long long)old->generation);
+        free(next);
+        return;
+    }
+    carry_restart_only(old, next);
+    next->generation = old->generation + 1;
+
+    // 'old' stays valid through on_reload(): it cannot be reclaimed until the
+    // next reclaim() call on this same thread.
+    publish(next);
+    printf("🔧  config generation %llu applied (max_msg_len=%d backlog=%d)\n",
+           (unsigned long long)next->generation, next->max_msg_len, next->backlog);
+    if (w->on_reload) w->on_reload(old, next);
+}
+
+static void *watch_thread(void *arg) {
+    struct watch_ctx *w = arg;
+    pthread_setname_np(pthread_self(), "raw-config");
+
+    int ifd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (ifd < 0 ||
+        inotify_add_watch(ifd, w->dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        perror("inotify");
+        return NULL;
+    }
+
+    _Alignas(struct inotify_event) char buf[4096];
+    int pending = 0;
+    for (;;) {
+        struct pollfd pfd = {ifd, POLLIN, 0};
+        int n = poll(&pfd, 1, CONFIG_POLL_MS);
+        if (n > 0) {
+            ssize_t len;
+            while ((len = read(ifd, buf, sizeof(buf))) > 0) {
+                for (char *p = buf; p < buf + len;) {
+                    struct inotify_event *ev = (struct inotify_event *)p;
+                    if (ev->len && strcmp(ev->name, w->base) == 0) pending = 1;
+                    p += sizeof(*ev) + ev->len;
+                }
+            }
+            // Debounce: a save often produces CREATE + CLOSE_WRITE + MOVED_TO;
+            // reload once, on the first quiet tick after the burst.
+            continue;
+        }
+        if (pending) {
+            pending = 0;
+            reload(w);
+        }
+        reclaim();
+    }
+    return NULL;
+}
+
+int config_watch_start(const char *path, config_reload_fn on_reload) {
+    struct watch_ctx *w = calloc(1, sizeof(*w));
+    if (!w) return -1;
+    if (!realpath(path, w->path)) {
+        free(w);
+        return -1;
+    }
+    snprintf(w->dir, sizeof(w->dir), "%s", w->path);
+    char *slash = strrchr(w->dir, '/');
+    *slash = '\0';
+    if (w->dir[0] == '\0') snprintf(w->dir, sizeof(w->dir), "/");
+    w->base = strrchr(w->path, '/') + 1;
+    w->on_reload = on_reload;
+
+    pthread_t tid;
+    int rc = pthread_create(&tid, NULL, watch_thread, w);
+    if (rc != 0) {
+        free(w);
+        errno = rc;
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
@@ -0,0 +1,201 @@
+#ifndef RAW_CONFIG_H
+#define RAW_CONFIG_H
+
+// ============================================================================
+// Runtime configuration
+// ----------------------------------------------------------------------------
+// Every tunable that used to be a #define or a positional argv lives in one
+// immutable struct raw_config. A running server always has exactly one
+// *current* config, published through an atomic pointer:
+//
+//   - Readers (worker threads) load the pointer with acquire semantics and use
+//     the snapshot for as long as they like — no locks, no reference counts.
+//   - The writer (the inotify watcher thread) parses a complete new struct,
+//     swaps the pointer, and frees the old one only after every registered
+//     reader has passed a quiescent state (QSBR, the userspace flavour of RCU).
+//
+// File format: one "key = value" per line, '#' starts a comment.
+//
+//     listen          = 0.0.0.0:9000   # repeatable           (restart)
+//     workers         = 4              # worker threads        (restart)
+//     admin_port      = 9001           # loopback admin port   (restart)
+//     cpu_pin         = -1             # worker i on CPU cpu_pin+i, -1 = off (restart)
+//     accept_mode     = reuseport      # reuseport | exclusive   (restart)
+//     io_backend      = epoll          # epoll | blocking | uring (restart)
+//     max_msg_len     = 20             # bytes (or code points), <= MSG_LEN_CAP (live)
+//     text_mode       = bytes          # bytes | utf8: validate, count code points (live)
+//     delimiter       = lf             # lf | crlf | nul: request terminator (live)
+//     backlog         = 128            # listen(2) backlog     (live)
+//     tcp_nodelay     = 1              # per accepted socket   (live)
+//     rcvbuf / sndbuf = 0              # SO_RCVBUF/SO_SNDBUF, 0 = kernel (live)
+//     recv_timeout_ms = 5000           # idle close, 0 = never (live)
+//     keepalive       = 0              # 1: many requests/conn (live)
+//     deadlines       = 0              # 1: "@<ms> " budgets, EDF order (live)
+//     close_mode      = server         # server | client | abort (live)
+//     close_wait_ms   = 2000           # client mode: wait for FIN (live)
+//     rebalance_ms    = 1000           # rebalancer period, 0 = off (live)
+//     rebalance_threshold_pct = 20     # CPU gap that triggers it (live)
+//     rate_limit_cps  = 0              # new conns/s per worker, 0 = off (live)
+//     rate_limit_burst= 0              # token bucket depth, 0 = cps (live)
+//     log_messages    = 1              # per-message log lines (live)
+//     tcp_info_ms     = 1000           # TCP_INFO sampling period, 0 = off (live)
+//     tcp_info_conns  = 16             # connections sampled per worker per period (live)
+//     trace_sample    = 0              # trace 1 connection in N, 0 = off (live)
+//     slow_request_us = 0              # log requests at least this slow, 0 = off (live)
+//     flight_path     = /var/log/raw.flight  # flight recorder dumps, empty = stderr (restart)
+//     metrics_path    = /dev/shm/raw_server.metrics  # mmap metrics page, empty = off (restart)
+//     metrics_interval_ms = 1000       # metrics page refresh period (live)
+//     journal_dir     = /var/lib/raw   # durable request journal, empty = off (restart)
+//     journal_segment_mb = 64          # segment file size      (restart)
+//     journal_direct  = 1              # O_DIRECT segment writes (restart)
+//     journal_commit_us = 0            # extra group-commit wait (live)
+//     kv_max_mb       = 0              # SET/GET/DEL store size, 0 = off (restart)
+//     snapshot_path   = /var/lib/raw/kv.snap  # KV image, empty = off (restart)
+//     snapshot_interval_s = 0          # periodic snapshot, 0 = admin only (live)
+//     peer            = 127.0.0.1:9000 # cluster member, repeatable (restart)
+//     cluster_self    = -1             # my index in the peer list, -1 = off (restart)
+//
+// "restart" keys are read once at startup; a changed value in a reloaded file
+// is reported and ignored, and the running value is carried over.
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Compile-time ceiling for max_msg_len: sizes per-connection buffers so that
+// raising the live limit never needs a reallocation on the hot path.
+#define MSG_LEN_CAP 4096
+
+// text_mode values: what max_msg_len counts (see utf8.h).
+enum text_mode {
+    TEXT_MODE_BYTES,                // any bytes, length in bytes (original)
+    TEXT_MODE_UTF8,                 // well-formed UTF-8, length in code points
+};
+
+// delimiter values: what ends a request, and replies (see framer.h).
+enum delimiter {
+    DELIM_LF,                       // '\n' or '\r' (original)
+    DELIM_CRLF,                     // '\n', one '\r' before it stripped
+    DELIM_NUL,                      // '\0'
+};
+
+// close_mode values: who ends a finished connection (see worker.c).
+enum close_mode {
+    CLOSE_MODE_SERVER,              // server sends FIN first (original)
+    CLOSE_MODE_CLIENT,              // wait for the client's FIN
+    CLOSE_MODE_ABORT,               // RST via SO_LINGER 0
+};
+
+// accept_mode values: how workers share a listen address (see worker.c).
+enum accept_mode {
+    ACCEPT_MODE_REUSEPORT,          // one SO_REUSEPORT socket per worker
+    ACCEPT_MODE_EXCLUSIVE,          // one shared socket, EPOLLEXCLUSIVE
+};
+
+// io_backend values: how sockets are waited on and served (see io.h).
+enum io_backend_kind {
+    IO_BACKEND_EPOLL,               // per-worker epoll loops (original)
+    IO_BACKEND_BLOCKING,            // thread per connection
+    IO_BACKEND_URING,               // per-worker io_uring
+};
+
+#define CONFIG_MAX_LISTEN 8
+#define CONFIG_MAX_PEERS 16
+#define CONFIG_ADDR_LEN 64
+#define CONFIG_PATH_LEN 256
+
+struct raw_listen_addr {
+    char ip[CONFIG_ADDR_LEN];
+    int port;
+};
+
+struct raw_config {
+    // Restart-only.
+    struct raw_listen_addr listen[CONFIG_MAX_LISTEN];
+    int nlisten;
+    int workers;
+    int admin_port;
+    int cpu_pin;                    // first CPU for worker pinning, -1 = off
+    int accept_mode;                // enum accept_mode
+    int io_backend;                 // enum io_backend_kind
+    char journal_dir[CONFIG_PATH_LEN];  // empty: journal off
+    int journal_segment_mb;
+    int journal_direct;
+    int kv_max_mb;                  // 0: KV verbs off, lines are echoed
+    char snapshot_path[CONFIG_PATH_LEN];    // empty: no KV snapshots
+    struct raw_listen_addr peers[CONFIG_MAX_PEERS];  // same list on every member
+    int npeers;
+    int cluster_self;               // index of this instance in peers, -1 = off
+    char metrics_path[CONFIG_PATH_LEN];     // empty: no shared-memory metrics
+    char flight_path[CONFIG_PATH_LEN];      // empty: flight recorder dumps to stderr
+
+    // Applied live.
+    int max_msg_len;
+    int text_mode;                  // enum text_mode
+    int delimiter;                  // enum delimiter
+    int backlog;
+    int tcp_nodelay;
+    int rcvbuf;
+    int sndbuf;
+    int recv_timeout_ms;
+    int keepalive;
+    int deadlines;
+    int close_mode;                 // enum close_mode
+    int close_wait_ms;
+    int rebalance_ms;
+    int rebalance_threshold_pct;
+    int rate_limit_cps;
+    int rate_limit_burst;
+    int log_messages;
+    int journal_commit_us;
+    int snapshot_interval_s;
+    int tcp_info_ms;
+    int tcp_info_conns;
+    int trace_sample;
+    int slow_request_us;
+    int metrics_interval_ms;
+
+    uint64_t generation;            // 1 for the boot config, +1 per reload
+};
+
+// Defaults reproduce the original hard-coded server (0.0.0.0:9000, 20 bytes,
+// backlog 128, one worker).
+void config_defaults(struct raw_config *cfg);
+
+// Parses 'path' on top of the current contents of 'cfg'. Returns 0, or -1
+// after writing a one-line diagnostic (with line number) into err.
+int config_load(struct raw_config *cfg, const char *path, char *err, size_t errlen);
+
+// Adds "ip:port" to cfg->listen, replacing the default on first use.
+int config_add_listen(struct raw_config *cfg, const char *ip, int port);
+
+// Writes the effective configuration as "key = value" lines.
+void config_dump(const struct raw_config *cfg, FILE *out);
+
+// Publishes the boot configuration. Takes ownership of a heap-allocated cfg.
+void config_publish_initial(struct raw_config *cfg);
+
+// Hot-path accessor: one acquire load.
+const struct raw_config *config_current(void);
+
+// Starts the inotify watcher thread for 'path'. After each successful reload
+// 'on_reload' runs on the watcher thread with the old and new snapshots (both
+// valid for the duration of the call), e.g. to re-apply listen(2) backlogs.
+typedef void (*config_reload_fn)(const struct raw_config *old_cfg,
+                                 const struct raw_config *new_cfg);
+int config_watch_start(const char *path, config_reload_fn on_reload);
+
+// ============================================================================
+// Reader registration (QSBR)
+// ----------------------------------------------------------------------------
+// A reader is "online" while it may hold a config pointer. It reports a
+// quiescent state between units of work, and goes "offline" around blocking
+// waits so an idle thread never holds back reclamation.
+// ============================================================================
+struct config_reader;
+
+struct config_reader *config_reader_register(void);
+void config_reader_online(struct config_reader *r);
+void config_reader_quiescent(struct config_reader *r);
+void config_reader_offline(struct config_reader *r);
+
+#endif
@@ -0,0 +1,230 @@
+// ============================================================================
+// Flight recorder: ring registry, signal handlers and the dump
+// ----------------------------------------------------------------------------
+// Everything on the dump path must be async-signal-safe: no stdio, no malloc,
+// no locks. Lines are formatted by hand into a static buffer and written
+// with write(2). One dump at a time, and a crash always ends in death: a
+// crashing thread waits up to FLIGHT_FATAL_WAIT_MS for a dump in progress on
+// another thread (which may be stuck writing to a slow admin socket), then
+// dies without its own dump; one that crashes inside its own dump dies at
+// once. An on-demand request finding a dump in progress is dropped.
+// ============================================================================
+#define _GNU_SOURCE
+#include "flight.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FLIGHT_MAX_RINGS 256
+#define FLIGHT_ALTSTACK (64 * 1024)
+#define FLIGHT_FATAL_WAIT_MS 100
+
+static struct flight_ring *rings[FLIGHT_MAX_RINGS];
+static _Atomic int nrings;
+static char dump_path[256];
+static _Atomic pid_t dump_owner;            // tid holding the dump lock, 0 = free
+
+// Tick rate calibration: the clock and CLOCK_MONOTONIC at startup.
+static uint64_t start_tsc, start_ns;
+
+static const char *const event_names[] = {"accept", "read", "request", "write", "close",
+                                          "error", "migrate_out", "migrate_in", "refused"};
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);             // async-signal-safe
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+int flight_ring_init(struct flight_ring *r, int id) {
+    int i = atomic_load_explicit(&nrings, memory_order_relaxed);
+    if (i == FLIGHT_MAX_RINGS) {
+        errno = ENOSPC;
+        return -1;
+    }
+    r->recs = calloc(FLIGHT_EVENTS, sizeof(struct flight_rec));
+    if (!r->recs) return -1;
+    atomic_init(&r->n, 0);
+    r->id = id;
+    rings[i] = r;
+    atomic_store_explicit(&nrings, i + 1, memory_order_release);
+    return 0;
+}
+
+// ============================================================================
+// Formatting without stdio
+// ============================================================================
+struct out {
+    int fd;
+    size_t len;
+    char buf[8192];
+};
+
+static void out_flush(struct out *o) {
+    size_t off = 0;
+    while (off < o->len) {
+        ssize_t n = write(o->fd, o->buf + off, o->len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        off += (size_t)n;
+    }
+    o->len = 0;
+}
+
+static void out_str(struct out *o, const char *s) {
+    for (; *s; s++) {
+        if (o->len == sizeof(o->buf)) out_flush(o);
+        o->buf[o->len++] = *s;
+    }
+}
+
+static void out_u64(struct out *o, uint64_t v) {
+    char tmp[21];
+    int i = sizeof(tmp) - 1;
+    tmp[i] = '\0';
+    do {
+        tmp[--i] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    out_str(o, tmp + i);
+}
+
+static const char *signal_name(int sig) {
+    switch (sig) {
+    case 0: return "on demand";
+    case SIGSEGV: return "SIGSEGV";
+    case SIGBUS: return "SIGBUS";
+    case SIGILL: return "SIGILL";
+    case SIGFPE: return "SIGFPE";
+    case SIGABRT: return "SIGABRT";
+    case SIGUSR1: return "SIGUSR1";
+    default: return "signal";
+    }
+}
+
+static void dump_locked(int fd, int sig) {
+    static struct out o;                // too big for an alternate stack
+    o.fd = fd;
+    o.len = 0;
+
+    // Ticks per microsecond over the process lifetime so far.
+    uint64_t now_tsc = flight_clock(), now_ns = mono_ns();
+    uint64_t el_ns = now_ns - start_ns, el_ticks = now_tsc - start_tsc;
+    uint64_t per_us = el_ns >= 1000 ? el_ticks / (el_ns / 1000) : 1;
+    if (per_us == 0) per_us = 1;
+
+    int n = atomic_load_explicit(&nrings, memory_order_acquire);
+    out_str(&o, "flight recorder: ");
+    out_str(&o, signal_name(sig));
+    out_str(&o, ", pid ");
+    out_u64(&o, (uint64_t)getpid());
+    out_str(&o, ", ");
+    out_u64(&o, (uint64_t)n);
+    out_str(&o, " workers, ");
+    out_u64(&o, per_us);
+    out_str(&o, " ticks/us\n");
+
+    for (int i = 0; i < n; i++) {
+        struct flight_ring *r = rings[i];
+        uint64_t last = atomic_load_explicit(&r->n, memory_order_relaxed);
+        uint64_t first = last > FLIGHT_EVENTS ? last - FLIGHT_EVENTS : 0;
+        out_str(&o, "worker ");
+        out_u64(&o, (uint64_t)r->id);
+        out_str(&o, ": ");
+        out_u64(&o, last - first);
+        out_str(&o, " of ");
+        out_u64(&o, last);
+        out_str(&o, " events, oldest first\n");
+        for (uint64_t j = first; j < last; j++) {
+            const struct flight_rec *e = &r->recs[j & (FLIGHT_EVENTS - 1)];
+            uint64_t age = e->tsc <= now_tsc ? (now_tsc - e->tsc) / per_us : 0;
+            out_str(&o, "  -");
+            out_u64(&o, age);
+            out_str(&o, "us conn=");
+            out_u64(&o, e->conn);
+            out_str(&o, " ");
+            out_str(&o, e->event < sizeof(event_names) / sizeof(event_names[0])
+                            ? event_names[e->event] : "?");
+            out_str(&o, " ");
+            out_u64(&o, e->size);
+            out_str(&o, "\n");
+        }
+    }
+    out_flush(&o);
+}
+
+// Takes the dump lock for thread 'self', retrying every millisecond for up
+// to 'wait_ms'. Returns 0 with the lock held, or -1.
+static int dump_lock(pid_t self, int wait_ms) {
+    for (int i = 0;; i++) {
+        pid_t free_ = 0;
+        if (atomic_compare_exchange_strong(&dump_owner, &free_, self)) return 0;
+        if (i >= wait_ms) return -1;
+        struct timespec ms = {0, 1000000};
+        nanosleep(&ms, NULL);
+    }
+}
+
+void flight_dump(int fd, int sig) {
+    if (dump_lock(gettid(), 0) < 0) return;
+    dump_locked(fd, sig);
+    atomic_store(&dump_owner, 0);
+}
+
+// ============================================================================
+// Signals
+// ============================================================================
+static void on_signal(int sig) {
+    int saved = errno;
+    int fatal = sig != SIGUSR1;
+    pid_t self = gettid();
+    // A fault inside this thread's own dump must not wait for itself.
+    int dump = atomic_load(&dump_owner) != self &&
+               dump_lock(self, fatal ? FLIGHT_FATAL_WAIT_MS : 0) == 0;
+    if (dump) {
+        int fd = dump_path[0] ? open(dump_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)
+                              : STDERR_FILENO;
+        if (fd >= 0) {
+            dump_locked(fd, sig);
+            if (fd != STDERR_FILENO) close(fd);
+        }
+    }
+    if (fatal) {
+        // SA_RESETHAND restored the default action, and sig is blocked until
+        // we return: then the process dies as it would have without us. The
+        // lock stays held so no other thread starts a dump meanwhile.
+        raise(sig);
+        return;
+    }
+    if (dump) atomic_store(&dump_owner, 0);
+    errno = saved;
+}
+
+void flight_thread_init(void) {
+    stack_t ss = {.ss_sp = malloc(FLIGHT_ALTSTACK), .ss_size = FLIGHT_ALTSTACK, .ss_flags = 0};
+    if (ss.ss_sp && sigaltstack(&ss, NULL) < 0) free(ss.ss_sp);
+}
+
+void flight_install(const char *path) {
+    start_tsc = flight_clock();
+    start_ns = mono_ns();
+    snprintf(dump_path, sizeof(dump_path), "%s", path);
+
+    static const int fatal[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_ONSTACK | SA_RESETHAND;
+    for (size_t i = 0; i < sizeof(fatal) / sizeof(fatal[0]); i++) {
+        sigaction(fatal[i], &sa, NULL);
+    }
+    sa.sa_flags = SA_ONSTACK | SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+    flight_thread_init();
+}
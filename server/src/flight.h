@@ -0,0 +1,96 @@
+#ifndef RAW_FLIGHT_H
+#define RAW_FLIGHT_H
+
+// ============================================================================
+// Flight recorder: the last FLIGHT_EVENTS lifecycle events of every worker
+// ----------------------------------------------------------------------------
+// Always on. Each worker keeps a ring of small records (event, connection
+// id, size, timestamp) that it overwrites with plain stores: no locks, no
+// formatting, no syscalls, so the cost at production rates is a few stores
+// and a TSC read per event. The rings are only read when something asks:
+//
+//   SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT   dump, then die as before
+//   SIGUSR1                                    dump and keep running
+//   admin FLIGHT                               dump to the admin connection
+//
+// Signal dumps go to flight_path (appended), or stderr if it is empty. The
+// dump is written with write(2) from a fixed buffer, which is safe inside a
+// signal handler; workers keep running while it is taken, so the newest
+// record of a live worker may be torn.
+//
+// Timestamps are TSC ticks on x86 (CLOCK_MONOTONIC ns elsewhere). The dump
+// shows each event's age, using a tick rate measured between startup and
+// the dump itself.
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define FLIGHT_EVENTS 4096          // per worker, power of two (96 KiB)
+
+enum flight_event {
+    FLIGHT_ACCEPT,                  // size: fd
+    FLIGHT_READ,                    // size: bytes received, 0 = FIN
+    FLIGHT_REQUEST,                 // size: request length
+    FLIGHT_WRITE,                   // size: bytes sent
+    FLIGHT_CLOSE,                   // size: fd
+    FLIGHT_ERROR,                   // size: errno of a failed recv/send
+    FLIGHT_MIGRATE_OUT,             // size: target worker
+    FLIGHT_MIGRATE_IN,              // size: fd
+    FLIGHT_REFUSED,                 // size: fd (rate limit)
+};
+
+struct flight_rec {
+    uint64_t tsc;
+    uint64_t conn;
+    uint32_t size;
+    uint32_t event;                 // enum flight_event
+};
+
+struct flight_ring {
+    struct flight_rec *recs;
+    _Atomic uint64_t n;             // events ever recorded
+    int id;
+};
+
+// Allocates r's ring and makes it visible to dumps. Startup only.
+// Returns 0, or -1 with errno set.
+int flight_ring_init(struct flight_ring *r, int id);
+
+// Installs the signal handlers; 'path' is flight_path (copied).
+void flight_install(const char *path);
+
+// Gives the calling thread an alternate signal stack, so that a stack
+// overflow still gets its dump.
+void flight_thread_init(void);
+
+// Writes every ring, oldest event first, to fd; 'sig' is the reason shown
+// in the header (0: on demand). Skipped if another dump is in progress.
+void flight_dump(int fd, int sig);
+
+static inline uint64_t flight_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+#endif
+}
+
+// Owner thread only.
+static inline void flight_note(struct flight_ring *r, enum flight_event ev, uint64_t conn,
+                               uint64_t size) {
+    uint64_t n = atomic_load_explicit(&r->n, memory_order_relaxed);
+    struct flight_rec *e = &r->recs[n & (FLIGHT_EVENTS - 1)];
+    e->tsc = flight_clock();
+    e->conn = conn;
+    e->size = size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+    e->event = ev;
+    atomic_store_explicit(&r->n, n + 1, memory_order_relaxed);
+}
+
+#endif
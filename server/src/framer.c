@@ -0,0 +1,109 @@
+// ============================================================================
+// Request framing: one generic framer, expanded per configuration
+// ============================================================================
+#define _GNU_SOURCE
+#include "framer.h"
+#include "config.h"
+#include "utf8.h"
+
+#include <string.h>
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+// Longest payload, in bytes, that can still pass a max_msg_len check: a code
+// point takes up to 4 bytes, and any reply must fit MSG_LEN_CAP.
+ALWAYS_INLINE size_t byte_cap(size_t max_len, const int text) {
+    if (text != TEXT_MODE_UTF8) return max_len;
+    return 4 * max_len < MSG_LEN_CAP ? 4 * max_len : MSG_LEN_CAP;
+}
+
+ALWAYS_INLINE enum frame_status check_generic(const char *buf, size_t len, size_t max_len,
+                                              const int text) {
+    if (len > byte_cap(max_len, text)) return FRAME_TOO_LONG;
+    if (text == TEXT_MODE_UTF8) {
+        size_t cps;
+        if (utf8_count(buf, len, &cps) < 0) return FRAME_BAD_UTF8;
+        if (cps > max_len) return FRAME_TOO_LONG;
+    }
+    return FRAME_OK;
+}
+
+// First byte that ends a request, or NULL.
+ALWAYS_INLINE const char *find_end(const char *buf, size_t n, const int delim) {
+    if (delim == DELIM_NUL) return memchr(buf, '\0', n);
+    const char *nl = memchr(buf, '\n', n);
+    if (delim == DELIM_LF) {
+        const char *cr = memchr(buf, '\r', nl ? (size_t)(nl - buf) : n);
+        if (cr) return cr;
+    }
+    return nl;
+}
+
+ALWAYS_INLINE enum frame_status next_generic(const char *buf, size_t avail, size_t max_len,
+                                             struct frame *f, const int delim, const int text) {
+    // Payload, then (crlf) a '\r', then the delimiter: anything longer than
+    // that without a delimiter can never be accepted.
+    size_t window = byte_cap(max_len, text) + 1 + (delim == DELIM_CRLF);
+    const char *e = find_end(buf, avail < window ? avail : window, delim);
+    if (!e) return avail >= window ? FRAME_OVERFLOW : FRAME_PARTIAL;
+
+    size_t len = (size_t)(e - buf);
+    f->used = len + 1;
+    if (delim == DELIM_CRLF && len > 0 && buf[len - 1] == '\r') len--;
+    f->len = len;
+    return check_generic(buf, len, max_len, text);
+}
+
+ALWAYS_INLINE size_t skip_generic(const char *buf, size_t avail, const int delim) {
+    const char *e = find_end(buf, avail, delim);
+    return e ? (size_t)(e - buf) + 1 : 0;
+}
+
+// ============================================================================
+// Instances
+// ----------------------------------------------------------------------------
+// One row per delimiter, one column per text mode. Adding a delimiter is a
+// line here, a case in find_end() and a spelling in config.c.
+// ============================================================================
+#define FRAMER_DELIMITERS(X)                                                   \
+    X(lf, DELIM_LF, "\n", 1)                                                   \
+    X(crlf, DELIM_CRLF, "\r\n", 2)                                             \
+    X(nul, DELIM_NUL, "", 1)
+
+#define FRAMER_TEXT_MODES(X, d, delim, end, end_len)                          \
+    X(d, delim, end, end_len, bytes, TEXT_MODE_BYTES)                          \
+    X(d, delim, end, end_len, utf8, TEXT_MODE_UTF8)
+
+static enum frame_status check_bytes(const char *buf, size_t len, size_t max_len) {
+    return check_generic(buf, len, max_len, TEXT_MODE_BYTES);
+}
+
+static enum frame_status check_utf8(const char *buf, size_t len, size_t max_len) {
+    return check_generic(buf, len, max_len, TEXT_MODE_UTF8);
+}
+
+#define DEFINE_TEXT(d, delim, end, end_len, t, text)                           \
+    static enum frame_status next_##d##_##t(const char *buf, size_t avail,     \
+                                            size_t max_len, struct frame *f) { \
+        return next_generic(buf, avail, max_len, f, delim, text);              \
+    }
+#define DEFINE_DELIM(d, delim, end, end_len)                                   \
+    static size_t skip_##d(const char *buf, size_t avail) {                    \
+        return skip_generic(buf, avail, delim);                                \
+    }                                                                          \
+    FRAMER_TEXT_MODES(DEFINE_TEXT, d, delim, end, end_len)
+FRAMER_DELIMITERS(DEFINE_DELIM)
+#undef DEFINE_DELIM
+#undef DEFINE_TEXT
+
+#define ENTRY_TEXT(d, delim, end, end_len, t, text)                            \
+    [text] = {#d "/" #t, next_##d##_##t, check_##t, skip_##d, end, end_len},
+#define ENTRY_DELIM(d, delim, end, end_len)                                    \
+    [delim] = {FRAMER_TEXT_MODES(ENTRY_TEXT, d, delim, end, end_len)},
+static const struct framer framers[][2] = {FRAMER_DELIMITERS(ENTRY_DELIM)};
+#undef ENTRY_DELIM
+#undef ENTRY_TEXT
+
+const struct framer *framer_get(int delimiter, int text_mode) {
+    return &framers[delimiter][text_mode];
+}
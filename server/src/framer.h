@@ -0,0 +1,72 @@
+#ifndef RAW_FRAMER_H
+#define RAW_FRAMER_H
+
+// ============================================================================
+// Request framing, specialized per protocol configuration
+// ----------------------------------------------------------------------------
+// Splitting the input stream into requests is the innermost loop of the
+// server, and what it has to do depends on three settings:
+//
+//   delimiter    lf    '\n' or '\r' ends a line (the original behaviour:
+//                      "\r\n" is a line plus an ignored empty one)
+//                crlf  '\n' ends a line; one '\r' before it is stripped,
+//                      other '\r' bytes are data; replies end in "\r\n"
+//                nul   '\0' ends a request; replies end in '\0'
+//   text_mode    bytes, or utf8 (validate, count code points; utf8.h)
+//   max_msg_len  how far to look for the delimiter before giving up
+//
+// Testing those settings per byte or per line would put three data-
+// dependent branches in the loop. Instead framer.c expands one generic,
+// always-inlined framer once per (delimiter, text_mode) pair from an
+// X-macro, with both as compile-time constants: each instance contains only
+// its own delimiter search and validation, with the others folded away. The
+// worker picks the instance from the current config once per batch of input
+// (framer_get()), not per request.
+//
+// max_msg_len is live (config reload), so it stays a parameter rather than a
+// template argument; it only bounds the delimiter search: a line can never
+// be accepted once it is longer than the limit allows, so the framer looks
+// at most that far (not across a whole 16 KiB input buffer) and reports an
+// overflow the worker then discards up to the next delimiter.
+#include <stddef.h>
+
+enum frame_status {
+    FRAME_PARTIAL,                  // no delimiter yet: wait for more input
+    FRAME_OVERFLOW,                 // no delimiter within the longest
+                                    // acceptable line: skip() to the next one
+    FRAME_OK,
+    FRAME_TOO_LONG,                 // complete, but over max_msg_len
+    FRAME_BAD_UTF8,                 // complete, but not well-formed UTF-8
+    FRAME_EXPIRED,                  // complete, but past its deadline (set by
+                                    // the worker, deadlines = 1)
+};
+
+struct frame {
+    size_t len;                     // payload bytes (delimiter removed)
+    size_t used;                    // input consumed, delimiter included
+};
+
+struct framer {
+    const char *name;               // "lf/bytes", ...
+
+    // Frames the request at the start of buf[0, avail). For a complete line
+    // (OK, TOO_LONG, BAD_UTF8) fills *f.
+    enum frame_status (*next)(const char *buf, size_t avail, size_t max_len, struct frame *f);
+
+    // Validates a request that arrived without its delimiter (the peer
+    // half-closed): OK, TOO_LONG or BAD_UTF8.
+    enum frame_status (*check)(const char *buf, size_t len, size_t max_len);
+
+    // Bytes up to and including the next delimiter, or 0 if there is none
+    // (discarding an overflowed line).
+    size_t (*skip)(const char *buf, size_t avail);
+
+    char end[2];                    // reply terminator
+    unsigned end_len;
+};
+
+// The instance for a delimiter (enum delimiter) and text mode (enum
+// text_mode).
+const struct framer *framer_get(int delimiter, int text_mode);
+
+#endif
@@ -0,0 +1,251 @@
+// ============================================================================
+// I/O backends: selection, and the request path shared by blocking and uring
+// ============================================================================
+#define _GNU_SOURCE
+#include "io.h"
+#include "kv.h"
+#include "worker.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/socket.h>
+
+static int epoll_fds[MAX_WORKERS][CONFIG_MAX_LISTEN];
+static int epoll_workers, epoll_nlisten;
+
+static const char *epoll_unsupported(const struct raw_config *cfg) {
+    (void)cfg;
+    return NULL;
+}
+
+static const char *epoll_ignored(const struct raw_config *cfg) {
+    (void)cfg;
+    return NULL;
+}
+
+static int epoll_start(int n, int fds[][CONFIG_MAX_LISTEN], int nfds) {
+    epoll_workers = n;
+    epoll_nlisten = nfds;
+    for (int w = 0; w < n && w < MAX_WORKERS; w++) {
+        memcpy(epoll_fds[w], fds[w], sizeof(fds[w]));
+    }
+    return workers_start(n, fds, nfds);
+}
+
+static void epoll_apply_backlog(int backlog) {
+    io_listen_backlog(epoll_fds, epoll_workers, epoll_nlisten, backlog);
+}
+
+static const struct io_backend io_backend_epoll = {
+    .name = "epoll",
+    .unsupported = epoll_unsupported,
+    .ignored = epoll_ignored,
+    .start = epoll_start,
+    .join = workers_join,
+    .apply_backlog = epoll_apply_backlog,
+    .dump = workers_dump,
+};
+
+static const struct io_backend *const backends[] = {
+    [IO_BACKEND_EPOLL] = &io_backend_epoll,
+    [IO_BACKEND_BLOCKING] = &io_backend_blocking,
+    [IO_BACKEND_URING] = &io_backend_uring,
+};
+
+static const struct io_backend *current = &io_backend_epoll;
+
+const struct io_backend *io_backend_get(int kind) {
+    return backends[kind];
+}
+
+int io_start(const struct io_backend *io, int n, int fds[][CONFIG_MAX_LISTEN], int nfds) {
+    current = io;
+    return io->start(n, fds, nfds);
+}
+
+const struct io_backend *io_current(void) {
+    return current;
+}
+
+const char *io_core_unsupported(const struct raw_config *cfg) {
+    if (cfg->journal_dir[0]) return "journal_dir";
+    if (cfg->cluster_self >= 0) return "cluster_self";
+    if (cfg->deadlines) return "deadlines";
+    if (cfg->close_mode != CLOSE_MODE_SERVER) return "close_mode";
+    if (cfg->rate_limit_cps > 0) return "rate_limit_cps";
+    if (cfg->trace_sample > 0) return "trace_sample";
+    if (cfg->slow_request_us > 0) return "slow_request_us";
+    return NULL;
+}
+
+const char *io_core_ignored(const struct raw_config *cfg) {
+    if (cfg->tcp_info_ms > 0) return "tcp_info_ms";
+    return NULL;
+}
+
+void io_socket_options(int fd, const struct raw_config *cfg, struct raw_stats *st) {
+    if (cfg->tcp_nodelay) {
+        int one = 1;
+        STAT_INC(st, sys_other);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    if (cfg->rcvbuf > 0) {
+        STAT_INC(st, sys_other);
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &cfg->rcvbuf, sizeof(cfg->rcvbuf));
+    }
+    if (cfg->sndbuf > 0) {
+        STAT_INC(st, sys_other);
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &cfg->sndbuf, sizeof(cfg->sndbuf));
+    }
+}
+
+void io_listen_backlog(int fds[][CONFIG_MAX_LISTEN], int n, int nfds, int backlog) {
+    for (int w = 0; w < n; w++) {
+        for (int i = 0; i < nfds; i++) {
+            if (listen(fds[w][i], backlog) < 0) perror("listen (backlog reload)");
+        }
+    }
+}
+
+void io_pin_worker(pthread_t thread, int id, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (rc != 0) {
+        fprintf(stderr, "⚠️  worker %d: cannot pin to CPU %d: %s\n", id, cpu, strerror(rc));
+    }
+}
+
+// ============================================================================
+// Replies (every backend)
+// ============================================================================
+static void append(char *out, unsigned *out_len, const char *data, size_t len) {
+    memcpy(out + *out_len, data, len);          // callers leave IO_REPLY_MAX of room
+    *out_len += (unsigned)len;
+}
+
+int io_reply(char *out, unsigned *out_len, const struct raw_config *cfg, struct raw_stats *st,
+             struct arena *scratch, const struct framer *fr, const char *msg, size_t len,
+             enum frame_status verdict) {
+    size_t n;
+    int kv = 0;
+    if (verdict == FRAME_TOO_LONG) {
+        static const char err[] = "ERR too long";
+        append(out, out_len, err, sizeof(err) - 1);
+        STAT_INC(st, too_long);
+        if (cfg->log_messages) {
+            arena_log(scratch, "⚠️  client sent overlong message; error sent\n");
+        }
+    } else if (verdict == FRAME_EXPIRED) {
+        static const char err[] = "ERR deadline";
+        append(out, out_len, err, sizeof(err) - 1);
+        STAT_INC(st, deadline_expired);
+    } else if (verdict == FRAME_BAD_UTF8) {
+        static const char err[] = "ERR invalid utf-8";
+        append(out, out_len, err, sizeof(err) - 1);
+        STAT_INC(st, bad_utf8);
+        if (cfg->log_messages) {
+            arena_log(scratch, "⚠️  client sent invalid UTF-8; error sent\n");
+        }
+    } else if (kv_enabled() && (n = kv_execute(msg, len, out + *out_len, st))) {
+        *out_len += (unsigned)n - 1;            // the framer's end replaces '\n'
+        kv = 1;
+        if (cfg->log_messages) arena_log(scratch, "🗄️  kv \"%.*s\"\n", (int)len, msg);
+    } else {
+        append(out, out_len, msg, len);
+        if (cfg->log_messages) {
+            arena_log(scratch, "🔁  echoed \"%.*s\" (%zu bytes)\n", (int)len, msg, len);
+        }
+    }
+    append(out, out_len, fr->end, fr->end_len);
+    return kv;
+}
+
+// ============================================================================
+// Request path
+// ----------------------------------------------------------------------------
+// The same protocol as worker.c's process_input()/handle_message(), minus
+// what only the epoll backend implements: no journal holds, no forwarding,
+// no deadline headers. Replies are ready as soon as they are appended.
+// ============================================================================
+static void answer(struct io_session *s, const struct raw_config *cfg, struct raw_stats *st,
+                   struct arena *scratch, const struct framer *fr, const char *msg,
+                   size_t len, enum frame_status verdict) {
+    io_reply(s->out, &s->out_len, cfg, st, scratch, fr, msg, len, verdict);
+    s->msgs++;
+    STAT_INC(st, msgs);
+    if (!cfg->keepalive) s->closing = 1;
+    arena_reset(scratch);
+}
+
+size_t io_serve(struct io_session *s, const struct raw_config *cfg, struct raw_stats *st,
+                struct arena *scratch) {
+    const struct framer *fr = framer_get(cfg->delimiter, cfg->text_mode);
+    const size_t max_len = (size_t)cfg->max_msg_len;
+    size_t pos = 0;
+    unsigned before = s->in_len;
+
+    while (pos < s->in_len && !s->closing && IO_OUT_BUF - s->out_len >= IO_REPLY_MAX) {
+        char *start = s->in + pos;
+        size_t avail = s->in_len - pos;
+        struct frame f;
+        enum frame_status st_frame;
+
+        if (s->discarding) {
+            size_t used = fr->skip(start, avail);
+            if (!used) {
+                pos = s->in_len;
+                break;
+            }
+            f.len = 0;
+            f.used = used;
+            st_frame = FRAME_TOO_LONG;
+        } else {
+            st_frame = fr->next(start, avail, max_len, &f);
+            if (st_frame == FRAME_PARTIAL) break;
+            if (st_frame == FRAME_OVERFLOW) {
+                s->discarding = 1;
+                continue;
+            }
+        }
+        pos += f.used;
+        s->discarding = 0;
+
+        if (st_frame != FRAME_OK) {
+            answer(s, cfg, st, scratch, fr, NULL, 0, st_frame);
+        } else if (f.len > 0) {
+            answer(s, cfg, st, scratch, fr, start, f.len, FRAME_OK);
+        } else if (!cfg->keepalive) {
+            if (cfg->log_messages) printf("ℹ️  connection closed with no data\n");
+            s->closing = 1;
+        }
+    }
+
+    if (s->closing) {
+        s->in_len = 0;
+    } else if (pos > 0) {
+        memmove(s->in, s->in + pos, s->in_len - pos);
+        s->in_len -= (unsigned)pos;
+    }
+
+    // FIN mid-line: what arrived is the final request (see worker.c).
+    if (s->eof && !s->closing && IO_OUT_BUF - s->out_len >= IO_REPLY_MAX) {
+        enum frame_status st_frame = s->discarding ? FRAME_TOO_LONG
+                                     : s->in_len > 0 ? fr->check(s->in, s->in_len, max_len)
+                                                     : FRAME_OK;
+        if (s->in_len > 0 || s->discarding || s->out_len > 0) STAT_INC(st, half_close);
+        if (st_frame != FRAME_OK) {
+            answer(s, cfg, st, scratch, fr, NULL, 0, st_frame);
+        } else if (s->in_len > 0) {
+            answer(s, cfg, st, scratch, fr, s->in, s->in_len, FRAME_OK);
+        } else if (cfg->log_messages && s->msgs == 0) {
+            printf("ℹ️  connection closed with no data\n");
+        }
+        s->in_len = 0;
+        s->closing = 1;
+    }
+    return before - s->in_len;
+}
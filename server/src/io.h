@@ -0,0 +1,137 @@
+#ifndef RAW_IO_H
+#define RAW_IO_H
+
+// ============================================================================
+// I/O backends
+// ----------------------------------------------------------------------------
+// How the server waits for sockets and moves bytes is a runtime choice
+// (io_backend, restart-only), so that the models can be measured against each
+// other on the same machine, build and workload (tools/backend_compare.sh):
+//
+//   epoll     per-worker epoll(7) loops over non-blocking sockets (worker.c).
+//             The default and the only backend with every feature: journal,
+//             cluster, deadlines, close modes, rate limiting, rebalancing,
+//             tracing, the slow-request log.
+//   blocking  one thread per connection doing blocking recv()/send(), plus
+//             one blocking accept() thread per listening socket
+//             (io_blocking.c). The classic model: no readiness API at all,
+//             the kernel scheduler does the multiplexing.
+//   uring     one io_uring per worker (io_uring.c): accept, recv, send and
+//             close are submitted as operations and reaped as completions,
+//             many per io_uring_enter() call.
+//
+// blocking and uring serve the core protocol through the shared request path
+// below (framing, echo, KV, errors, keepalive, idle timeout, half-close).
+// Features they do not implement are refused at startup rather than silently
+// dropped (io_backend->unsupported()); live keys turned on later by a reload
+// are ignored by them. TCP_INFO sampling (tcp_info_ms, on by default) is the
+// exception: it only feeds the TCPINFO histograms, so they start with a
+// warning (io_backend->ignored()) and the histograms stay empty.
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "config.h"
+#include "framer.h"
+#include "stats.h"
+
+struct io_backend {
+    const char *name;               // spelling in the config file
+
+    // The first setting in cfg this backend cannot honour ("journal_dir",
+    // ...), or NULL.
+    const char *(*unsupported)(const struct raw_config *cfg);
+
+    // The first setting in cfg this backend leaves off without harm to the
+    // protocol ("tcp_info_ms"), warned about at startup; or NULL.
+    const char *(*ignored)(const struct raw_config *cfg);
+
+    // Takes ownership of the listening sockets fds[w][0..nfds) of worker w
+    // (shared between workers with accept_mode = exclusive) and starts
+    // serving on n workers. Returns 0 or -1 with errno set.
+    int (*start)(int n, int fds[][CONFIG_MAX_LISTEN], int nfds);
+
+    // Blocks until every serving thread exits (in practice: forever).
+    void (*join)(void);
+
+    // Re-issues listen(2) on every listening socket with a new backlog.
+    void (*apply_backlog)(int backlog);
+
+    // Admin WORKERS: one line per serving unit.
+    void (*dump)(FILE *out);
+};
+
+// Instances (io_blocking.c, io_uring.c; epoll is io.c over worker.h).
+extern const struct io_backend io_backend_blocking;
+extern const struct io_backend io_backend_uring;
+
+// The backend for an enum io_backend_kind value.
+const struct io_backend *io_backend_get(int kind);
+
+// Starts 'io' and makes it the current backend. Returns io->start()'s result.
+int io_start(const struct io_backend *io, int n, int fds[][CONFIG_MAX_LISTEN], int nfds);
+
+// The running backend (admin, config reloads).
+const struct io_backend *io_current(void);
+
+// ============================================================================
+// Shared request path (blocking, uring)
+// ----------------------------------------------------------------------------
+// A session is one connection's buffers and protocol state, independent of
+// how its bytes arrive. The backend appends received bytes to in[] (setting
+// eof on FIN), calls io_serve(), writes out[0, out_len) and repeats; once
+// 'closing' is set and the output is written, it closes the socket.
+// ============================================================================
+#define IO_IN_BUF 16384             // >= MSG_LEN_CAP + room for pipelined lines
+#define IO_OUT_BUF 16384
+#define IO_REPLY_MAX (MSG_LEN_CAP + 16)     // output room io_reply() needs
+
+struct io_session {
+    int fd;
+    int discarding;                 // inside an overlong line: drop to its end
+    int closing;                    // no more requests; close once written
+    int eof;                        // peer sent FIN
+    uint64_t msgs;
+    unsigned in_len, out_len;
+    char in[IO_IN_BUF];
+    char out[IO_OUT_BUF];
+};
+
+// Frames and answers the complete requests in s->in, appending replies to
+// s->out until it has no room for another; with s->eof set, what is left is
+// the final request. Returns the number of input bytes consumed: after
+// writing the output, call again while that is nonzero and input remains.
+// 'scratch' is the calling thread's arena, reset after each request.
+size_t io_serve(struct io_session *s, const struct raw_config *cfg, struct raw_stats *st,
+                struct arena *scratch);
+
+// The reply to one framed request, appended with its terminator at
+// out + *out_len (IO_REPLY_MAX bytes of room): the error for a TOO_LONG,
+// EXPIRED or BAD_UTF8 verdict, else the KV store's answer to a KV command,
+// else the echo. Counts the error stats and queues the log line in 'scratch';
+// the caller counts the request and resets the arena. Every backend answers
+// through here (worker.c first handles cluster forwarding). Returns 1 if msg
+// was a KV command, else 0.
+int io_reply(char *out, unsigned *out_len, const struct raw_config *cfg, struct raw_stats *st,
+             struct arena *scratch, const struct framer *fr, const char *msg, size_t len,
+             enum frame_status verdict);
+
+// Settings only the epoll backend implements; shared by the others'
+// unsupported() and ignored() hooks.
+const char *io_core_unsupported(const struct raw_config *cfg);
+const char *io_core_ignored(const struct raw_config *cfg);
+
+// Per-connection socket options (tcp_nodelay, rcvbuf, sndbuf), counted in st.
+void io_socket_options(int fd, const struct raw_config *cfg, struct raw_stats *st);
+
+// listen(2) again on fds[w][0..nfds) for n workers.
+void io_listen_backlog(int fds[][CONFIG_MAX_LISTEN], int n, int nfds, int backlog);
+
+// Pins worker thread 'id' to 'cpu' (cpu_pin); a failure is reported, not
+// fatal. Pinning keeps a worker's connections, buffers and stats lines in one
+// core's caches and makes per-core scaling measurable: with N pinned workers
+// the server uses exactly N cores, and load generators can be kept off them.
+void io_pin_worker(pthread_t thread, int id, int cpu);
+
+#endif
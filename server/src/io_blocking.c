@@ -0,0 +1,301 @@
+// ============================================================================
+// io_backend = blocking: one thread per connection
+// ----------------------------------------------------------------------------
+// Each listening socket gets an accept thread parked in a blocking accept4();
+// each accepted connection gets a thread of its own that loops blocking
+// recv() → io_serve() → blocking send() until the conversation ends. There
+// is no readiness API and no non-blocking socket anywhere: a thread waiting
+// for its client simply sleeps in the kernel.
+//
+// Threads come and go, but counters need a single writer each (stats.h) and
+// config readers are registered once, so both live in a fixed table of
+// connection slots: a connection thread takes a free slot for its lifetime,
+// and the slot's counters and QSBR reader go with it. When every slot is
+// taken the connection is refused with "ERR busy", like the rate limiter
+// does; BLOCKING_MAX_CONNS is the backend's concurrency limit.
+//
+// Idle timeouts are SO_RCVTIMEO on the socket: recv() fails with EAGAIN after
+// recv_timeout_ms without input.
+// ============================================================================
+#define _GNU_SOURCE
+#include "io.h"
+#include "worker.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BLOCKING_MAX_CONNS 1024
+#define BLOCKING_STACK (128 * 1024) // io_serve() + printf; sessions are on the heap
+#define ACCEPT_RETRY_MS 100         // after EMFILE/ENFILE
+
+struct acceptor {
+    int fd;
+    pthread_t thread;
+    struct raw_stats *stats;
+};
+
+struct slot {
+    struct raw_stats *stats;
+    struct config_reader *rcu;
+    struct io_session *session;     // allocated on first use, then kept
+    struct arena scratch;           // likewise
+    struct sockaddr_in peer;
+};
+
+static struct acceptor *acceptors;
+static int nacceptors;
+static struct slot slots[BLOCKING_MAX_CONNS];
+static pthread_attr_t conn_attr;
+
+// Free slot indices, a stack under one lock: taken once per connection.
+static pthread_mutex_t free_lock = PTHREAD_MUTEX_INITIALIZER;
+static int free_slots[BLOCKING_MAX_CONNS];
+static int nfree;
+
+static int listen_fds[MAX_WORKERS][CONFIG_MAX_LISTEN];
+static int nworkers, nlisten;
+
+static struct slot *slot_take(void) {
+    struct slot *sl = NULL;
+    pthread_mutex_lock(&free_lock);
+    if (nfree > 0) sl = &slots[free_slots[--nfree]];
+    pthread_mutex_unlock(&free_lock);
+    return sl;
+}
+
+static void slot_put(struct slot *sl) {
+    pthread_mutex_lock(&free_lock);
+    free_slots[nfree++] = (int)(sl - slots);
+    pthread_mutex_unlock(&free_lock);
+}
+
+// Writes the whole reply buffer. Returns -1 if the peer is gone.
+static int send_all(struct io_session *s, struct raw_stats *st) {
+    unsigned off = 0;
+    while (off < s->out_len) {
+        STAT_INC(st, sys_send);
+        ssize_t n = send(s->fd, s->out + off, s->out_len - off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EPIPE && errno != ECONNRESET) perror("send");
+            return -1;
+        }
+        off += (unsigned)n;
+    }
+    s->out_len = 0;
+    return 0;
+}
+
+static void *conn_main(void *arg) {
+    struct slot *sl = arg;
+    struct raw_stats *st = sl->stats;
+    struct io_session *s = sl->session;
+    int fd = s->fd;
+
+    STAT_INC(st, conns);
+    config_reader_online(sl->rcu);
+    const struct raw_config *cfg = config_current();
+    if (cfg->log_messages) {
+        char ip[INET_ADDRSTRLEN] = "";
+        inet_ntop(AF_INET, &sl->peer.sin_addr, ip, sizeof(ip));
+        printf("👋  client connected from %s:%d\n", ip, ntohs(sl->peer.sin_port));
+    }
+    io_socket_options(fd, cfg, st);
+    if (cfg->recv_timeout_ms > 0) {
+        struct timeval tv = {cfg->recv_timeout_ms / 1000, (cfg->recv_timeout_ms % 1000) * 1000};
+        STAT_INC(st, sys_other);
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    config_reader_offline(sl->rcu);
+
+    int done = 0;
+    while (!done) {
+        STAT_INC(st, sys_recv);
+        ssize_t n = recv(fd, s->in + s->in_len, IO_IN_BUF - s->in_len, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                config_reader_online(sl->rcu);
+                if (config_current()->log_messages) {
+                    printf("⏱️  idle timeout, closing connection on fd %d\n", fd);
+                }
+                config_reader_offline(sl->rcu);
+            } else if (errno != ECONNRESET) {
+                perror("recv");
+            }
+            break;
+        }
+        if (n == 0) s->eof = 1;
+        s->in_len += (unsigned)n;
+
+        // Serve and write in turns: the output buffer may fill before the
+        // input is used up. Only framing needs the config; the reader is
+        // offline while send() may block.
+        size_t consumed;
+        do {
+            config_reader_online(sl->rcu);
+            consumed = io_serve(s, config_current(), st, &sl->scratch);
+            config_reader_offline(sl->rcu);
+            if (send_all(s, st) < 0) {
+                done = 1;
+                break;
+            }
+        } while (consumed > 0 && s->in_len > 0);
+        if (s->closing) {
+            if (s->eof) STAT_INC(st, close_passive);
+            else STAT_INC(st, close_active);
+            done = 1;
+        }
+    }
+
+    STAT_INC(st, sys_close);
+    close(fd);
+    STAT_DEC(st, conns);
+    slot_put(sl);
+    return NULL;
+}
+
+static void *acceptor_main(void *arg) {
+    struct acceptor *a = arg;
+    pthread_setname_np(pthread_self(), "raw-accept");
+    for (;;) {
+        struct sockaddr_in cli;
+        socklen_t clen = sizeof(cli);
+        STAT_INC(a->stats, sys_accept);
+        int cfd = accept4(a->fd, (struct sockaddr *)&cli, &clen, SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            if (errno == EMFILE || errno == ENFILE) {
+                struct timespec nap = {0, ACCEPT_RETRY_MS * 1000000L};
+                nanosleep(&nap, NULL);
+            }
+            continue;
+        }
+
+        struct slot *sl = slot_take();
+        if (sl && !sl->session) {
+            sl->session = malloc(sizeof(*sl->session));
+            if (!sl->session || arena_init(&sl->scratch, ARENA_BYTES, sl->stats) < 0) {
+                free(sl->session);
+                sl->session = NULL;
+                slot_put(sl);
+                sl = NULL;
+            }
+        }
+        if (!sl) {
+            static const char busy[] = "ERR busy\n";
+            STAT_INC(a->stats, sys_send);
+            send(cfd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+            STAT_INC(a->stats, refused);
+            STAT_INC(a->stats, sys_close);
+            close(cfd);
+            continue;
+        }
+        memset(sl->session, 0, offsetof(struct io_session, in));
+        sl->session->fd = cfd;
+        sl->peer = cli;
+        STAT_INC(a->stats, accepted);
+
+        pthread_t tid;
+        STAT_INC(a->stats, sys_other);
+        int rc = pthread_create(&tid, &conn_attr, conn_main, sl);
+        if (rc != 0) {
+            fprintf(stderr, "⚠️  blocking: cannot start a connection thread: %s\n", strerror(rc));
+            STAT_INC(a->stats, sys_close);
+            close(cfd);
+            slot_put(sl);
+        }
+    }
+    return NULL;
+}
+
+// Counters: one stats slot per accept thread, then one per connection slot.
+static int blocking_start(int n, int fds[][CONFIG_MAX_LISTEN], int nfds) {
+    nworkers = n;
+    nlisten = nfds;
+    nacceptors = n * nfds;
+    acceptors = calloc((size_t)nacceptors, sizeof(*acceptors));
+    if (!acceptors) return -1;
+    stats_init(nacceptors + BLOCKING_MAX_CONNS);
+
+    for (int i = 0; i < BLOCKING_MAX_CONNS; i++) {
+        slots[i].stats = stats_worker(nacceptors + i);
+        slots[i].rcu = config_reader_register();
+        config_reader_offline(slots[i].rcu);
+        free_slots[i] = BLOCKING_MAX_CONNS - 1 - i;
+    }
+    nfree = BLOCKING_MAX_CONNS;
+
+    size_t stack = BLOCKING_STACK < PTHREAD_STACK_MIN ? PTHREAD_STACK_MIN : BLOCKING_STACK;
+    pthread_attr_init(&conn_attr);
+    pthread_attr_setstacksize(&conn_attr, stack);
+    pthread_attr_setdetachstate(&conn_attr, PTHREAD_CREATE_DETACHED);
+
+    // With accept_mode = exclusive the workers share one socket per address;
+    // several threads blocked in accept() on it is fine, the kernel wakes one.
+    for (int w = 0; w < n; w++) {
+        for (int i = 0; i < nfds; i++) {
+            struct acceptor *a = &acceptors[w * nfds + i];
+            listen_fds[w][i] = fds[w][i];
+            a->fd = fds[w][i];
+            a->stats = stats_worker(w * nfds + i);
+            int rc = pthread_create(&a->thread, NULL, acceptor_main, a);
+            if (rc != 0) {
+                errno = rc;
+                return -1;
+            }
+        }
+    }
+    printf("🧵  io_backend = blocking: %d accept thread%s, up to %d connection threads\n",
+           nacceptors, nacceptors == 1 ? "" : "s", BLOCKING_MAX_CONNS);
+    return 0;
+}
+
+static void blocking_join(void) {
+    for (int i = 0; i < nacceptors; i++) pthread_join(acceptors[i].thread, NULL);
+}
+
+static void blocking_apply_backlog(int backlog) {
+    io_listen_backlog(listen_fds, nworkers, nlisten, backlog);
+}
+
+static void blocking_dump(FILE *out) {
+    struct raw_stats_snapshot s;
+    stats_read(-1, &s);
+    struct rusage ru;
+    double cpu = 0.0;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        cpu = (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+              (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    }
+    pthread_mutex_lock(&free_lock);
+    int busy = BLOCKING_MAX_CONNS - nfree;
+    pthread_mutex_unlock(&free_lock);
+    uint64_t sys = stats_syscalls(&s);
+    fprintf(out, "blocking: accept_threads=%d conn_threads=%d/%d accepted=%llu refused=%llu"
+                 " msgs=%llu cpu=%.3fs (process) syscalls/msg=%.2f\n",
+            nacceptors, busy, BLOCKING_MAX_CONNS, (unsigned long long)s.accepted,
+            (unsigned long long)s.refused, (unsigned long long)s.msgs, cpu,
+            s.msgs ? (double)sys / (double)s.msgs : 0.0);
+}
+
+const struct io_backend io_backend_blocking = {
+    .name = "blocking",
+    .unsupported = io_core_unsupported,
+    .ignored = io_core_ignored,
+    .start = blocking_start,
+    .join = blocking_join,
+    .apply_backlog = blocking_apply_backlog,
+    .dump = blocking_dump,
+};
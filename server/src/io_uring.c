@@ -0,0 +1,502 @@
+// ============================================================================
+// io_backend = uring: one io_uring per worker
+// ----------------------------------------------------------------------------
+// Instead of asking the kernel which sockets are ready and then making one
+// syscall per socket (epoll), a worker queues the operations themselves in a
+// submission ring shared with the kernel and collects their results from a
+// completion ring:
+//
+//   ACCEPT   multishot: one submission per listener keeps producing a
+//            completion per new connection
+//   RECV     into session->in; with recv_timeout_ms, linked to a
+//            LINK_TIMEOUT that cancels it (-ECANCELED) when the client is idle
+//   SEND     session->out; a short send is resubmitted for the rest
+//   CLOSE    once the last reply is written
+//
+// Each connection has exactly one RECV or SEND in flight, and what comes next
+// is decided when it completes (step()). A single io_uring_enter() per loop
+// iteration both submits everything queued since the last one and waits for
+// the next completion, so under load one syscall carries many operations:
+// sys_uring_enter / msgs is the number to compare with epoll's
+// syscalls/msg.
+//
+// The rings are driven with the raw syscalls and mmap (no liburing). Where
+// the kernel supports it (6.1+) a ring is single-issuer with deferred task
+// work: completions are only produced when the worker asks for them, which
+// saves the kernel interrupting it mid-batch.
+// ============================================================================
+#define _GNU_SOURCE
+#include "io.h"
+#include "worker.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define URING_ENTRIES 1024          // submission ring; completions get 4x
+#define URING_CONN_FREE_MAX 1024
+
+// user_data: a conn pointer (8-byte aligned) with the operation in the low
+// bits; accepts carry the listener index instead.
+enum { UD_ACCEPT, UD_RECV, UD_SEND, UD_TIMEOUT, UD_CLOSE };
+#define UD_OP(ud) ((unsigned)((ud) & 7u))
+#define UD_CONN(ud) ((struct uconn *)(uintptr_t)((ud) & ~(uint64_t)7u))
+
+struct uconn {
+    struct uconn *next;             // free list
+    unsigned out_off;               // written part of session.out
+    struct __kernel_timespec idle;  // LINK_TIMEOUT argument
+    struct io_session s;
+};
+
+struct ring {
+    int fd;
+    unsigned flags;                 // IORING_SETUP_* in effect
+    _Atomic unsigned *sq_head, *sq_tail, *cq_head, *cq_tail;
+    unsigned sq_mask, sq_entries, cq_mask;
+    unsigned *sq_array;
+    unsigned sq_local;              // our tail, published before each enter
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_map, *cq_map;
+    size_t sq_size, cq_size;
+};
+
+struct uworker {
+    int id;
+    pthread_t thread;
+    struct config_reader *rcu;
+    struct raw_stats *stats;
+    struct arena scratch;
+    struct ring ring;
+    int fds[CONFIG_MAX_LISTEN];
+    int nfds;
+    int multishot;                  // kernel takes IORING_ACCEPT_MULTISHOT
+    unsigned unarmed;               // bit i: fds[i] has no accept in flight
+    struct uconn *free_list;
+    int nfree;
+};
+
+static struct uworker uworkers[MAX_WORKERS];
+static int nworkers, nlisten;
+static int listen_fds[MAX_WORKERS][CONFIG_MAX_LISTEN];
+
+// ============================================================================
+// Ring setup and the two queues
+// ============================================================================
+static int ring_setup(struct ring *r, unsigned flags) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = flags | IORING_SETUP_CQSIZE;
+    p.cq_entries = 4 * URING_ENTRIES;
+    int fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (fd < 0) return -1;
+    r->fd = fd;
+    r->flags = flags;
+
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && r->cq_size > r->sq_size) r->sq_size = r->cq_size;
+    r->sq_map = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                     IORING_OFF_SQ_RING);
+    if (r->sq_map == MAP_FAILED) goto fail;
+    r->cq_map = single ? r->sq_map
+                       : mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (r->cq_map == MAP_FAILED) goto fail;
+    r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) goto fail;
+
+    char *sq = r->sq_map, *cq = r->cq_map;
+    r->sq_head = (void *)(sq + p.sq_off.head);
+    r->sq_tail = (void *)(sq + p.sq_off.tail);
+    r->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_entries = p.sq_entries;
+    r->sq_array = (void *)(sq + p.sq_off.array);
+    r->sq_local = atomic_load_explicit(r->sq_tail, memory_order_relaxed);
+    r->cq_head = (void *)(cq + p.cq_off.head);
+    r->cq_tail = (void *)(cq + p.cq_off.tail);
+    r->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (void *)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    close(fd);
+    return -1;
+}
+
+// Submits what is queued and, with 'wait', blocks for one completion.
+static int ring_enter(struct uworker *w, int wait) {
+    struct ring *r = &w->ring;
+    atomic_store_explicit(r->sq_tail, r->sq_local, memory_order_release);
+    unsigned pending = r->sq_local - atomic_load_explicit(r->sq_head, memory_order_acquire);
+    STAT_INC(w->stats, sys_uring_enter);
+    return (int)syscall(__NR_io_uring_enter, r->fd, pending, wait ? 1 : 0,
+                        wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+// Makes room for n submissions (flushing the queue to the kernel if it is
+// full). Returns -1 if there is none.
+static int sq_reserve(struct uworker *w, unsigned n) {
+    struct ring *r = &w->ring;
+    if (r->sq_local - atomic_load_explicit(r->sq_head, memory_order_acquire) + n <= r->sq_entries) {
+        return 0;
+    }
+    ring_enter(w, 0);
+    return r->sq_local - atomic_load_explicit(r->sq_head, memory_order_acquire) + n <=
+                   r->sq_entries
+               ? 0
+               : -1;
+}
+
+// The next submission entry, cleared; room must have been reserved.
+static struct io_uring_sqe *sq_next(struct uworker *w) {
+    struct ring *r = &w->ring;
+    unsigned i = r->sq_local++ & r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[i];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[i] = i;
+    STAT_INC(w->stats, uring_sqes);
+    return sqe;
+}
+
+// ============================================================================
+// Connections
+// ============================================================================
+static struct uconn *uconn_alloc(struct uworker *w) {
+    struct uconn *c = w->free_list;
+    if (c) {
+        w->free_list = c->next;
+        w->nfree--;
+        STAT_DEC(w->stats, pool_free);
+    } else {
+        c = malloc(sizeof(*c));
+        if (!c) return NULL;
+        STAT_INC(w->stats, pool_malloc);
+    }
+    memset(c, 0, offsetof(struct uconn, s) + offsetof(struct io_session, in));
+    return c;
+}
+
+static void uconn_release(struct uworker *w, struct uconn *c) {
+    if (w->nfree >= URING_CONN_FREE_MAX) {
+        free(c);
+        return;
+    }
+    c->next = w->free_list;
+    w->free_list = c;
+    w->nfree++;
+    STAT_INC(w->stats, pool_free);
+}
+
+// Nothing is in flight for c when this runs, so it can be recycled at once;
+// the CLOSE operation only needs the fd.
+static void uconn_close(struct uworker *w, struct uconn *c) {
+    if (sq_reserve(w, 1) == 0) {
+        struct io_uring_sqe *sqe = sq_next(w);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = c->s.fd;
+        sqe->user_data = UD_CLOSE;
+    } else {
+        STAT_INC(w->stats, sys_close);
+        close(c->s.fd);
+    }
+    STAT_DEC(w->stats, conns);
+    uconn_release(w, c);
+}
+
+static void submit_recv(struct uworker *w, struct uconn *c, const struct raw_config *cfg) {
+    int timed = cfg->recv_timeout_ms > 0;
+    if (sq_reserve(w, timed ? 2 : 1) < 0) {
+        uconn_close(w, c);
+        return;
+    }
+    struct io_uring_sqe *sqe = sq_next(w);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->s.fd;
+    sqe->addr = (uintptr_t)(c->s.in + c->s.in_len);
+    sqe->len = IO_IN_BUF - c->s.in_len;
+    sqe->user_data = (uintptr_t)c | UD_RECV;
+    if (timed) {
+        // Cancels the recv, which then completes with -ECANCELED.
+        sqe->flags |= IOSQE_IO_LINK;
+        c->idle.tv_sec = cfg->recv_timeout_ms / 1000;
+        c->idle.tv_nsec = (long long)(cfg->recv_timeout_ms % 1000) * 1000000;
+        struct io_uring_sqe *t = sq_next(w);
+        t->opcode = IORING_OP_LINK_TIMEOUT;
+        t->addr = (uintptr_t)&c->idle;
+        t->len = 1;
+        t->user_data = UD_TIMEOUT;
+    }
+}
+
+static void submit_send(struct uworker *w, struct uconn *c) {
+    if (sq_reserve(w, 1) < 0) {
+        uconn_close(w, c);
+        return;
+    }
+    struct io_uring_sqe *sqe = sq_next(w);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = c->s.fd;
+    sqe->addr = (uintptr_t)(c->s.out + c->out_off);
+    sqe->len = c->s.out_len - c->out_off;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uintptr_t)c | UD_SEND;
+}
+
+// The conn's previous operation is done: answer what can be answered, then
+// write, close or read.
+static void step(struct uworker *w, struct uconn *c, const struct raw_config *cfg) {
+    struct io_session *s = &c->s;
+    if (c->out_off == s->out_len) {
+        c->out_off = s->out_len = 0;
+        io_serve(s, cfg, w->stats, &w->scratch);
+    }
+    if (c->out_off < s->out_len) {
+        submit_send(w, c);
+    } else if (s->closing) {
+        if (s->eof) STAT_INC(w->stats, close_passive);
+        else STAT_INC(w->stats, close_active);
+        uconn_close(w, c);
+    } else {
+        submit_recv(w, c, cfg);
+    }
+}
+
+// ============================================================================
+// Completions
+// ============================================================================
+// On a full submission queue the listener is left in w->unarmed, and the
+// worker loop retries before its next io_uring_enter().
+static void arm_accept(struct uworker *w, int i) {
+    if (sq_reserve(w, 1) < 0) {
+        w->unarmed |= 1u << i;
+        return;
+    }
+    w->unarmed &= ~(1u << i);
+    struct io_uring_sqe *sqe = sq_next(w);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = w->fds[i];
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->ioprio = w->multishot ? IORING_ACCEPT_MULTISHOT : 0;
+    sqe->user_data = (uint64_t)i << 3 | UD_ACCEPT;
+}
+
+static void on_accept(struct uworker *w, const struct io_uring_cqe *cqe,
+                      const struct raw_config *cfg) {
+    int i = (int)(cqe->user_data >> 3);
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        // Single-shot, or the multishot accept ended: re-arm.
+        if (cqe->res == -EINVAL && w->multishot) w->multishot = 0;
+        arm_accept(w, i);
+    }
+    if (cqe->res < 0) {
+        if (cqe->res != -EINVAL) fprintf(stderr, "accept: %s\n", strerror(-cqe->res));
+        return;
+    }
+
+    struct uconn *c = uconn_alloc(w);
+    if (!c) {
+        STAT_INC(w->stats, sys_close);
+        close(cqe->res);
+        return;
+    }
+    c->s.fd = cqe->res;
+    STAT_INC(w->stats, accepted);
+    STAT_INC(w->stats, conns);
+    if (cfg->log_messages) {
+        struct sockaddr_in cli;
+        socklen_t clen = sizeof(cli);
+        char ip[INET_ADDRSTRLEN] = "";
+        STAT_INC(w->stats, sys_other);
+        if (getpeername(c->s.fd, (struct sockaddr *)&cli, &clen) == 0) {
+            inet_ntop(AF_INET, &cli.sin_addr, ip, sizeof(ip));
+        }
+        printf("👋  client connected from %s:%d\n", ip, ntohs(cli.sin_port));
+    }
+    io_socket_options(c->s.fd, cfg, w->stats);
+    submit_recv(w, c, cfg);
+}
+
+static void on_recv(struct uworker *w, struct uconn *c, int res, const struct raw_config *cfg) {
+    if (res < 0) {
+        if (res == -ECANCELED) {
+            if (cfg->log_messages) {
+                printf("⏱️  idle timeout, closing connection on fd %d\n", c->s.fd);
+            }
+        } else if (res != -ECONNRESET) {
+            fprintf(stderr, "recv: %s\n", strerror(-res));
+        }
+        uconn_close(w, c);
+        return;
+    }
+    if (res == 0) c->s.eof = 1;
+    c->s.in_len += (unsigned)res;
+    step(w, c, cfg);
+}
+
+static void on_send(struct uworker *w, struct uconn *c, int res, const struct raw_config *cfg) {
+    if (res < 0) {
+        if (res != -EPIPE && res != -ECONNRESET) fprintf(stderr, "send: %s\n", strerror(-res));
+        uconn_close(w, c);
+        return;
+    }
+    c->out_off += (unsigned)res;
+    step(w, c, cfg);
+}
+
+static void reap(struct uworker *w, const struct raw_config *cfg) {
+    struct ring *r = &w->ring;
+    unsigned head = atomic_load_explicit(r->cq_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(r->cq_tail, memory_order_acquire);
+    while (head != tail) {
+        struct io_uring_cqe cqe = r->cqes[head & r->cq_mask];
+        head++;
+        switch (UD_OP(cqe.user_data)) {
+        case UD_ACCEPT:
+            on_accept(w, &cqe, cfg);
+            break;
+        case UD_RECV:
+            on_recv(w, UD_CONN(cqe.user_data), cqe.res, cfg);
+            break;
+        case UD_SEND:
+            on_send(w, UD_CONN(cqe.user_data), cqe.res, cfg);
+            break;
+        default:
+            break;                          // timeouts and closes: nothing to do
+        }
+        if (head == tail) tail = atomic_load_explicit(r->cq_tail, memory_order_acquire);
+    }
+    atomic_store_explicit(r->cq_head, head, memory_order_release);
+}
+
+// ============================================================================
+// The loop
+// ----------------------------------------------------------------------------
+// While blocked in io_uring_enter() the worker is offline for config
+// reclamation, as an epoll worker is in epoll_wait().
+// ============================================================================
+static void *uworker_main(void *arg) {
+    struct uworker *w = arg;
+    char name[16];
+    snprintf(name, sizeof(name), "raw-uring-%d", w->id);
+    pthread_setname_np(pthread_self(), name);
+
+    // A single-issuer ring is created disabled, so that its issuer becomes
+    // this thread rather than the one that set it up.
+    if ((w->ring.flags & IORING_SETUP_R_DISABLED) &&
+        syscall(__NR_io_uring_register, w->ring.fd, IORING_REGISTER_ENABLE_RINGS, NULL, 0) < 0) {
+        perror("io_uring_register");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < w->nfds; i++) arm_accept(w, i);
+
+    for (;;) {
+        for (int i = 0; i < w->nfds; i++) {
+            if (w->unarmed & (1u << i)) arm_accept(w, i);
+        }
+        config_reader_offline(w->rcu);
+        int rc = ring_enter(w, 1);
+        config_reader_online(w->rcu);
+        if (rc < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+            perror("io_uring_enter");
+        }
+        reap(w, config_current());
+        config_reader_quiescent(w->rcu);
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Startup and introspection
+// ============================================================================
+static int uring_init(struct uworker *w, int id, const int *fds, int nfds) {
+    w->id = id;
+    w->stats = stats_worker(id);
+    w->nfds = nfds;
+    w->multishot = 1;
+    memcpy(w->fds, fds, sizeof(int) * (size_t)nfds);
+    if (arena_init(&w->scratch, ARENA_BYTES, w->stats) < 0) return -1;
+    unsigned fast = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN |
+                    IORING_SETUP_R_DISABLED;
+    if (ring_setup(&w->ring, fast) < 0 && (errno != EINVAL || ring_setup(&w->ring, 0) < 0)) {
+        return -1;
+    }
+    w->rcu = config_reader_register();
+    return 0;
+}
+
+static int uring_start(int n, int fds[][CONFIG_MAX_LISTEN], int nfds) {
+    nworkers = n;
+    nlisten = nfds;
+    stats_init(n);
+    for (int i = 0; i < n; i++) {
+        memcpy(listen_fds[i], fds[i], sizeof(fds[i]));
+        if (uring_init(&uworkers[i], i, fds[i], nfds) < 0) return -1;
+    }
+    int cpu_pin = config_current()->cpu_pin;
+    for (int i = 0; i < n; i++) {
+        struct uworker *w = &uworkers[i];
+        int rc = pthread_create(&w->thread, NULL, uworker_main, w);
+        if (rc != 0) {
+            errno = rc;
+            return -1;
+        }
+        if (cpu_pin >= 0) io_pin_worker(w->thread, i, cpu_pin + i);
+    }
+    printf("💍  io_backend = uring: %d ring%s of %d entries%s\n", n, n == 1 ? "" : "s",
+           URING_ENTRIES,
+           uworkers[0].ring.flags & IORING_SETUP_DEFER_TASKRUN ? ", deferred task work" : "");
+    return 0;
+}
+
+static void uring_join(void) {
+    for (int i = 0; i < nworkers; i++) pthread_join(uworkers[i].thread, NULL);
+}
+
+static void uring_apply_backlog(int backlog) {
+    io_listen_backlog(listen_fds, nworkers, nlisten, backlog);
+}
+
+static void uring_dump(FILE *out) {
+    for (int i = 0; i < nworkers; i++) {
+        struct uworker *w = &uworkers[i];
+        double cpu = 0.0;
+        clockid_t cid;
+        struct timespec ts;
+        if (pthread_getcpuclockid(w->thread, &cid) == 0 && clock_gettime(cid, &ts) == 0) {
+            cpu = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+        }
+        struct raw_stats_snapshot s;
+        stats_read(i, &s);
+        uint64_t sys = stats_syscalls(&s);
+        fprintf(out, "uring worker %d: conns=%llu accepted=%llu msgs=%llu cpu=%.3fs"
+                     " syscalls/msg=%.2f sqes/msg=%.2f\n",
+                i, (unsigned long long)s.conns, (unsigned long long)s.accepted,
+                (unsigned long long)s.msgs, cpu,
+                s.msgs ? (double)sys / (double)s.msgs : 0.0,
+                s.msgs ? (double)s.uring_sqes / (double)s.msgs : 0.0);
+    }
+}
+
+const struct io_backend io_backend_uring = {
+    .name = "uring",
+    .unsupported = io_core_unsupported,
+    .ignored = io_core_ignored,
+    .start = uring_start,
+    .join = uring_join,
+    .apply_backlog = uring_apply_backlog,
+    .dump = uring_dump,
+};
@@ -0,0 +1,330 @@
+// ============================================================================
+// Durable request journal: staging, group commit, segment files
+// ============================================================================
+#define _GNU_SOURCE
+#include "journal.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define JOURNAL_STAGE_BYTES (1u << 20)      // per staging buffer (two of them)
+#define JOURNAL_BLOCK 4096u                 // O_DIRECT alignment
+#define JOURNAL_HDR 8u                      // u32 length + u32 crc32
+
+static int enabled;
+static char dir[CONFIG_PATH_LEN];
+static uint64_t segment_bytes;
+static int use_direct;
+static void (*durable_cb)(void);
+static struct config_reader *rcu;
+
+// ----------------------------------------------------------------------------
+// Staging (workers append, the journal thread swaps) — guarded by stage_lock.
+// ----------------------------------------------------------------------------
+static pthread_mutex_t stage_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stage_cond = PTHREAD_COND_INITIALIZER;
+static char *stage_bufs[2];
+static int stage_idx;
+static size_t stage_len;
+static uint64_t stage_records;
+static uint64_t next_lsn;                   // LSN after the last staged record
+
+static _Atomic uint64_t durable_lsn;
+
+// ----------------------------------------------------------------------------
+// Writer state (journal thread only).
+// ----------------------------------------------------------------------------
+static int seg_fd = -1;
+static uint64_t seg_block_off;              // file offset of wbuf[0]
+static size_t tail_len;                     // bytes of the last, partial block
+static char *wbuf;                          // aligned: tail + batch + padding
+
+// Counters (written by the journal thread or under stage_lock; read by admin).
+static _Atomic uint64_t st_records, st_bytes, st_commits, st_full;
+static _Atomic uint64_t st_sync_ns, st_sync_max_ns, st_batch_max, st_segments;
+
+// ============================================================================
+// CRC-32 (IEEE 802.3, reflected) — catches torn writes at the tail on replay.
+// ============================================================================
+static uint32_t crc_table[256];
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32_buf(const char *p, size_t len) {
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) c = crc_table[(c ^ (uint8_t)p[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+// ============================================================================
+// Segments
+// ============================================================================
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void segment_path(char *out, size_t outlen, uint64_t first_lsn) {
+    snprintf(out, outlen, "%s/journal-%016" PRIx64 ".log", dir, first_lsn);
+}
+
+static int segment_open(uint64_t first_lsn) {
+    char path[CONFIG_PATH_LEN + 64];
+    segment_path(path, sizeof(path), first_lsn);
+    int flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+    int fd = open(path, flags | (use_direct ? O_DIRECT : 0), 0644);
+    if (fd < 0 && use_direct && errno == EINVAL) {
+        fprintf(stderr, "⚠️  journal: %s does not support O_DIRECT; using buffered writes\n",
+                dir);
+        use_direct = 0;
+        fd = open(path, flags, 0644);
+    }
+    if (fd < 0) {
+        fprintf(stderr, "❌ journal: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    // Preallocate so appends never wait on block allocation; zeros past the
+    // last record double as the end marker.
+    if (fallocate(fd, 0, 0, (off_t)segment_bytes) < 0 && errno != EOPNOTSUPP) {
+        fprintf(stderr, "⚠️  journal: fallocate %s: %s\n", path, strerror(errno));
+    }
+    // Make the new directory entry itself durable.
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    if (seg_fd >= 0) close(seg_fd);
+    seg_fd = fd;
+    seg_block_off = 0;
+    tail_len = 0;
+    atomic_fetch_add(&st_segments, 1);
+    return 0;
+}
+
+// Finds where the previous run stopped: the newest segment's first LSN plus
+// the length of its valid record prefix. New writes start a fresh segment
+// there, so LSNs (and segment names) keep increasing across restarts.
+static uint64_t recover_end(void) {
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+    uint64_t newest = 0;
+    int found = 0;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        uint64_t lsn;
+        if (sscanf(e->d_name, "journal-%16" SCNx64 ".log", &lsn) == 1) {
+            if (!found || lsn > newest) newest = lsn;
+            found = 1;
+        }
+    }
+    closedir(d);
+    if (!found) return 0;
+
+    char path[CONFIG_PATH_LEN + 64];
+    segment_path(path, sizeof(path), newest);
+    FILE *f = fopen(path, "rb");
+    if (!f) return newest;
+    uint64_t valid = 0;
+    char *payload = malloc(MSG_LEN_CAP);
+    uint32_t hdr[2];
+    while (payload && fread(hdr, sizeof(hdr), 1, f) == 1) {
+        if (hdr[0] == 0 || hdr[0] > MSG_LEN_CAP) break;
+        if (fread(payload, hdr[0], 1, f) != 1) break;
+        if (crc32_buf(payload, hdr[0]) != hdr[1]) break;
+        valid += JOURNAL_HDR + hdr[0];
+    }
+    free(payload);
+    fclose(f);
+    // A segment with no records (a run that never committed) would collide
+    // with the one about to be created under the same name.
+    if (valid == 0) unlink(path);
+    return newest + valid;
+}
+
+// ============================================================================
+// Commit: one pwrite of tail + batch (block-aligned), then one fdatasync
+// ============================================================================
+static int write_batch(const char *batch, size_t len) {
+    memcpy(wbuf + tail_len, batch, len);
+    size_t total = tail_len + len;
+    size_t padded = (total + JOURNAL_BLOCK - 1) & ~(size_t)(JOURNAL_BLOCK - 1);
+    memset(wbuf + total, 0, padded - total);
+
+    size_t done = 0;
+    while (done < padded) {
+        ssize_t n = pwrite(seg_fd, wbuf + done, padded - done, (off_t)(seg_block_off + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("journal: pwrite");
+            return -1;
+        }
+        done += (size_t)n;
+    }
+
+    size_t full = total & ~(size_t)(JOURNAL_BLOCK - 1);
+    seg_block_off += full;
+    tail_len = total - full;
+    memmove(wbuf, wbuf + full, tail_len);
+    return 0;
+}
+
+static void *journal_main(void *arg) {
+    (void)arg;
+    pthread_setname_np(pthread_self(), "raw-journal");
+    for (;;) {
+        pthread_mutex_lock(&stage_lock);
+        while (stage_len == 0) pthread_cond_wait(&stage_cond, &stage_lock);
+        pthread_mutex_unlock(&stage_lock);
+
+        config_reader_online(rcu);
+        int commit_us = config_current()->journal_commit_us;
+        config_reader_offline(rcu);
+        if (commit_us > 0) {
+            struct timespec wait = {0, (long)commit_us * 1000};
+            nanosleep(&wait, NULL);
+        }
+
+        pthread_mutex_lock(&stage_lock);
+        char *batch = stage_bufs[stage_idx];
+        size_t len = stage_len;
+        uint64_t end_lsn = next_lsn;
+        uint64_t records = stage_records;
+        stage_idx ^= 1;
+        stage_len = 0;
+        stage_records = 0;
+        pthread_mutex_unlock(&stage_lock);
+
+        uint64_t start_lsn = end_lsn - len;
+        if (seg_block_off + tail_len >= segment_bytes && segment_open(start_lsn) < 0) abort();
+        if (write_batch(batch, len) < 0) abort();
+
+        uint64_t t0 = now_ns();
+        if (fdatasync(seg_fd) < 0) {
+            // The kernel may have dropped the dirty pages; nothing written
+            // since the last good sync can be trusted any more.
+            perror("journal: fdatasync");
+            abort();
+        }
+        uint64_t dt = now_ns() - t0;
+
+        atomic_store_explicit(&durable_lsn, end_lsn, memory_order_release);
+        atomic_fetch_add(&st_commits, 1);
+        atomic_fetch_add(&st_sync_ns, dt);
+        if (dt > atomic_load(&st_sync_max_ns)) atomic_store(&st_sync_max_ns, dt);
+        if (records > atomic_load(&st_batch_max)) atomic_store(&st_batch_max, records);
+        if (durable_cb) durable_cb();
+    }
+    return NULL;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+int journal_start(const struct raw_config *cfg, void (*on_durable)(void)) {
+    if (cfg->journal_dir[0] == '\0') return 0;
+    snprintf(dir, sizeof(dir), "%s", cfg->journal_dir);
+    segment_bytes = (uint64_t)cfg->journal_segment_mb << 20;
+    use_direct = cfg->journal_direct;
+    durable_cb = on_durable;
+    crc_init();
+
+    stage_bufs[0] = malloc(JOURNAL_STAGE_BYTES);
+    stage_bufs[1] = malloc(JOURNAL_STAGE_BYTES);
+    wbuf = aligned_alloc(JOURNAL_BLOCK, JOURNAL_STAGE_BYTES + 2 * JOURNAL_BLOCK);
+    if (!stage_bufs[0] || !stage_bufs[1] || !wbuf) {
+        perror("journal");
+        return -1;
+    }
+
+    next_lsn = recover_end();
+    atomic_store(&durable_lsn, next_lsn);
+    if (segment_open(next_lsn) < 0) return -1;
+
+    rcu = config_reader_register();
+    config_reader_offline(rcu);
+    pthread_t tid;
+    int rc = pthread_create(&tid, NULL, journal_main, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "❌ journal: pthread_create: %s\n", strerror(rc));
+        return -1;
+    }
+    pthread_detach(tid);
+    enabled = 1;
+    printf("📒 journal: %s, %d MiB segments, %s, resuming at LSN %" PRIu64 "\n", dir,
+           cfg->journal_segment_mb, use_direct ? "O_DIRECT" : "buffered", next_lsn);
+    return 0;
+}
+
+int journal_enabled(void) {
+    return enabled;
+}
+
+uint64_t journal_append(const char *data, size_t len) {
+    uint32_t hdr[2] = {(uint32_t)len, crc32_buf(data, len)};
+    size_t need = JOURNAL_HDR + len;
+
+    pthread_mutex_lock(&stage_lock);
+    if (stage_len + need > JOURNAL_STAGE_BYTES) {
+        pthread_mutex_unlock(&stage_lock);
+        atomic_fetch_add_explicit(&st_full, 1, memory_order_relaxed);
+        return 0;
+    }
+    char *p = stage_bufs[stage_idx] + stage_len;
+    memcpy(p, hdr, JOURNAL_HDR);
+    memcpy(p + JOURNAL_HDR, data, len);
+    int was_empty = stage_len == 0;
+    stage_len += need;
+    stage_records++;
+    next_lsn += need;
+    uint64_t lsn = next_lsn;
+    pthread_mutex_unlock(&stage_lock);
+
+    // Only the first record of a batch can find the writer asleep.
+    if (was_empty) pthread_cond_signal(&stage_cond);
+    atomic_fetch_add_explicit(&st_records, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&st_bytes, need, memory_order_relaxed);
+    return lsn;
+}
+
+uint64_t journal_durable(void) {
+    return atomic_load_explicit(&durable_lsn, memory_order_acquire);
+}
+
+void journal_dump(FILE *out) {
+    if (!enabled) {
+        fprintf(out, "journal off\n");
+        return;
+    }
+    uint64_t commits = atomic_load(&st_commits);
+    uint64_t records = atomic_load(&st_records);
+    fprintf(out, "journal_dir %s\n", dir);
+    fprintf(out, "journal_direct %d\n", use_direct);
+    fprintf(out, "journal_records %" PRIu64 "\n", records);
+    fprintf(out, "journal_bytes %" PRIu64 "\n", atomic_load(&st_bytes));
+    fprintf(out, "journal_commits %" PRIu64 "\n", commits);
+    fprintf(out, "journal_segments %" PRIu64 "\n", atomic_load(&st_segments));
+    fprintf(out, "journal_stage_full %" PRIu64 "\n", atomic_load(&st_full));
+    fprintf(out, "journal_durable_lsn %" PRIu64 "\n", journal_durable());
+    fprintf(out, "journal_records_per_commit %.1f\n",
+            commits ? (double)records / (double)commits : 0.0);
+    fprintf(out, "journal_batch_max %" PRIu64 "\n", atomic_load(&st_batch_max));
+    fprintf(out, "journal_sync_avg_us %.1f\n",
+            commits ? (double)atomic_load(&st_sync_ns) / (double)commits / 1000.0 : 0.0);
+    fprintf(out, "journal_sync_max_us %.1f\n", (double)atomic_load(&st_sync_max_ns) / 1000.0);
+}
@@ -0,0 +1,62 @@
+#ifndef RAW_JOURNAL_H
+#define RAW_JOURNAL_H
+
+// ============================================================================
+// Durable request journal
+// ----------------------------------------------------------------------------
+// With journal_dir set, every echoed message is appended to an on-disk log
+// and its reply is held back until the log is durable up to that message.
+// Durability costs one fdatasync(), which takes 0.1–10 ms depending on the
+// device; paying it per message would cap the server at a few hundred echoes
+// per second. Instead the journal does *group commit*:
+//
+//   workers ──journal_append()──► staging buffer (mutex, memcpy only)
+//                                      │ swap when the writer is free
+//                                      ▼
+//   raw-journal thread: pwrite(batch) ─► fdatasync ─► durable LSN ─► wake workers
+//
+// Every message that arrives while one fdatasync is in flight rides on the
+// next one, so the sync rate stays bounded by the device while throughput
+// grows with load. journal_commit_us adds an optional wait to grow batches
+// further at low load (trading latency for fewer syncs).
+//
+// Positions are LSNs: the byte offset just past a record in the logical
+// journal stream (monotonic across segment files). A worker gets the LSN of
+// each append and releases the reply once journal_durable() reaches it.
+//
+// On disk (journal_dir/journal-<first LSN, 16 hex digits>.log):
+//   - Segments are preallocated with fallocate() to journal_segment_mb, so
+//     appends do not allocate blocks, and a new segment is started once a
+//     batch crosses that size.
+//   - Records are { u32 length, u32 crc32(payload), payload }, back to back.
+//     A zero length (the preallocated tail) marks the end of valid data.
+//   - With journal_direct, writes use O_DIRECT from 4 KiB-aligned buffers,
+//     bypassing the page cache (the journal is never read on the hot path);
+//     the partially filled last block is kept in memory and rewritten with
+//     the next batch. Falls back to buffered I/O if the filesystem refuses
+//     O_DIRECT (tmpfs, some overlays).
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "config.h"
+
+// Opens the first segment and starts the journal thread when
+// cfg->journal_dir is set. 'on_durable' runs on the journal thread after each
+// commit, to wake workers holding replies. Returns 0 (also when disabled), or
+// -1 with a message printed.
+int journal_start(const struct raw_config *cfg, void (*on_durable)(void));
+
+int journal_enabled(void);
+
+// Stages one record. Returns its LSN, or 0 if the staging buffer is full (the
+// caller retries after the next commit).
+uint64_t journal_append(const char *data, size_t len);
+
+// Highest LSN known to be on stable storage (acquire load).
+uint64_t journal_durable(void);
+
+// "name value" lines for the admin JOURNAL command.
+void journal_dump(FILE *out);
+
+#endif
@@ -0,0 +1,428 @@
+// ============================================================================
+// In-memory key-value store: sharded Robin Hood tables with CLOCK eviction
+// ============================================================================
+#define _GNU_SOURCE
+#include "kv.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KV_EMPTY UINT32_MAX
+#define KV_MIN_SLOTS 64u
+#define KV_ITEM_OVERHEAD 16         // slot + items[] pointer, charged per item
+
+struct kv_slot {
+    uint32_t hash;                  // low 32 bits of the key hash
+    uint32_t idx;                   // index into items[], KV_EMPTY if free
+};
+
+struct kv_item {
+    uint32_t hash;
+    uint16_t klen, vlen;
+    uint8_t ref;                    // CLOCK reference bit
+    char data[];                    // key, then value
+};
+
+struct kv_shard {
+    _Alignas(64) pthread_mutex_t lock;
+    struct kv_slot *slots;
+    uint32_t mask;                  // slots - 1
+    struct kv_item **items;         // dense; CLOCK sweeps it
+    uint32_t nitems, items_cap;
+    uint32_t hand;
+    size_t bytes, budget;
+    uint64_t evictions;
+};
+
+static struct kv_shard *shards;
+static unsigned nshards;
+static int enabled;
+
+// FNV-1a, 64-bit: keys are short, and the high half picks the shard while
+// the low half picks the slot, so the two choices are independent.
+uint64_t kv_hash(const char *p, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)p[i]) * 0x100000001b3ull;
+    return h;
+}
+
+static struct kv_shard *shard_of(uint64_t h) {
+    return &shards[(h >> 32) & (nshards - 1)];
+}
+
+static size_t item_cost(const struct kv_item *it) {
+    return sizeof(*it) + it->klen + it->vlen + KV_ITEM_OVERHEAD;
+}
+
+// ============================================================================
+// Robin Hood table (caller holds the shard lock)
+// ----------------------------------------------------------------------------
+// An entry's probe distance is how far it sits from its home slot. Inserts
+// take the slot of any entry that is closer to home than the newcomer is
+// ("rob the rich"), so distances stay even and a lookup can stop as soon as
+// it meets an entry closer to home than the key it seeks would be.
+// ============================================================================
+static uint32_t probe_dist(const struct kv_shard *sh, uint32_t pos, uint32_t hash) {
+    return (pos - (hash & sh->mask)) & sh->mask;
+}
+
+static int64_t find(const struct kv_shard *sh, uint32_t hash, const char *key, size_t klen) {
+    uint32_t pos = hash & sh->mask;
+    for (uint32_t dist = 0;; dist++, pos = (pos + 1) & sh->mask) {
+        const struct kv_slot *s = &sh->slots[pos];
+        if (s->idx == KV_EMPTY || probe_dist(sh, pos, s->hash) < dist) return -1;
+        if (s->hash == hash) {
+            const struct kv_item *it = sh->items[s->idx];
+            if (it->klen == klen && memcmp(it->data, key, klen) == 0) return pos;
+        }
+    }
+}
+
+// Slot holding items[idx]; the item is known to be in the table.
+static uint32_t find_idx(const struct kv_shard *sh, uint32_t idx) {
+    uint32_t pos = sh->items[idx]->hash & sh->mask;
+    while (sh->slots[pos].idx != idx) pos = (pos + 1) & sh->mask;
+    return pos;
+}
+
+static void slot_insert(struct kv_shard *sh, struct kv_slot cur) {
+    uint32_t pos = cur.hash & sh->mask;
+    for (uint32_t dist = 0;; dist++, pos = (pos + 1) & sh->mask) {
+        struct kv_slot *s = &sh->slots[pos];
+        if (s->idx == KV_EMPTY) {
+            *s = cur;
+            return;
+        }
+        uint32_t d = probe_dist(sh, pos, s->hash);
+        if (d < dist) {
+            struct kv_slot tmp = *s;
+            *s = cur;
+            cur = tmp;
+            dist = d;
+        }
+    }
+}
+
+// Backward-shift delete: pull the rest of the run one slot closer to home, so
+// no tombstones accumulate and probe lengths do not degrade over time.
+static void slot_delete(struct kv_shard *sh, uint32_t pos) {
+    uint32_t next = (pos + 1) & sh->mask;
+    while (sh->slots[next].idx != KV_EMPTY &&
+           probe_dist(sh, next, sh->slots[next].hash) > 0) {
+        sh->slots[pos] = sh->slots[next];
+        pos = next;
+        next = (next + 1) & sh->mask;
+    }
+    sh->slots[pos].idx = KV_EMPTY;
+}
+
+static int grow(struct kv_shard *sh) {
+    uint32_t nslots = (sh->mask + 1) * 2;
+    struct kv_slot *slots = malloc(sizeof(*slots) * nslots);
+    struct kv_item **items = realloc(sh->items, sizeof(*items) * nslots);
+    if (!slots || !items) {
+        free(slots);
+        if (items) sh->items = items;
+        return -1;
+    }
+    for (uint32_t i = 0; i < nslots; i++) slots[i].idx = KV_EMPTY;
+    free(sh->slots);
+    sh->slots = slots;
+    sh->mask = nslots - 1;
+    sh->items = items;
+    sh->items_cap = nslots;
+    for (uint32_t i = 0; i < sh->nitems; i++) {
+        slot_insert(sh, (struct kv_slot){sh->items[i]->hash, i});
+    }
+    return 0;
+}
+
+// Removes the item in slot 'pos'. The last item moves into its index so
+// items[] stays dense for the CLOCK hand.
+static void remove_at(struct kv_shard *sh, uint32_t pos) {
+    uint32_t idx = sh->slots[pos].idx;
+    slot_delete(sh, pos);
+    sh->bytes -= item_cost(sh->items[idx]);
+    free(sh->items[idx]);
+    uint32_t last = --sh->nitems;
+    if (idx != last) {
+        sh->slots[find_idx(sh, last)].idx = idx;
+        sh->items[idx] = sh->items[last];
+    }
+}
+
+// CLOCK: referenced items get a second chance (bit cleared, hand moves on);
+// the first unreferenced one is evicted. Removal moves the last item under
+// the hand, so the hand stays put after an eviction.
+static void evict_for(struct kv_shard *sh, size_t need, struct raw_stats *st) {
+    while (sh->nitems && sh->bytes + need > sh->budget) {
+        if (sh->hand >= sh->nitems) sh->hand = 0;
+        struct kv_item *it = sh->items[sh->hand];
+        if (it->ref) {
+            it->ref = 0;
+            sh->hand++;
+            continue;
+        }
+        remove_at(sh, find_idx(sh, sh->hand));
+        sh->evictions++;
+        if (st) STAT_INC(st, kv_evictions);
+    }
+}
+
+// ============================================================================
+// Commands
+// ============================================================================
+static const char *const msg_stored = "STORED\n";
+static const char *const msg_deleted = "DELETED\n";
+static const char *const msg_not_found = "NOT_FOUND\n";
+static const char *const msg_usage = "ERR usage\n";
+static const char *const msg_nomem = "ERR no memory\n";
+
+static size_t put(char *reply, const char *msg) {
+    size_t n = strlen(msg);
+    memcpy(reply, msg, n);
+    return n;
+}
+
+static size_t cmd_get(struct kv_shard *sh, uint32_t hash, const char *key, size_t klen,
+                      char *reply, struct raw_stats *st) {
+    STAT_INC(st, kv_gets);
+    pthread_mutex_lock(&sh->lock);
+    int64_t pos = find(sh, hash, key, klen);
+    if (pos < 0) {
+        pthread_mutex_unlock(&sh->lock);
+        return put(reply, msg_not_found);
+    }
+    struct kv_item *it = sh->items[sh->slots[pos].idx];
+    if (!it->ref) it->ref = 1;      // avoid dirtying the line on repeat hits
+    memcpy(reply, "VALUE ", 6);
+    memcpy(reply + 6, it->data + it->klen, it->vlen);
+    size_t n = 6 + it->vlen;
+    pthread_mutex_unlock(&sh->lock);
+    reply[n++] = '\n';
+    STAT_INC(st, kv_hits);
+    return n;
+}
+
+// Inserts or replaces key. Returns 0, or -1 if it cannot be stored. 'st' may
+// be NULL (snapshot load: nothing to count against).
+static int store(struct kv_shard *sh, uint32_t hash, const char *key, size_t klen,
+                 const char *val, size_t vlen, struct raw_stats *st) {
+    struct kv_item *it = malloc(sizeof(*it) + klen + vlen);
+    if (!it) return -1;
+    it->hash = hash;
+    it->klen = (uint16_t)klen;
+    it->vlen = (uint16_t)vlen;
+    it->ref = 1;
+    memcpy(it->data, key, klen);
+    memcpy(it->data + klen, val, vlen);
+
+    size_t cost = item_cost(it);
+    pthread_mutex_lock(&sh->lock);
+    // Every way to fail comes before the old value is touched: a SET that
+    // answers ERR leaves the key as it was. Keep the load factor at or below
+    // 7/8 (a replacement does not add an item).
+    int64_t pos = find(sh, hash, key, klen);
+    if (cost > sh->budget ||
+        (pos < 0 && (uint64_t)(sh->nitems + 1) * 8 > (uint64_t)(sh->mask + 1) * 7 &&
+         grow(sh) < 0)) {
+        pthread_mutex_unlock(&sh->lock);
+        free(it);
+        return -1;
+    }
+    if (pos >= 0) remove_at(sh, (uint32_t)pos);
+    evict_for(sh, cost, st);
+    uint32_t idx = sh->nitems++;
+    sh->items[idx] = it;
+    sh->bytes += cost;
+    slot_insert(sh, (struct kv_slot){hash, idx});
+    pthread_mutex_unlock(&sh->lock);
+    return 0;
+}
+
+static size_t cmd_set(struct kv_shard *sh, uint32_t hash, const char *key, size_t klen,
+                      const char *val, size_t vlen, char *reply, struct raw_stats *st) {
+    STAT_INC(st, kv_sets);
+    return put(reply, store(sh, hash, key, klen, val, vlen, st) < 0 ? msg_nomem : msg_stored);
+}
+
+static size_t cmd_del(struct kv_shard *sh, uint32_t hash, const char *key, size_t klen,
+                      char *reply, struct raw_stats *st) {
+    STAT_INC(st, kv_dels);
+    pthread_mutex_lock(&sh->lock);
+    int64_t pos = find(sh, hash, key, klen);
+    if (pos >= 0) remove_at(sh, (uint32_t)pos);
+    pthread_mutex_unlock(&sh->lock);
+    return put(reply, pos >= 0 ? msg_deleted : msg_not_found);
+}
+
+enum verb { VERB_NONE, VERB_GET, VERB_SET, VERB_DEL, VERB_BAD };
+
+// Splits a request line. Returns VERB_NONE for lines that are not KV
+// commands (echoed), VERB_BAD for malformed ones; otherwise fills in the key
+// and, for SET, the value.
+static enum verb parse(const char *line, size_t len, const char **key, size_t *klen,
+                       const char **val, size_t *vlen) {
+    if (len < 3 || (len > 3 && line[3] != ' ')) return VERB_NONE;
+    enum verb verb;
+    if (memcmp(line, "GET", 3) == 0) {
+        verb = VERB_GET;
+    } else if (memcmp(line, "SET", 3) == 0) {
+        verb = VERB_SET;
+    } else if (memcmp(line, "DEL", 3) == 0) {
+        verb = VERB_DEL;
+    } else {
+        return VERB_NONE;
+    }
+
+    // Key: up to the next space (SET) or the end of the line (GET, DEL).
+    if (len <= 4) return VERB_BAD;
+    const char *end = line + len;
+    *key = line + 4;
+    const char *sp = memchr(*key, ' ', (size_t)(end - *key));
+    *klen = (size_t)((sp ? sp : end) - *key);
+    if (*klen == 0 || *klen > KV_KEY_MAX || (verb == VERB_SET) != (sp != NULL)) {
+        return VERB_BAD;
+    }
+    if (sp) {
+        *val = sp + 1;
+        *vlen = (size_t)(end - sp - 1);
+    }
+    return verb;
+}
+
+size_t kv_execute(const char *line, size_t len, char *reply, struct raw_stats *st) {
+    const char *key = NULL, *val = NULL;
+    size_t klen = 0, vlen = 0;
+    enum verb verb = parse(line, len, &key, &klen, &val, &vlen);
+    if (verb == VERB_NONE) return 0;
+    if (verb == VERB_BAD) return put(reply, msg_usage);
+
+    uint64_t h = kv_hash(key, klen);
+    struct kv_shard *sh = shard_of(h);
+    switch (verb) {
+    case VERB_GET:
+        return cmd_get(sh, (uint32_t)h, key, klen, reply, st);
+    case VERB_SET:
+        return cmd_set(sh, (uint32_t)h, key, klen, val, vlen, reply, st);
+    case VERB_DEL:
+        return cmd_del(sh, (uint32_t)h, key, klen, reply, st);
+    default:
+        return 0;
+    }
+}
+
+int kv_command_hash(const char *line, size_t len, uint64_t *hash) {
+    const char *key = NULL, *val = NULL;
+    size_t klen = 0, vlen = 0;
+    enum verb verb = parse(line, len, &key, &klen, &val, &vlen);
+    if (verb == VERB_NONE || verb == VERB_BAD) return 0;
+    *hash = kv_hash(key, klen);
+    return 1;
+}
+
+// ============================================================================
+// Startup and introspection
+// ============================================================================
+int kv_start(const struct raw_config *cfg) {
+    if (cfg->kv_max_mb == 0) return 0;
+    nshards = 1;
+    while (nshards < 4u * (unsigned)cfg->workers && nshards < KV_MAX_SHARDS) nshards *= 2;
+    shards = aligned_alloc(64, sizeof(*shards) * nshards);
+    if (!shards) {
+        perror("kv");
+        return -1;
+    }
+    size_t budget = ((size_t)cfg->kv_max_mb << 20) / nshards;
+    for (unsigned i = 0; i < nshards; i++) {
+        struct kv_shard *sh = &shards[i];
+        memset(sh, 0, sizeof(*sh));
+        pthread_mutex_init(&sh->lock, NULL);
+        sh->budget = budget;
+        sh->mask = KV_MIN_SLOTS - 1;
+        sh->items_cap = KV_MIN_SLOTS;
+        sh->slots = malloc(sizeof(*sh->slots) * KV_MIN_SLOTS);
+        sh->items = malloc(sizeof(*sh->items) * KV_MIN_SLOTS);
+        if (!sh->slots || !sh->items) {
+            perror("kv");
+            return -1;
+        }
+        for (uint32_t j = 0; j < KV_MIN_SLOTS; j++) sh->slots[j].idx = KV_EMPTY;
+    }
+    enabled = 1;
+    printf("🗄️  kv: %d MiB over %u shards (SET/GET/DEL)\n", cfg->kv_max_mb, nshards);
+    return 0;
+}
+
+int kv_enabled(void) {
+    return enabled;
+}
+
+// ============================================================================
+// Snapshot support
+// ============================================================================
+void kv_freeze(void) {
+    for (unsigned i = 0; i < nshards; i++) pthread_mutex_lock(&shards[i].lock);
+}
+
+void kv_thaw(void) {
+    for (unsigned i = nshards; i-- > 0;) pthread_mutex_unlock(&shards[i].lock);
+}
+
+uint64_t kv_count(void) {
+    uint64_t n = 0;
+    for (unsigned i = 0; i < nshards; i++) n += shards[i].nitems;
+    return n;
+}
+
+int kv_visit(kv_visit_fn fn, void *arg) {
+    for (unsigned i = 0; i < nshards; i++) {
+        const struct kv_shard *sh = &shards[i];
+        for (uint32_t j = 0; j < sh->nitems; j++) {
+            const struct kv_item *it = sh->items[j];
+            int rc = fn(arg, it->data, it->klen, it->data + it->klen, it->vlen);
+            if (rc) return rc;
+        }
+    }
+    return 0;
+}
+
+int kv_restore(const char *key, size_t klen, const char *val, size_t vlen) {
+    if (klen == 0 || klen > KV_KEY_MAX || vlen > MSG_LEN_CAP) return -1;
+    uint64_t h = kv_hash(key, klen);
+    return store(shard_of(h), (uint32_t)h, key, klen, val, vlen, NULL);
+}
+
+void kv_dump(FILE *out) {
+    if (!enabled) {
+        fprintf(out, "kv disabled (set kv_max_mb)\n");
+        return;
+    }
+    uint64_t items = 0, bytes = 0, slots = 0, evictions = 0, dist_sum = 0, dist_max = 0;
+    for (unsigned i = 0; i < nshards; i++) {
+        struct kv_shard *sh = &shards[i];
+        pthread_mutex_lock(&sh->lock);
+        items += sh->nitems;
+        bytes += sh->bytes;
+        slots += sh->mask + 1;
+        evictions += sh->evictions;
+        for (uint32_t p = 0; p <= sh->mask; p++) {
+            if (sh->slots[p].idx == KV_EMPTY) continue;
+            uint64_t d = probe_dist(sh, p, sh->slots[p].hash);
+            dist_sum += d;
+            if (d > dist_max) dist_max = d;
+        }
+        pthread_mutex_unlock(&sh->lock);
+    }
+    fprintf(out, "kv_shards %u\n", nshards);
+    fprintf(out, "kv_items %llu\n", (unsigned long long)items);
+    fprintf(out, "kv_bytes %llu\n", (unsigned long long)bytes);
+    fprintf(out, "kv_budget_bytes %llu\n", (unsigned long long)shards[0].budget * nshards);
+    fprintf(out, "kv_slots %llu\n", (unsigned long long)slots);
+    fprintf(out, "kv_load %.3f\n", slots ? (double)items / (double)slots : 0.0);
+    fprintf(out, "kv_probe_avg %.2f\n", items ? (double)dist_sum / (double)items : 0.0);
+    fprintf(out, "kv_probe_max %llu\n", (unsigned long long)dist_max);
+    fprintf(out, "kv_evictions %llu\n", (unsigned long long)evictions);
+}
@@ -0,0 +1,82 @@
+#ifndef RAW_KV_H
+#define RAW_KV_H
+
+// ============================================================================
+// In-memory key-value store
+// ----------------------------------------------------------------------------
+// With kv_max_mb > 0, three verbs on the normal line protocol turn raw_server
+// into a small cache; every other line is still echoed:
+//
+//     SET <key> <value>    ──►  STORED        (value: rest of the line)
+//     GET <key>            ──►  VALUE <value> | NOT_FOUND
+//     DEL <key>            ──►  DELETED       | NOT_FOUND
+//
+// Keys are 1..KV_KEY_MAX bytes without spaces. Commands are ordinary
+// requests, so max_msg_len bounds them: raise it to store useful values.
+//
+// Layout:
+//   - The key space is hashed over a power-of-two number of shards (4 per
+//     worker, at most KV_MAX_SHARDS), each with its own lock on its own cache
+//     line, so two workers rarely touch the same shard at the same time.
+//   - Each shard is a Robin Hood open-addressing table of 8-byte slots
+//     {32-bit hash, item index}: eight slots per cache line, and a probe only
+//     dereferences an item when the stored hash matches. Robin Hood ordering
+//     keeps probe lengths short and lets a miss stop early; deletes shift the
+//     run back instead of leaving tombstones.
+//   - Memory is bounded: kv_max_mb is split evenly over the shards, and a SET
+//     that would exceed its shard's share evicts with CLOCK (a reference bit
+//     set on GET, cleared by a hand sweeping the shard's item array) — LRU's
+//     behaviour without touching a list on every hit.
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "config.h"
+#include "stats.h"
+
+#define KV_KEY_MAX 250
+#define KV_MAX_SHARDS 64
+
+// Sizes and allocates the shards when cfg->kv_max_mb is set. Returns 0 (also
+// when disabled), or -1 with a message printed.
+int kv_start(const struct raw_config *cfg);
+
+int kv_enabled(void);
+
+// Runs 'line' if it is a KV command, writing the reply (newline included) to
+// 'reply', which must have room for MSG_LEN_CAP + 16 bytes (a stored value can
+// be longer than the GET that fetches it), and counting it in 'st'.
+// Returns the reply length, or 0 if the line is not a KV command.
+size_t kv_execute(const char *line, size_t len, char *reply, struct raw_stats *st);
+
+// The key hash (64-bit FNV-1a). The cluster router relies on it being the
+// same on every instance.
+uint64_t kv_hash(const char *p, size_t len);
+
+// If 'line' is a well-formed KV command, stores kv_hash() of its key and
+// returns 1; otherwise returns 0.
+int kv_command_hash(const char *line, size_t len, uint64_t *hash);
+
+// ----------------------------------------------------------------------------
+// Snapshot support (snapshot.c)
+// ----------------------------------------------------------------------------
+// kv_freeze() takes every shard lock, so the store cannot change until
+// kv_thaw(). kv_count() and kv_visit() only read: call them frozen, or from a
+// forked child, which has the store to itself. kv_visit() stops at the first
+// nonzero return of 'fn' and returns it.
+typedef int (*kv_visit_fn)(void *arg, const char *key, size_t klen,
+                           const char *val, size_t vlen);
+
+void kv_freeze(void);
+void kv_thaw(void);
+uint64_t kv_count(void);
+int kv_visit(kv_visit_fn fn, void *arg);
+
+// Inserts one item (startup load; not counted in STATS). Returns 0, or -1 if
+// the item is malformed or does not fit.
+int kv_restore(const char *key, size_t klen, const char *val, size_t vlen);
+
+// "name value" lines for the admin KV command.
+void kv_dump(FILE *out);
+
+#endif
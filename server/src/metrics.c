@@ -0,0 +1,136 @@
+// ============================================================================
+// Shared-memory metrics page: layout setup and the publisher thread
+// ============================================================================
+#define _GNU_SOURCE
+#include "metrics.h"
+#include "config.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define X(name, desc) +1
+enum {
+    NCOUNTERS = 0 RAW_STATS_COUNTERS(X) RAW_STATS_GAUGES(X),
+    NHISTS = 0 RAW_STATS_HISTOGRAMS(X),
+};
+#undef X
+
+static struct metrics_header *page;
+static _Atomic uint64_t *values;    // counters, then histogram buckets
+static struct config_reader *rcu;
+
+static uint64_t realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void publish(void) {
+    struct raw_stats_snapshot s;
+    stats_read(-1, &s);
+
+    uint64_t seq = atomic_load_explicit(&page->seq, memory_order_relaxed);
+    atomic_store_explicit(&page->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    _Atomic uint64_t *v = values;
+#define X(name, desc) atomic_store_explicit(v++, s.name, memory_order_relaxed);
+    RAW_STATS_COUNTERS(X)
+    RAW_STATS_GAUGES(X)
+#undef X
+#define X(name, desc)                                                          \
+    for (int b = 0; b < RAW_STATS_HIST_BUCKETS; b++)                           \
+        atomic_store_explicit(v++, s.name[b], memory_order_relaxed);
+    RAW_STATS_HISTOGRAMS(X)
+#undef X
+    atomic_store_explicit(&page->updated_ns, realtime_ns(), memory_order_relaxed);
+    atomic_store_explicit(&page->publishes,
+                          atomic_load_explicit(&page->publishes, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+
+    atomic_store_explicit(&page->seq, seq + 2, memory_order_release);
+}
+
+static void *metrics_main(void *arg) {
+    (void)arg;
+    pthread_setname_np(pthread_self(), "raw-metrics");
+    for (;;) {
+        config_reader_online(rcu);
+        int interval = config_current()->metrics_interval_ms;
+        config_reader_offline(rcu);
+
+        publish();
+        struct timespec nap = {interval / 1000, (long)(interval % 1000) * 1000000L};
+        nanosleep(&nap, NULL);
+    }
+    return NULL;
+}
+
+int metrics_start(const struct raw_config *cfg) {
+    if (cfg->metrics_path[0] == '\0') return 0;
+
+    size_t names_off = sizeof(struct metrics_header);
+    size_t values_off = names_off + (size_t)(NCOUNTERS + NHISTS) * METRICS_NAME_LEN;
+    size_t size = values_off +
+                  sizeof(uint64_t) * (size_t)(NCOUNTERS + NHISTS * RAW_STATS_HIST_BUCKETS);
+
+    // Truncating to zero first drops a previous run's contents, magic
+    // included, so a reader cannot mistake them for this run's.
+    int fd = open(cfg->metrics_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, 0) < 0 || ftruncate(fd, (off_t)size) < 0) {
+        fprintf(stderr, "❌ metrics: %s: %s\n", cfg->metrics_path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "❌ metrics: mmap %s: %s\n", cfg->metrics_path, strerror(errno));
+        return -1;
+    }
+    page = map;
+    values = (_Atomic uint64_t *)((char *)map + values_off);
+
+    page->version = METRICS_VERSION;
+    page->header_size = (uint32_t)names_off;
+    page->ncounters = NCOUNTERS;
+    page->nhists = NHISTS;
+    page->nbuckets = RAW_STATS_HIST_BUCKETS;
+    page->nworkers = (uint32_t)cfg->workers;
+    page->values_off = values_off;
+    page->pid = (uint64_t)getpid();
+    page->started_ns = realtime_ns();
+
+    char *name = (char *)map + names_off;
+#define X(n, desc)                                                             \
+    snprintf(name, METRICS_NAME_LEN, "%s", #n);                                \
+    name += METRICS_NAME_LEN;
+    RAW_STATS_COUNTERS(X)
+    RAW_STATS_GAUGES(X)
+    RAW_STATS_HISTOGRAMS(X)
+#undef X
+
+    publish();
+    atomic_thread_fence(memory_order_release);
+    memcpy(page->magic, METRICS_MAGIC, sizeof(page->magic));
+
+    rcu = config_reader_register();
+    config_reader_offline(rcu);
+    pthread_t tid;
+    int rc = pthread_create(&tid, NULL, metrics_main, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "❌ metrics: pthread_create: %s\n", strerror(rc));
+        return -1;
+    }
+    pthread_detach(tid);
+    printf("📊  metrics page %s (%zu bytes, every %d ms)\n", cfg->metrics_path, size,
+           cfg->metrics_interval_ms);
+    return 0;
+}
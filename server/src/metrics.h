@@ -0,0 +1,65 @@
+#ifndef RAW_METRICS_H
+#define RAW_METRICS_H
+
+// ============================================================================
+// Shared-memory metrics page
+// ----------------------------------------------------------------------------
+// With metrics_path set (e.g. /dev/shm/raw_server.metrics), a raw-metrics
+// thread copies every counter, gauge and histogram bucket into a memory-
+// mapped file each metrics_interval_ms. Sidecars and tools (tools/
+// raw_metrics.c) map the file read-only and read it with plain loads: no
+// socket, no syscall per scrape, nothing that competes with the workers for
+// the admin thread or for CPU at the moment the server is busiest.
+//
+// Consistency is a seqlock on one writer:
+//
+//   writer: seq = odd ─► store values ─► seq = even       (release)
+//   reader: s1 = seq (acquire), odd? retry ─► load values ─► fence
+//           (acquire) ─► s2 = seq; s1 != s2? retry
+//
+// A reader never blocks the writer and never sees a half-written snapshot.
+// The values are _Atomic and accessed relaxed on both sides, which compiles
+// to plain loads and stores on every target we care about while keeping
+// the concurrent access well-defined.
+//
+// Layout (host byte order; offsets are in the header so a reader built
+// against an older version can still find the sections it knows):
+//
+//   struct metrics_header                          header_size bytes
+//   char names[ncounters + nhists][METRICS_NAME_LEN]   counters+gauges, then
+//                                                  histograms, STATS order
+//   u64 counters[ncounters]                        at values_off
+//   u64 buckets[nhists][nbuckets]                  log2 buckets, see stats.h
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define METRICS_MAGIC "RAWMETR1"
+#define METRICS_VERSION 1
+#define METRICS_NAME_LEN 32
+
+struct metrics_header {
+    char magic[8];                  // written last at startup
+    uint32_t version;
+    uint32_t header_size;           // offset of the name table
+    uint32_t ncounters;             // counters and gauges
+    uint32_t nhists;
+    uint32_t nbuckets;              // per histogram
+    uint32_t nworkers;
+    uint64_t values_off;            // offset of counters[]
+    uint64_t pid;
+    uint64_t started_ns;            // CLOCK_REALTIME at startup
+
+    // Seqlock-protected along with the values.
+    _Atomic uint64_t seq;           // odd while a publish is in progress
+    _Atomic uint64_t updated_ns;    // CLOCK_REALTIME of the last publish
+    _Atomic uint64_t publishes;
+};
+
+struct raw_config;
+
+// Creates and maps cfg->metrics_path and starts the publisher thread
+// (call after workers_start(): it reads the per-worker stats). Returns 0
+// (also when metrics_path is empty), or -1 with a message printed.
+int metrics_start(const struct raw_config *cfg);
+
+#endif
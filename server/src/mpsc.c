@@ -0,0 +1,99 @@
+// ============================================================================
+// Cross-thread message rings
+// ----------------------------------------------------------------------------
+// A bounded ring in the style of Vyukov's array queue: each slot carries a
+// sequence number that says whose turn it is. For position p (slot p & mask)
+//
+//   seq == p          free: the producer that claims tail p may fill it
+//   seq == p + 1      filled: the owner may read it
+//   seq == p + cap    read: free again for position p + cap
+//
+// so producers never look at the owner's head and the owner never touches
+// the tail.
+// ============================================================================
+#define _GNU_SOURCE
+#include "mpsc.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct mpsc_slot {
+    _Alignas(64) _Atomic uint64_t seq;
+    struct mpsc_msg msg;
+};
+
+int mpsc_init(struct mpsc *q, unsigned capacity, int wake_fd) {
+    uint64_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+    q->slots = aligned_alloc(64, cap * sizeof(struct mpsc_slot));
+    if (!q->slots) return -1;
+    for (uint64_t i = 0; i < cap; i++) atomic_init(&q->slots[i].seq, i);
+    q->mask = cap - 1;
+    q->wake_fd = wake_fd;
+    atomic_init(&q->tail, 0);
+    q->head = 0;
+    atomic_init(&q->sleeping, 0);
+    return 0;
+}
+
+int mpsc_push(struct mpsc *q, const struct mpsc_msg *m) {
+    uint64_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    struct mpsc_slot *s;
+    for (;;) {
+        s = &q->slots[pos & q->mask];
+        uint64_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        int64_t dif = (int64_t)(seq - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return -1;                      // the owner is a full lap behind
+        } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+    s->msg = *m;
+    atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+int mpsc_kick(struct mpsc *q) {
+    // Pairs with the fence in mpsc_park(): either the owner sees our message
+    // before blocking, or we see it parked and wake it.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&q->sleeping, memory_order_relaxed)) return 0;
+    if (!atomic_exchange_explicit(&q->sleeping, 0, memory_order_relaxed)) return 0;
+    uint64_t one = 1;
+    ssize_t rc = write(q->wake_fd, &one, sizeof(one));
+    (void)rc;                               // counter saturation is harmless
+    return 1;
+}
+
+int mpsc_pop(struct mpsc *q, struct mpsc_msg *m) {
+    struct mpsc_slot *s = &q->slots[q->head & q->mask];
+    if (atomic_load_explicit(&s->seq, memory_order_acquire) != q->head + 1) return 0;
+    *m = s->msg;
+    atomic_store_explicit(&s->seq, q->head + q->mask + 1, memory_order_release);
+    q->head++;
+    return 1;
+}
+
+int mpsc_park(struct mpsc *q) {
+    atomic_store_explicit(&q->sleeping, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    struct mpsc_slot *s = &q->slots[q->head & q->mask];
+    if (atomic_load_explicit(&s->seq, memory_order_acquire) == q->head + 1) {
+        atomic_store_explicit(&q->sleeping, 0, memory_order_relaxed);
+        return 0;
+    }
+    return 1;
+}
+
+void mpsc_unpark(struct mpsc *q) {
+    atomic_store_explicit(&q->sleeping, 0, memory_order_relaxed);
+}
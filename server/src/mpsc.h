@@ -0,0 +1,68 @@
+#ifndef RAW_MPSC_H
+#define RAW_MPSC_H
+
+// ============================================================================
+// Cross-thread message rings: bounded MPSC queues with idle-only wakeups
+// ----------------------------------------------------------------------------
+// Every worker owns one ring (its inbox). Any thread may push; only the owner
+// pops. Features that move work between cores (connection migration today;
+// fan-out or forwarded requests later) talk to a worker by posting a message
+// rather than by taking a lock the worker would also need on its hot path.
+//
+//   mpsc_push()    claims a slot with one CAS on the tail, fills it and
+//                  publishes it through the slot's sequence number; a full
+//                  ring is reported, never waited on
+//   mpsc_pop()     owner only: plain loads and stores, no read-modify-write
+//
+// Slots, the producers' tail and the owner's head each sit on their own
+// cache line, so a producer filling slot i does not invalidate the line the
+// owner is reading slot i-1 from.
+//
+// Wakeups: the owner sleeps in epoll_wait() on an eventfd, and writing it is
+// a syscall per message if done naively. Instead the owner raises 'sleeping'
+// just before it blocks (mpsc_park) and lowers it as soon as it is back
+// (mpsc_unpark); mpsc_kick() writes the eventfd only when it is raised, and
+// only the producer that lowers it does. A busy owner is never signalled (it
+// drains its inbox every loop iteration anyway), and a burst of messages to
+// an idle one costs a single write. Producers push a batch, then kick once.
+#include <stdint.h>
+
+struct mpsc_msg {
+    uint32_t type;                  // meaning is up to the owner
+    uint32_t arg32;
+    void *ptr;
+    uint64_t arg;
+};
+
+struct mpsc_slot;
+
+struct mpsc {
+    struct mpsc_slot *slots;
+    uint64_t mask;                  // capacity - 1
+    int wake_fd;                    // the owner's eventfd
+    _Alignas(64) _Atomic uint64_t tail;    // producers: next position to claim
+    _Alignas(64) uint64_t head;            // owner: next position to read
+    _Alignas(64) _Atomic int sleeping;     // owner is (about to be) blocked
+};
+
+// Capacity is rounded up to a power of two. Returns 0, or -1 with errno set.
+int mpsc_init(struct mpsc *q, unsigned capacity, int wake_fd);
+
+// Any thread. Returns 0, or -1 if the ring is full (nothing was queued).
+int mpsc_push(struct mpsc *q, const struct mpsc_msg *m);
+
+// Any thread, after one or more pushes: wakes the owner if it is parked.
+// Returns 1 if that took an eventfd write, 0 if the owner was awake.
+int mpsc_kick(struct mpsc *q);
+
+// Owner only. Returns 1 and fills *m, or 0 if the ring is empty.
+int mpsc_pop(struct mpsc *q, struct mpsc_msg *m);
+
+// Owner only, right before blocking. Returns 1 if it may block, 0 if
+// messages arrived meanwhile (the caller should poll instead).
+int mpsc_park(struct mpsc *q);
+
+// Owner only, right after waking up.
+void mpsc_unpark(struct mpsc *q);
+
+#endif
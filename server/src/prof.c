@@ -0,0 +1,447 @@
+// ============================================================================
+// Sampling profiler (perf_event_open based)
+// ----------------------------------------------------------------------------
+// Pipeline:
+//   1. Enumerate /proc/self/task and open one PERF_COUNT_SW_CPU_CLOCK event
+//      per thread, sampling TID + user call chain at a fixed frequency.
+//   2. mmap(2) each event's ring buffer and drain it periodically while the
+//      sampling window is open; identical stacks are merged in a hash table.
+//   3. Symbolize each distinct stack once, at the end, and print folded lines.
+//
+// Symbolization:
+//   - Addresses inside the raw_server executable are resolved against its own
+//     ELF .symtab (read from /proc/self/exe), which also covers static
+//     functions. Everything else (libc, vdso) falls back to dladdr(3), and
+//     finally to "module+0xoffset" so stacks stay distinguishable.
+#define _GNU_SOURCE
+#include "prof.h"
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROF_MAX_THREADS 256
+#define PROF_MAX_DEPTH 64
+#define PROF_RING_PAGES 16          // data pages per event (power of two)
+#define PROF_TABLE_SIZE 8192        // distinct stacks kept (power of two)
+#define PROF_DRAIN_MS 50            // ring drain period during the window
+
+struct prof_thread {
+    pid_t tid;
+    int fd;
+    void *ring;                     // metadata page + PROF_RING_PAGES data pages
+    char comm[16];
+};
+
+struct prof_stack {
+    uint64_t hash;                  // 0 marks an empty slot
+    uint64_t count;
+    uint32_t depth;
+    int thread;                     // index into prof_ctx.threads
+    uint64_t ips[PROF_MAX_DEPTH];   // leaf first, as delivered by the kernel
+};
+
+struct prof_sym {
+    uintptr_t addr;
+    uintptr_t size;
+    const char *name;
+};
+
+struct prof_ctx {
+    struct prof_thread threads[PROF_MAX_THREADS];
+    int nthreads;
+    size_t page;
+    struct prof_stack *table;
+    uint64_t samples, lost, dropped;
+
+    // Executable symbols (sorted by address) and the load bias for PIE.
+    struct prof_sym *syms;
+    size_t nsyms;
+    uintptr_t exe_base;
+    void *exe_map;
+    size_t exe_len;
+};
+
+static long perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+                            int group_fd, unsigned long flags) {
+    return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+// ============================================================================
+// Thread discovery and event setup
+// ============================================================================
+static void read_comm(pid_t tid, char *comm, size_t len) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/comm", (int)tid);
+    FILE *f = fopen(path, "r");
+    if (!f || !fgets(comm, (int)len, f)) {
+        snprintf(comm, len, "tid-%d", (int)tid);
+    } else {
+        comm[strcspn(comm, "\n")] = '\0';
+    }
+    if (f) fclose(f);
+}
+
+static int attach_thread(struct prof_ctx *ctx, pid_t tid, unsigned hz) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_CPU_CLOCK;
+    attr.freq = 1;
+    attr.sample_freq = hz;
+    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;        // allowed at perf_event_paranoid == 2
+    attr.exclude_hv = 1;
+    attr.exclude_callchain_kernel = 1;
+    attr.sample_max_stack = PROF_MAX_DEPTH;
+
+    int fd = (int)perf_event_open(&attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0) return -1;
+
+    size_t len = (PROF_RING_PAGES + 1) * ctx->page;
+    void *ring = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ring == MAP_FAILED) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    struct prof_thread *t = &ctx->threads[ctx->nthreads++];
+    t->tid = tid;
+    t->fd = fd;
+    t->ring = ring;
+    read_comm(tid, t->comm, sizeof(t->comm));
+    return 0;
+}
+
+static int attach_all(struct prof_ctx *ctx, unsigned hz) {
+    DIR *d = opendir("/proc/self/task");
+    if (!d) return -1;
+
+    pid_t self = (pid_t)syscall(SYS_gettid);
+    int last_err = ESRCH;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL && ctx->nthreads < PROF_MAX_THREADS) {
+        if (de->d_name[0] == '.') continue;
+        pid_t tid = (pid_t)atoi(de->d_name);
+        if (tid == self) continue;              // the admin thread just sleeps
+        if (attach_thread(ctx, tid, hz) < 0) last_err = errno;
+    }
+    closedir(d);
+
+    if (ctx->nthreads == 0) {
+        errno = last_err;
+        return -1;
+    }
+    return 0;
+}
+
+static void detach_all(struct prof_ctx *ctx) {
+    size_t len = (PROF_RING_PAGES + 1) * ctx->page;
+    for (int i = 0; i < ctx->nthreads; i++) {
+        munmap(ctx->threads[i].ring, len);
+        close(ctx->threads[i].fd);
+    }
+    ctx->nthreads = 0;
+}
+
+static void set_enabled(struct prof_ctx *ctx, int on) {
+    unsigned long req = on ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE;
+    for (int i = 0; i < ctx->nthreads; i++) {
+        ioctl(ctx->threads[i].fd, req, 0);
+    }
+}
+
+// ============================================================================
+// Sample aggregation
+// ----------------------------------------------------------------------------
+// The ring is a power-of-two byte buffer; records may wrap around its end, so
+// each record is first copied into a linear scratch buffer. data_head is
+// published by the kernel (acquire), data_tail is ours to advance (release).
+// ============================================================================
+static uint64_t hash_stack(int thread, const uint64_t *ips, uint32_t depth) {
+    uint64_t h = 1469598103934665603ULL ^ (uint64_t)thread;
+    for (uint32_t i = 0; i < depth; i++) {
+        h ^= ips[i];
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+static void record_stack(struct prof_ctx *ctx, int thread,
+                         const uint64_t *ips, uint64_t nr) {
+    uint64_t clean[PROF_MAX_DEPTH];
+    uint32_t depth = 0;
+    for (uint64_t i = 0; i < nr && depth < PROF_MAX_DEPTH; i++) {
+        if (ips[i] >= (uint64_t)PERF_CONTEXT_MAX) continue;   // context markers
+        clean[depth++] = ips[i];
+    }
+    if (depth == 0) return;
+
+    ctx->samples++;
+    uint64_t h = hash_stack(thread, clean, depth);
+    for (uint64_t probe = 0; probe < PROF_TABLE_SIZE; probe++) {
+        struct prof_stack *s = &ctx->table[(h + probe) & (PROF_TABLE_SIZE - 1)];
+        if (s->hash == 0) {
+            s->hash = h;
+            s->count = 1;
+            s->depth = depth;
+            s->thread = thread;
+            memcpy(s->ips, clean, depth * sizeof(uint64_t));
+            return;
+        }
+        if (s->hash == h && s->thread == thread && s->depth == depth &&
+            memcmp(s->ips, clean, depth * sizeof(uint64_t)) == 0) {
+            s->count++;
+            return;
+        }
+    }
+    ctx->dropped++;
+}
+
+static void drain_ring(struct prof_ctx *ctx, int thread) {
+    struct perf_event_mmap_page *meta = ctx->threads[thread].ring;
+    unsigned char *data = (unsigned char *)meta + ctx->page;
+    uint64_t size = PROF_RING_PAGES * ctx->page;
+    uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = meta->data_tail;
+    uint64_t scratch[(sizeof(struct perf_event_header) / 8) + 4 + PROF_MAX_DEPTH * 2];
+
+    while (tail < head) {
+        struct perf_event_header hdr;
+        for (size_t i = 0; i < sizeof(hdr); i++) {
+            ((unsigned char *)&hdr)[i] = data[(tail + i) & (size - 1)];
+        }
+        if (hdr.size == 0) break;
+
+        if (hdr.type == PERF_RECORD_SAMPLE) {
+            size_t n = hdr.size < sizeof(scratch) ? hdr.size : sizeof(scratch);
+            for (size_t i = 0; i < n; i++) {
+                ((unsigned char *)scratch)[i] = data[(tail + i) & (size - 1)];
+            }
+            // Layout for TID|CALLCHAIN: header, u32 pid, u32 tid, u64 nr, ips[nr]
+            const unsigned char *p = (const unsigned char *)scratch + sizeof(hdr);
+            uint64_t nr;
+            memcpy(&nr, p + 8, sizeof(nr));
+            uint64_t room = (n - sizeof(hdr) - 16) / sizeof(uint64_t);
+            if (nr > room) nr = room;
+            record_stack(ctx, thread, (const uint64_t *)(p + 16), nr);
+        } else if (hdr.type == PERF_RECORD_LOST) {
+            uint64_t lost[2];       // u64 id, u64 lost
+            for (size_t i = 0; i < sizeof(lost); i++) {
+                ((unsigned char *)lost)[i] =
+                    data[(tail + sizeof(hdr) + i) & (size - 1)];
+            }
+            ctx->lost += lost[1];
+        }
+        tail += hdr.size;
+    }
+    __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+static void drain_all(struct prof_ctx *ctx) {
+    for (int i = 0; i < ctx->nthreads; i++) {
+        drain_ring(ctx, i);
+    }
+}
+
+// ============================================================================
+// Symbolization
+// ============================================================================
+static int exe_base_cb(struct dl_phdr_info *info, size_t size, void *arg) {
+    (void)size;
+    *(uintptr_t *)arg = (uintptr_t)info->dlpi_addr;
+    return 1;                       // first entry is the main program
+}
+
+static int sym_cmp(const void *a, const void *b) {
+    const struct prof_sym *x = a, *y = b;
+    return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+static void load_exe_symbols(struct prof_ctx *ctx) {
+    dl_iterate_phdr(exe_base_cb, &ctx->exe_base);
+
+    int fd = open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Elf64_Ehdr)) {
+        close(fd);
+        return;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return;
+    ctx->exe_map = map;
+    ctx->exe_len = (size_t)st.st_size;
+
+    const unsigned char *base = map;
+    const Elf64_Ehdr *eh = map;
+    if (memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+        eh->e_shoff + (uint64_t)eh->e_shnum * sizeof(Elf64_Shdr) > ctx->exe_len) {
+        return;
+    }
+    const Elf64_Shdr *sh = (const Elf64_Shdr *)(base + eh->e_shoff);
+
+    // Prefer the full .symtab; a stripped binary still has .dynsym.
+    const Elf64_Shdr *symtab = NULL;
+    for (int pass = 0; pass < 2 && !symtab; pass++) {
+        uint32_t want = pass == 0 ? SHT_SYMTAB : SHT_DYNSYM;
+        for (unsigned i = 0; i < eh->e_shnum; i++) {
+            if (sh[i].sh_type == want) {
+                symtab = &sh[i];
+                break;
+            }
+        }
+    }
+    if (!symtab || symtab->sh_link >= eh->e_shnum) return;
+    const Elf64_Shdr *strtab = &sh[symtab->sh_link];
+    if (symtab->sh_offset + symtab->sh_size > ctx->exe_len ||
+        strtab->sh_offset + strtab->sh_size > ctx->exe_len) {
+        return;
+    }
+
+    const Elf64_Sym *sym = (const Elf64_Sym *)(base + symtab->sh_offset);
+    size_t n = symtab->sh_size / sizeof(Elf64_Sym);
+    ctx->syms = calloc(n ? n : 1, sizeof(*ctx->syms));
+    if (!ctx->syms) return;
+
+    for (size_t i = 0; i < n; i++) {
+        if (ELF64_ST_TYPE(sym[i].st_info) != STT_FUNC || sym[i].st_value == 0 ||
+            sym[i].st_name >= strtab->sh_size) {
+            continue;
+        }
+        struct prof_sym *s = &ctx->syms[ctx->nsyms++];
+        s->addr = (uintptr_t)sym[i].st_value + ctx->exe_base;
+        s->size = (uintptr_t)sym[i].st_size;
+        s->name = (const char *)(base + strtab->sh_offset + sym[i].st_name);
+    }
+    qsort(ctx->syms, ctx->nsyms, sizeof(*ctx->syms), sym_cmp);
+}
+
+static void symbolize(const struct prof_ctx *ctx, uintptr_t ip,
+                      char *out, size_t len) {
+    size_t lo = 0, hi = ctx->nsyms;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ctx->syms[mid].addr <= ip) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo > 0) {
+        const struct prof_sym *s = &ctx->syms[lo - 1];
+        if (ip < s->addr + (s->size ? s->size : 1)) {
+            snprintf(out, len, "%s", s->name);
+            return;
+        }
+    }
+
+    Dl_info info;
+    if (dladdr((void *)ip, &info)) {
+        if (info.dli_sname) {
+            snprintf(out, len, "%s", info.dli_sname);
+            return;
+        }
+        if (info.dli_fname) {
+            const char *slash = strrchr(info.dli_fname, '/');
+            snprintf(out, len, "%s+0x%lx", slash ? slash + 1 : info.dli_fname,
+                     (unsigned long)(ip - (uintptr_t)info.dli_fbase));
+            return;
+        }
+    }
+    snprintf(out, len, "0x%lx", (unsigned long)ip);
+}
+
+static void emit_folded(const struct prof_ctx *ctx, FILE *out) {
+    char name[256];
+    for (size_t i = 0; i < PROF_TABLE_SIZE; i++) {
+        const struct prof_stack *s = &ctx->table[i];
+        if (s->hash == 0) continue;
+
+        fputs(ctx->threads[s->thread].comm, out);
+        for (uint32_t d = s->depth; d-- > 0;) {
+            // Non-leaf entries are return addresses; step back into the call
+            // instruction so a call at the very end of a function resolves to
+            // the caller rather than whatever follows it.
+            uintptr_t ip = (uintptr_t)s->ips[d] - (d > 0 ? 1 : 0);
+            symbolize(ctx, ip, name, sizeof(name));
+            fputc(';', out);
+            fputs(name, out);
+        }
+        fprintf(out, " %llu\n", (unsigned long long)s->count);
+    }
+}
+
+// ============================================================================
+// Public entry point
+// ============================================================================
+int prof_run(FILE *out, unsigned secs, unsigned hz) {
+    if (secs == 0) secs = PROF_DEFAULT_SECS;
+    if (secs > PROF_MAX_SECS) secs = PROF_MAX_SECS;
+    if (hz == 0) hz = PROF_DEFAULT_HZ;
+    if (hz > PROF_MAX_HZ) hz = PROF_MAX_HZ;
+
+    struct prof_ctx *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) return -1;
+    ctx->page = (size_t)sysconf(_SC_PAGESIZE);
+    ctx->table = calloc(PROF_TABLE_SIZE, sizeof(*ctx->table));
+    if (!ctx->table) {
+        free(ctx);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (attach_all(ctx, hz) < 0) {
+        int saved = errno;
+        free(ctx->table);
+        free(ctx);
+        errno = saved;
+        return -1;
+    }
+
+    struct timespec now, end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end.tv_sec += secs;
+    set_enabled(ctx, 1);
+    for (;;) {
+        struct timespec nap = {0, PROF_DRAIN_MS * 1000000L};
+        nanosleep(&nap, NULL);
+        drain_all(ctx);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > end.tv_sec ||
+            (now.tv_sec == end.tv_sec && now.tv_nsec >= end.tv_nsec)) {
+            break;
+        }
+    }
+    set_enabled(ctx, 0);
+    drain_all(ctx);
+
+    load_exe_symbols(ctx);
+    emit_folded(ctx, out);
+    fprintf(stderr, "🔬  profile: %d threads, %llu samples, %llu lost, %llu dropped\n",
+            ctx->nthreads, (unsigned long long)ctx->samples,
+            (unsigned long long)ctx->lost, (unsigned long long)ctx->dropped);
+
+    detach_all(ctx);
+    if (ctx->exe_map) munmap(ctx->exe_map, ctx->exe_len);
+    free(ctx->syms);
+    free(ctx->table);
+    free(ctx);
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef RAW_PROF_H
+#define RAW_PROF_H
+
+// ============================================================================
+// Built-in sampling profiler
+// ----------------------------------------------------------------------------
+// prof_run(out, secs, hz)
+//   - Attaches a CPU-clock sampling event (perf_event_open(2)) to every thread
+//     of this process except the caller, samples user-space call chains at
+//     'hz' for 'secs' seconds, and writes the result to 'out' in the "folded"
+//     format consumed by flamegraph.pl / speedscope / inferno:
+//
+//         raw-worker-0;main;worker_loop;handle_readable;recv 42
+//
+//   - Returns 0 on success, or -1 with errno set if no thread could be
+//     attached (typically EACCES when kernel.perf_event_paranoid > 2 or a
+//     seccomp profile filters perf_event_open).
+//
+// Why in-process:
+//   - Locked-down containers rarely ship perf(1) or grant CAP_PERFMON, but an
+//     unprivileged process may still profile *itself* (paranoid <= 2). Doing
+//     the sampling from inside raw_server turns "we can't look" into a single
+//     admin command against a live instance.
+//
+// Caveats:
+//   - User-space unwinding is done by the kernel via frame pointers, so the
+//     server is built with -fno-omit-frame-pointer. Frames inside libraries
+//     compiled without them may be truncated.
+//   - The call blocks for the full sampling window.
+#include <stdio.h>
+
+#define PROF_DEFAULT_SECS 10
+#define PROF_MAX_SECS 120
+#define PROF_DEFAULT_HZ 99
+#define PROF_MAX_HZ 4999
+
+int prof_run(FILE *out, unsigned secs, unsigned hz);
+
+#endif
@@ -38,6 +38,47 @@
 // <unistd.h>
 //   - POSIX OS services (close, read, write). Provides the canonical file
 //     descriptor interface; sockets are file descriptors under the hood.
+//
+// "admin.h"
+//   - Optional operator port (loopback) served from its own thread; hosts the
+//     built-in sampling profiler among other commands.
+//
+// "cluster.h"
+//   - Optional cluster mode: which member owns a key; workers forward.
+//
+// "config.h"
+//   - The runtime configuration snapshot (limits, socket options, rate limits)
+//     and its lock-free publication to worker threads.
+//
+// "io.h"
+//   - The I/O backend serving connections (epoll, blocking or io_uring),
+//     chosen with io_backend.
+//
+// "journal.h"
+//   - Optional durable request log with group commit; workers hold replies
+//     until the batch containing the request is on stable storage.
+//
+// "kv.h"
+//   - Optional SET/GET/DEL store shared by all workers (sharded, bounded).
+//
+// "snapshot.h"
+//   - Optional fork-based KV snapshots, loaded back with mmap at startup.
+//
+// "worker.h"
+//   - The per-thread epoll event loops that own and serve connections.
+#define _GNU_SOURCE
+#include "admin.h"
+#include "cluster.h"
+#include "config.h"
+#include "flight.h"
+#include "io.h"
+#include "journal.h"
+#include "kv.h"
+#include "metrics.h"
+#include "snapshot.h"
+#include "utf8.h"
+#include "worker.h"
+
 #include <arpa/inet.h>
 #include <errno.h>
 #include <netinet/in.h>
@@ -52,19 +93,23 @@
 // ============================================================================
 // Protocol and resource parameters
 // ----------------------------------------------------------------------------
-// MAX_MSG_LEN
+// These used to be #defines; they are now fields of struct raw_config (see
+// config.h) so they can be changed in a config file without a rebuild.
+//
+// max_msg_len (default 20)
 //   - Application-level constraint: we bound each echo request to ≤ 20 bytes.
 //   - Motivation: Demonstrates defensive design against unbounded reads and
-//     clarifies the server’s contract. Also caps per-connection buffer size.
+//     clarifies the server’s contract. Buffers are sized for MSG_LEN_CAP so
+//     the limit can be raised live without reallocating anything.
 //
-// BACKLOG
+// backlog (default 128)
 //   - Argument to listen(2) controlling the length of the kernel’s SYN/accept
 //     queue for this listening socket. If simultaneous connection attempts
 //     exceed this backlog and the application is not accept()’ing fast enough,
 //     the kernel may refuse additional connections (or clients experience delay).
 //   - Note: The kernel may cap this value (e.g., somaxconn). 128 is a modest default.
-#define MAX_MSG_LEN 20
-#define BACKLOG 128
+//   - Calling listen(2) again on a listening socket updates the backlog in
+//     place, which is how a reload applies a new value.
 
 // ============================================================================
 // Error termination helper
@@ -82,40 +127,10 @@ static void die(const char *msg) {
     exit(EXIT_FAILURE);
 }
 
-int main(int argc, char **argv) {
-    // =========================================================================
-    // 1) Configuration: which local address/port to bind
-    // -------------------------------------------------------------------------
-    // Defaults:
-    //   - IP  "0.0.0.0" binds to INADDR_ANY: the kernel will accept connections
-    //     arriving on any local interface (loopback, ethernet, etc.).
-    //   - Port 9000 is an arbitrary user-space port (not privileged).
-    //
-    // Rationale:
-    //   - Separating configuration from mechanics improves testability.
-    //   - Accepting overrides via argv enables flexible deployment (e.g., Docker).
-    const char *bind_ip = "0.0.0.0";
-    int port = 9000;
-
-    if (argc >= 2) {
-        bind_ip = argv[1];            // e.g., "127.0.0.1" to restrict to loopback
-    }
-    if (argc >= 3) {
-        port = atoi(argv[2]);         // simplistic parse; production would validate
-    }
-
-    // =========================================================================
-    // 2) Signal semantics: avoid process termination on broken pipe
-    // -------------------------------------------------------------------------
-    // Problem:
-    //   - When the peer half-closes the connection and we subsequently send(),
-    //     POSIX may raise SIGPIPE. Default disposition is to terminate the process.
-    //
-    // Strategy:
-    //   - Ignore SIGPIPE so send() fails with -1 and errno=EPIPE, letting us
-    //     handle errors explicitly in program logic instead of via signal death.
-    signal(SIGPIPE, SIG_IGN);
-
+// ============================================================================
+// Listening socket setup
+// ============================================================================
+static int open_listener(const char *bind_ip, int port, int backlog, int reuseport) {
     // =========================================================================
     // 3) Create the listening socket (endpoint in the local kernel)
     // -------------------------------------------------------------------------
@@ -133,16 +148,27 @@ int main(int argc, char **argv) {
     }
 
     // =========================================================================
-    // 4) Tuning: allow quick rebinding after restart
+    // 4) Tuning: allow quick rebinding after restart, and per-worker sockets
     // -------------------------------------------------------------------------
     // SO_REUSEADDR
     //   - Without this, a recently-closed TCP port may be stuck in TIME_WAIT and
     //     bind() can fail with EADDRINUSE. This option allows faster development
     //     cycles by relaxing certain checks for local address reuse.
+    //
+    // SO_REUSEPORT (accept_mode = reuseport)
+    //   - Lets every worker bind its own socket to the same (ip, port). The
+    //     kernel load-balances new connections across them by 4-tuple hash.
+    //   - In exclusive mode there is one socket per address, shared by all
+    //     workers, and the option stays off: a second server started on the
+    //     same port by mistake then fails to bind instead of stealing a share
+    //     of the connections.
     int yes = 1;
     if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0) {
         die("setsockopt");
     }
+    if (reuseport && setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0) {
+        die("setsockopt SO_REUSEPORT");
+    }
 
     // =========================================================================
     // 5) Materialize the bind address (userspace struct -> kernel ABI layout)
@@ -185,145 +211,202 @@ int main(int argc, char **argv) {
     //   - Notifies the kernel that we intend to accept incoming connections.
     //   - Creates/adjusts the accept queue whose capacity is guided by 'backlog'.
     //   - TCP state machine for this socket becomes “LISTEN”.
-    if (listen(s, BACKLOG) < 0) {
+    if (listen(s, backlog) < 0) {
         die("listen");
     }
+    return s;
+}
+
+// Reload hook (runs on the config watcher thread): listen(2) on an already
+// listening socket only resizes its accept queue, so a new backlog is applied
+// without closing anything.
+static void apply_reload(const struct raw_config *old_cfg,
+                         const struct raw_config *new_cfg) {
+    if (old_cfg->backlog != new_cfg->backlog) {
+        io_current()->apply_backlog(new_cfg->backlog);
+    }
+}
 
-    printf("⚡ raw TCP server listening on %s:%d (max %d chars per message)\n",
-           bind_ip, port, MAX_MSG_LEN);
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [bind_ip] [port] [admin_port]\n"
+            "       %s -c <config-file>   (watched; live settings reload on save)\n",
+            prog, prog);
+    exit(EXIT_FAILURE);
+}
 
+int main(int argc, char **argv) {
     // =========================================================================
-    // 8) Accept loop: convert pending SYNs into connected sockets
+    // 1) Configuration: which local address/port to bind, and everything else
     // -------------------------------------------------------------------------
-    // Model:
-    //   - The listening socket 's' remains in LISTEN state. Each successful
-    //     accept() returns a *new* connected socket descriptor 'cfd' bound
-    //     to the 5-tuple (src IP/port, dst IP/port, protocol) for that client.
-    //   - 'cfd' is independent of 's'; closing 'cfd' does not affect 's'.
+    // Defaults:
+    //   - IP  "0.0.0.0" binds to INADDR_ANY: the kernel will accept connections
+    //     arriving on any local interface (loopback, ethernet, etc.).
+    //   - Port 9000 is an arbitrary user-space port (not privileged).
     //
-    // Blocking semantics:
-    //   - accept() blocks by default until the kernel dequeues a connection
-    //     from the accept queue. EINTR indicates interruption by a signal.
-    for (;;) {
-        struct sockaddr_in cli;
-        socklen_t clen = sizeof(cli);
+    // Rationale:
+    //   - Separating configuration from mechanics improves testability.
+    //   - Accepting overrides via argv enables flexible deployment (e.g., Docker).
+    //   - The admin port (argv[3]) is off by default; when given, it is bound
+    //     to loopback only so it is reachable via `exec` but not the network.
+    //   - With -c, all settings come from a file that is watched for changes;
+    //     live-safe settings are republished to running workers on save.
+    struct raw_config *cfg = malloc(sizeof(*cfg));
+    if (!cfg) die("malloc");
+    config_defaults(cfg);
 
-        int cfd = accept(s, (struct sockaddr *)&cli, &clen);
-        if (cfd < 0) {
-            if (errno == EINTR) continue;      // retry on signal interruption
-            perror("accept");                  // transient errors logged; continue serving
-            continue;
+    const char *config_path = NULL;
+    if (argc >= 2 && strcmp(argv[1], "-c") == 0) {
+        if (argc != 3) usage(argv[0]);
+        config_path = argv[2];
+        char err[256];
+        if (config_load(cfg, config_path, err, sizeof(err)) < 0) {
+            fprintf(stderr, "config: %s\n", err);
+            exit(EXIT_FAILURE);
         }
+    } else {
+        if (argc > 4) usage(argv[0]);
+        const char *bind_ip = argc >= 2 ? argv[1] : "0.0.0.0"; // e.g., "127.0.0.1" for loopback only
+        int port = argc >= 3 ? atoi(argv[2]) : 9000;            // simplistic parse; production would validate
+        if (config_add_listen(cfg, bind_ip, port) < 0) usage(argv[0]);
+        if (argc >= 4) {
+            cfg->admin_port = atoi(argv[3]);                     // e.g., 9001; 0 keeps it closed
+        }
+    }
+    config_publish_initial(cfg);
 
-        // Optional: observe peer address (for logging/diagnostics).
-        // inet_ntop converts the binary address back to presentation format.
-        char client_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &cli.sin_addr, client_ip, sizeof(client_ip));
-        printf("👋  client connected from %s:%d\n", client_ip, ntohs(cli.sin_port));
-
-        // ---------------------------------------------------------------------
-        // Per-connection handling (to be implemented next):
-        //   - Read at most MAX_MSG_LEN application bytes (enforce protocol).
-        //   - If the message exceeds the bound, drain input and respond with an
-        //     error sentinel; otherwise echo the payload.
-        //
-        // Low-level I/O notes:
-        //   - recv(cfd, buf, n, 0) reads from the TCP receive buffer maintained
-        //     by the kernel for this connection. Short reads are possible.
-        //   - send(cfd, buf, n, 0) enqueues data into the TCP send buffer; the
-        //     kernel handles segmentation, retransmission, and congestion control.
-        //
-        // Robust servers would loop until newline or EOF, carefully handling:
-        //   * partial reads/writes
-        //   * EAGAIN/EWOULDBLOCK if using nonblocking I/O
-        //   * connection half-closes (peer shutdown(SHUT_WR))
-        //
+    // The backend is fixed for the life of the process; one that cannot
+    // serve this configuration is a startup error, not a silent downgrade.
+    const struct io_backend *io = io_backend_get(cfg->io_backend);
+    const char *unsupported = io->unsupported(cfg);
+    if (unsupported) {
+        fprintf(stderr, "config: io_backend = %s does not support %s (use epoll)\n", io->name,
+                unsupported);
+        exit(EXIT_FAILURE);
+    }
+    const char *ignored = io->ignored(cfg);
+    if (ignored) {
+        fprintf(stderr, "⚠️  io_backend = %s ignores %s (epoll only)\n", io->name, ignored);
+    }
 
-        // =========================================================================
-        // 9) Per-connection message processing
-        // -------------------------------------------------------------------------
-        // Goal:
-        //   Implement a simple request–response echo protocol:
-        //     - Read up to MAX_MSG_LEN bytes or until newline ('\n').
-        //     - If client sends > MAX_MSG_LEN bytes before newline,
-        //       discard the rest and respond with "ERR too long\n".
-        //     - Otherwise, echo the received bytes back verbatim.
-        //
-        // Design reasoning:
-        //   - recv() operates on the TCP receive buffer managed by the kernel.
-        //     Each call may return fewer bytes than requested; therefore, we
-        //     accumulate until newline or size limit.
-        //   - TCP is a stream protocol, not message-oriented — it preserves
-        //     byte order but not boundaries. Hence the explicit loop below.
-        //
-        char buf[MAX_MSG_LEN + 1];    // +1 for NUL terminator (for safe printing)
-        ssize_t total = 0;            // number of valid bytes accumulated
-        int too_long = 0;             // flag if message exceeds MAX_MSG_LEN
+    // =========================================================================
+    // 2) Signal semantics: avoid process termination on broken pipe
+    // -------------------------------------------------------------------------
+    // Problem:
+    //   - When the peer half-closes the connection and we subsequently send(),
+    //     POSIX may raise SIGPIPE. Default disposition is to terminate the process.
+    //
+    // Strategy:
+    //   - Ignore SIGPIPE so send() fails with -1 and errno=EPIPE, letting us
+    //     handle errors explicitly in program logic instead of via signal death.
+    signal(SIGPIPE, SIG_IGN);
 
-        for (;;) {
-            char ch;
-            ssize_t n = recv(cfd, &ch, 1, 0);  // read one byte at a time
-            if (n == 0) {
-                // Peer performed an orderly shutdown (sent FIN).
-                // The kernel’s receive queue is empty and the connection closed.
-                break;
-            } else if (n < 0) {
-                // recv() failed; EINTR means interrupted by a signal.
-                if (errno == EINTR) continue;
-                perror("recv");
-                break;
-            }
+    // Crashes (and SIGUSR1) dump every worker's recent events first; see
+    // flight.h.
+    flight_install(cfg->flight_path);
 
-            // Detect newline terminator (protocol boundary)
-            if (ch == '\n' || ch == '\r') {
-                break;
-            }
+    // Log lines come from several threads; line buffering keeps each one whole
+    // and visible promptly when stdout is a pipe (docker logs, systemd).
+    setvbuf(stdout, NULL, _IOLBF, 0);
 
-            // If message still within allowed bound, store it
-            if (total < MAX_MSG_LEN) {
-                buf[total++] = ch;
-            } else {
-                // Message too long: continue draining input
-                too_long = 1;
-            }
+    // =========================================================================
+    // 3–7) One listening socket per (worker, address); see open_listener()
+    // -------------------------------------------------------------------------
+    // With accept_mode = exclusive, one socket per address instead, which
+    // every worker watches (EPOLLEXCLUSIVE, see worker.c).
+    static int listen_fds[MAX_WORKERS][CONFIG_MAX_LISTEN];
+    int nworkers = cfg->workers;
+    int shared = cfg->accept_mode == ACCEPT_MODE_EXCLUSIVE;
+    for (int w = 0; w < nworkers; w++) {
+        for (int i = 0; i < cfg->nlisten; i++) {
+            listen_fds[w][i] = shared && w > 0
+                                   ? listen_fds[0][i]
+                                   : open_listener(cfg->listen[i].ip, cfg->listen[i].port,
+                                                   cfg->backlog, !shared);
         }
+    }
+
+    for (int i = 0; i < cfg->nlisten; i++) {
+        printf("⚡ raw TCP server listening on %s:%d (max %d chars per message, %d worker%s%s)\n",
+               cfg->listen[i].ip, cfg->listen[i].port, cfg->max_msg_len,
+               nworkers, nworkers == 1 ? "" : "s", shared ? ", shared accept queue" : "");
+    }
 
-        buf[total] = '\0';  // ensure string safety for printing/logging
+    // =========================================================================
+    // 7b) Admin interface (optional)
+    // -------------------------------------------------------------------------
+    // Started once the data sockets are listening. The serving threads come
+    // later (io_start(), step 8), so a PROFILE issued in the first moments
+    // after startup may find no worker to sample. Failing to open a requested
+    // admin port is fatal: silently running without it would surprise whoever
+    // asked for it.
+    if (cfg->admin_port > 0) {
+        if (admin_start("127.0.0.1", cfg->admin_port) < 0) {
+            die("admin");
+        }
+        printf("🛠️  admin interface on 127.0.0.1:%d (try: echo HELP | nc 127.0.0.1 %d)\n",
+               cfg->admin_port, cfg->admin_port);
+    }
 
-        // -------------------------------------------------------------------------
-        // Response path:
-        //   - If input exceeded MAX_MSG_LEN before newline, emit an error.
-        //   - Otherwise, echo the content exactly as received.
-        // send() semantics:
-        //   - Copies user-space bytes into the kernel’s send buffer. The kernel
-        //     handles segmentation and retransmission transparently.
-        //   - On EPIPE, the peer closed its read side; ignore gracefully.
-        if (too_long) {
-            const char *err = "ERR too long\n";
-            ssize_t wn = send(cfd, err, strlen(err), 0);
-            if (wn < 0 && errno != EPIPE)
-                perror("send error message");
-            printf("⚠️  client sent overlong message; error sent\n");
-        } else if (total > 0) {
-            ssize_t wn = send(cfd, buf, total, 0);
-            if (wn < 0 && errno != EPIPE)
-                perror("send echo");
-            else
-                send(cfd, "\n", 1, 0);  // append newline for readability
-            printf("🔁  echoed \"%s\" (%zd bytes)\n", buf, total);
-        } else {
-            // Empty or connection closed before sending data.
-            printf("ℹ️  connection closed with no data\n");
+    // =========================================================================
+    // 7c) Config watcher (only with -c)
+    // -------------------------------------------------------------------------
+    if (config_path) {
+        if (config_watch_start(config_path, apply_reload) < 0) {
+            die("config watch");
         }
+        printf("👀  watching %s for changes\n", config_path);
+    }
 
+    // =========================================================================
+    // 7d) Durable journal (only with journal_dir)
+    // -------------------------------------------------------------------------
+    // Opened before any worker can accept a request, so no echo is ever sent
+    // without its journal record. Failing to open it is fatal: an operator
+    // who asked for an audit trail must not get a server without one.
+    if (journal_start(cfg, workers_journal_wake) < 0) {
+        exit(EXIT_FAILURE);
+    }
 
-        close(cfd);  // Return the connected socket’s resources to the kernel.
-                     // This sends a FIN (orderly close) once unsent data is flushed.
+    // =========================================================================
+    // 7e) Key-value store (only with kv_max_mb)
+    // -------------------------------------------------------------------------
+    // Shards are allocated up front and sized from the worker count. The
+    // snapshot, if any, is loaded before a worker can serve a GET.
+    if (kv_start(cfg) < 0 || snapshot_start(cfg) < 0) {
+        exit(EXIT_FAILURE);
     }
 
-    // Unreachable in this minimal server; a graceful shutdown would:
-    //   - Close the listening socket, drain inflight connections, release resources.
-    //   - Consider SIGTERM handling and an accept() wakeup strategy.
+    // =========================================================================
+    // 7f) Cluster membership (only with peer / cluster_self)
+    // -------------------------------------------------------------------------
+    // Must precede the workers: each one sizes its member links from it.
+    if (cluster_start(cfg) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    fflush(stdout);
 
+    // =========================================================================
+    // 8–9) Start the workers (the I/O backend, see io.h); main just waits
+    // -------------------------------------------------------------------------
+    // text_mode is live, so the UTF-8 validator is picked whatever it is now.
+    utf8_init();
+    if (cfg->text_mode == TEXT_MODE_UTF8) {
+        printf("🔤  text_mode = utf8: max_msg_len counts code points (%s validator)\n",
+               utf8_impl());
+    }
+    if (io_start(io, nworkers, listen_fds, cfg->nlisten) < 0) {
+        die(io->name);
+    }
+    // The metrics page mirrors the per-worker stats, which exist from here.
+    if (metrics_start(cfg) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    fflush(stdout);
+    io->join();
 
+    // Unreachable in this minimal server; a graceful shutdown would:
+    //   - Close the listening sockets, drain inflight connections, release resources.
+    //   - Consider SIGTERM handling and an accept() wakeup strategy.
+    return 0;
 }
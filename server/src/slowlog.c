@@ -0,0 +1,97 @@
+// ============================================================================
+// Slow-request log: the logger thread
+// ----------------------------------------------------------------------------
+// Records arrive through an MPSC ring; the thread sleeps on a blocking
+// eventfd that producers only write while it is parked (mpsc_kick), so a
+// burst of slow requests costs the workers one write, not one per record.
+//
+// The records themselves live in a static pool of SLOWLOG_SLOTS, claimed
+// round-robin: the ring carries only the index, and the logger frees the
+// slot once the line is printed. Workers never allocate; a slot still
+// taken means the logger is a whole pool behind, and the record is dropped.
+// ============================================================================
+#define _GNU_SOURCE
+#include "slowlog.h"
+#include "mpsc.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define SLOWLOG_SLOTS 1024          // records waiting for the logger, power of two
+
+static struct mpsc queue;
+static int started;
+static struct slow_req pool[SLOWLOG_SLOTS];
+static _Atomic unsigned char pool_busy[SLOWLOG_SLOTS];
+static _Atomic unsigned pool_next;
+
+static double ms(uint64_t ns) {
+    return (double)ns / 1e6;
+}
+
+static void slowlog_print(const struct slow_req *r) {
+    char ip[INET_ADDRSTRLEN] = "?";
+    inet_ntop(AF_INET, &r->peer.sin_addr, ip, sizeof(ip));
+    printf("🐢  slow request %.3fms: worker %d conn %llu peer %s:%d bytes %u/%u |"
+           " queue %.3f read %.3f frame %.3f process %.3f write %.3f ms",
+           ms(r->total_ns), r->worker, (unsigned long long)r->conn, ip,
+           ntohs(r->peer.sin_port), r->bytes_in, r->bytes_out, ms(r->queue_ns),
+           ms(r->read_ns), ms(r->frame_ns), ms(r->process_ns), ms(r->write_ns));
+    if (r->more) {
+        printf(" | +%u in batch, slowest process %.3f ms", r->more, ms(r->more_process_ns));
+    }
+    printf("\n");
+}
+
+static void *slowlog_main(void *arg) {
+    (void)arg;
+    pthread_setname_np(pthread_self(), "raw-slowlog");
+    for (;;) {
+        struct mpsc_msg m;
+        while (mpsc_pop(&queue, &m)) {
+            slowlog_print(&pool[m.arg32]);
+            atomic_store_explicit(&pool_busy[m.arg32], 0, memory_order_release);
+        }
+        if (mpsc_park(&queue)) {
+            uint64_t n;
+            ssize_t rc = read(queue.wake_fd, &n, sizeof(n));
+            (void)rc;
+        }
+        mpsc_unpark(&queue);
+    }
+    return NULL;
+}
+
+int slowlog_start(void) {
+    int efd = eventfd(0, EFD_CLOEXEC);
+    if (efd < 0 || mpsc_init(&queue, SLOWLOG_SLOTS, efd) < 0) return -1;
+    pthread_t tid;
+    int rc = pthread_create(&tid, NULL, slowlog_main, NULL);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    pthread_detach(tid);
+    started = 1;
+    return 0;
+}
+
+int slowlog_submit(const struct slow_req *r) {
+    if (!started) return -1;
+    unsigned i = atomic_fetch_add_explicit(&pool_next, 1, memory_order_relaxed) &
+                 (SLOWLOG_SLOTS - 1);
+    if (atomic_exchange_explicit(&pool_busy[i], 1, memory_order_acquire)) return -1;
+    pool[i] = *r;
+    struct mpsc_msg m = {.arg32 = i};
+    if (mpsc_push(&queue, &m) < 0) {
+        atomic_store_explicit(&pool_busy[i], 0, memory_order_relaxed);
+        return -1;
+    }
+    mpsc_kick(&queue);
+    return 0;
+}
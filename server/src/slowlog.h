@@ -0,0 +1,47 @@
+#ifndef RAW_SLOWLOG_H
+#define RAW_SLOWLOG_H
+
+// ============================================================================
+// Slow-request log
+// ----------------------------------------------------------------------------
+// With slow_request_us > 0, every request whose end-to-end service time (its
+// first bytes read until its reply is handed to the kernel) reaches the limit
+// is logged with where the time went:
+//
+//   queue     ready but waiting for the worker (other connections in the
+//             batch, EDF order with deadlines = 1)
+//   read      recv() calls that brought its bytes in
+//   frame     finding it in the input buffer
+//   process   answering it
+//   write     reply queued until sent (backpressure, journal holds)
+//
+// Workers do not format or print anything: a slow request's record is copied
+// into a preallocated pool and posted to a logger thread through an MPSC ring
+// (mpsc.h); a full pool drops it (slow_dropped) rather than stall the
+// worker. Requests under the limit cost a few clock reads and no log line.
+//
+// Pipelined requests answered by the same send() share their write stage, so
+// only the oldest of them (the slowest end to end) gets a line; the others
+// are summarised in it ("+N in batch", with their slowest process stage).
+#include <netinet/in.h>
+#include <stdint.h>
+
+struct slow_req {
+    uint64_t total_ns;
+    uint64_t queue_ns, read_ns, frame_ns, process_ns, write_ns;
+    uint64_t conn;
+    uint32_t bytes_in, bytes_out;   // request and reply length
+    uint32_t more;                  // other requests answered by the same send
+    uint64_t more_process_ns;       // the slowest of their process stages
+    struct sockaddr_in peer;
+    int worker;
+};
+
+// Starts the logger thread. Returns 0, or -1 with errno set.
+int slowlog_start(void);
+
+// Queues a copy of r for the logger. Any thread, no allocation. Returns 0,
+// or -1 if it was dropped (pool full).
+int slowlog_submit(const struct slow_req *r);
+
+#endif
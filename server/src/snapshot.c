@@ -0,0 +1,270 @@
+// ============================================================================
+// KV snapshots: fork + sequential write, mmap load
+// ============================================================================
+#define _GNU_SOURCE
+#include "snapshot.h"
+#include "kv.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC "RAWSNAP1"
+#define SNAPSHOT_BUF (1u << 20)     // child's write size
+#define SNAPSHOT_TICK_SEC 1
+
+struct snap_header {
+    char magic[8];
+    uint64_t items;
+    uint64_t bytes;                 // record bytes after the header
+    uint64_t created;               // unix time
+};
+
+struct snap_record {
+    uint16_t klen, vlen;
+};
+
+static char path[CONFIG_PATH_LEN];
+static char tmp_path[CONFIG_PATH_LEN + 8];
+static pthread_mutex_t save_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct config_reader *rcu;
+
+static double ms_between(const struct timespec *a, const struct timespec *b) {
+    return (double)(b->tv_sec - a->tv_sec) * 1e3 + (double)(b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+// ============================================================================
+// Child side
+// ----------------------------------------------------------------------------
+// Runs in the forked child of a multi-threaded process: only the forking
+// thread exists there, and any lock another thread held at the fork (stdio,
+// malloc) stays held forever. So the child uses raw syscalls on memory the
+// parent prepared (the write buffer, the paths) and leaves with _exit().
+// ============================================================================
+struct snap_writer {
+    int fd;
+    char *buf;
+    size_t len;
+    uint64_t items, bytes;
+};
+
+static int write_all(int fd, const char *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int put_record(void *arg, const char *key, size_t klen, const char *val, size_t vlen) {
+    struct snap_writer *w = arg;
+    size_t need = sizeof(struct snap_record) + klen + vlen;
+    if (w->len + need > SNAPSHOT_BUF) {
+        if (write_all(w->fd, w->buf, w->len) < 0) return -1;
+        w->len = 0;
+    }
+    struct snap_record rec = {(uint16_t)klen, (uint16_t)vlen};
+    memcpy(w->buf + w->len, &rec, sizeof(rec));
+    memcpy(w->buf + w->len + sizeof(rec), key, klen);
+    memcpy(w->buf + w->len + sizeof(rec) + klen, val, vlen);
+    w->len += need;
+    w->items++;
+    w->bytes += need;
+    return 0;
+}
+
+static int child_write(char *buf, time_t created) {
+    struct snap_writer w = {.buf = buf, .len = sizeof(struct snap_header)};
+    w.fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (w.fd < 0) return 1;
+    if (kv_visit(put_record, &w) != 0 || write_all(w.fd, w.buf, w.len) < 0) return 2;
+
+    struct snap_header h = {.items = w.items, .bytes = w.bytes, .created = (uint64_t)created};
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    if (pwrite(w.fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) return 2;
+    if (fdatasync(w.fd) < 0) return 3;
+    close(w.fd);
+    if (rename(tmp_path, path) < 0) return 4;
+    return 0;
+}
+
+// ============================================================================
+// Parent side
+// ============================================================================
+int snapshot_save(char *msg, size_t msglen) {
+    if (path[0] == '\0' || !kv_enabled()) {
+        snprintf(msg, msglen, "snapshots off (set kv_max_mb and snapshot_path)");
+        return -1;
+    }
+    char *buf = malloc(SNAPSHOT_BUF);
+    if (!buf) {
+        snprintf(msg, msglen, "malloc: %s", strerror(errno));
+        return -1;
+    }
+
+    pthread_mutex_lock(&save_lock);
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    time_t created = time(NULL);
+    kv_freeze();
+    uint64_t items = kv_count();
+    pid_t pid = fork();
+    if (pid == 0) _exit(child_write(buf, created));
+    int fork_errno = errno;
+    kv_thaw();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    int status = 0, rc = -1;
+    if (pid < 0) {
+        snprintf(msg, msglen, "fork: %s", strerror(fork_errno));
+    } else {
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            // The directory entry from rename() must be durable as well.
+            char dir[CONFIG_PATH_LEN];
+            snprintf(dir, sizeof(dir), "%s", path);
+            int dfd = open(dirname(dir), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dfd >= 0) {
+                fsync(dfd);
+                close(dfd);
+            }
+            struct stat sb;
+            long long size = stat(path, &sb) == 0 ? (long long)sb.st_size : -1;
+            snprintf(msg, msglen, "%s: %" PRIu64 " items, %lld bytes, fork %.2f ms, total %.1f ms",
+                     path, items, size, ms_between(&t0, &t1), ms_between(&t0, &t2));
+            rc = 0;
+        } else {
+            static const char *const stage[] = {"", "open", "write", "fdatasync", "rename"};
+            int code = WIFEXITED(status) ? WEXITSTATUS(status) : 0;
+            snprintf(msg, msglen, "%s: child failed at %s", tmp_path,
+                     code > 0 && code < 5 ? stage[code] : "signal");
+            unlink(tmp_path);
+        }
+    }
+    pthread_mutex_unlock(&save_lock);
+    free(buf);
+    return rc;
+}
+
+static void *snapshot_main(void *arg) {
+    (void)arg;
+    pthread_setname_np(pthread_self(), "raw-snapshot");
+    struct timespec last;
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    for (;;) {
+        sleep(SNAPSHOT_TICK_SEC);
+        config_reader_online(rcu);
+        int interval = config_current()->snapshot_interval_s;
+        config_reader_offline(rcu);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (interval == 0 || ms_between(&last, &now) < interval * 1000.0) continue;
+        last = now;
+        char msg[CONFIG_PATH_LEN + 128];
+        if (snapshot_save(msg, sizeof(msg)) == 0) {
+            printf("💾  snapshot %s\n", msg);
+        } else {
+            fprintf(stderr, "⚠️  snapshot failed: %s\n", msg);
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Loading
+// ============================================================================
+static void load(void) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != ENOENT) fprintf(stderr, "⚠️  snapshot: %s: %s\n", path, strerror(errno));
+        else printf("💾  snapshot: no %s yet, starting cold\n", path);
+        return;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) < 0 || (size_t)sb.st_size < sizeof(struct snap_header)) {
+        fprintf(stderr, "⚠️  snapshot: %s is truncated; starting cold\n", path);
+        close(fd);
+        return;
+    }
+    size_t size = (size_t)sb.st_size;
+    const char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "⚠️  snapshot: mmap %s: %s\n", path, strerror(errno));
+        return;
+    }
+    madvise((void *)map, size, MADV_SEQUENTIAL);
+
+    struct snap_header h;
+    memcpy(&h, map, sizeof(h));
+    if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 ||
+        h.bytes != size - sizeof(h)) {
+        fprintf(stderr, "⚠️  snapshot: %s is not a complete raw snapshot; starting cold\n", path);
+        munmap((void *)map, size);
+        return;
+    }
+
+    uint64_t loaded = 0, dropped = 0;
+    const char *p = map + sizeof(h), *end = map + size;
+    for (uint64_t i = 0; i < h.items; i++) {
+        struct snap_record rec;
+        if ((size_t)(end - p) < sizeof(rec)) break;
+        memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+        if ((size_t)(end - p) < (size_t)rec.klen + rec.vlen) break;
+        if (kv_restore(p, rec.klen, p + rec.klen, rec.vlen) == 0) loaded++;
+        else dropped++;
+        p += rec.klen + rec.vlen;
+    }
+    munmap((void *)map, size);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    printf("💾  snapshot: loaded %" PRIu64 " items from %s in %.1f ms", loaded, path,
+           ms_between(&t0, &t1));
+    if (dropped) printf(" (%" PRIu64 " did not fit kv_max_mb)", dropped);
+    if (loaded + dropped < h.items) printf(" (image damaged after item %" PRIu64 ")", loaded + dropped);
+    printf("\n");
+}
+
+int snapshot_start(const struct raw_config *cfg) {
+    if (cfg->snapshot_path[0] == '\0') return 0;
+    if (!kv_enabled()) {
+        fprintf(stderr, "⚠️  snapshot_path is set but the KV store is off (kv_max_mb = 0)\n");
+        return 0;
+    }
+    snprintf(path, sizeof(path), "%s", cfg->snapshot_path);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    load();
+
+    rcu = config_reader_register();
+    config_reader_offline(rcu);
+    pthread_t tid;
+    int rc = pthread_create(&tid, NULL, snapshot_main, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "❌ snapshot: pthread_create: %s\n", strerror(rc));
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
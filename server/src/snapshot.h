@@ -0,0 +1,44 @@
+#ifndef RAW_SNAPSHOT_H
+#define RAW_SNAPSHOT_H
+
+// ============================================================================
+// KV snapshots
+// ----------------------------------------------------------------------------
+// With snapshot_path set (and the KV store on), the store is saved as one
+// compact binary image and loaded back at startup, so a restarted server
+// comes back warm instead of waiting for clients to refill it.
+//
+// Saving (admin SNAPSHOT, or every snapshot_interval_s):
+//
+//   kv_freeze() ─► fork() ─► kv_thaw()          parent: serving again
+//                     └─► child: walk the frozen copy-on-write image,
+//                         1 MiB write()s to <path>.tmp, fdatasync, rename
+//
+// The store only stops for fork() itself (copying page tables, ~1 ms per
+// GiB of RSS); pages the parent modifies afterwards are copied on write, so
+// the child sees the store exactly as it was at the fork.
+//
+// Loading: the image is mmap()ed read-only with MAP_POPULATE and walked in
+// place — no read() copies — inserting each item into the (still empty)
+// store. A missing file is a cold start; a damaged one is reported and
+// ignored.
+//
+// Image layout (host byte order; the file is not meant to move between
+// architectures):
+//
+//   header  { "RAWSNAP1", u64 items, u64 payload bytes, u64 unix time }
+//   records { u16 klen, u16 vlen, key, value } × items
+#include <stddef.h>
+
+#include "config.h"
+
+// Loads cfg->snapshot_path into the KV store (call after kv_start(), before
+// the workers) and starts the periodic snapshot thread. Returns 0, or -1 with
+// a message printed.
+int snapshot_start(const struct raw_config *cfg);
+
+// Takes a snapshot now and waits for it. Writes a one-line summary (or the
+// error) into 'msg'. Returns 0 or -1. Serialized: one snapshot at a time.
+int snapshot_save(char *msg, size_t msglen);
+
+#endif
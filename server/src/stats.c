@@ -0,0 +1,217 @@
+// ============================================================================
+// Server counters: storage, aggregation and text output
+// ============================================================================
+#include "stats.h"
+#include "config.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+struct padded_stats {
+    _Alignas(64) struct raw_stats s;
+};
+
+static struct padded_stats *per_worker;
+static int stats_n;
+
+// Previous STATS output, for rates. Only the admin thread dumps stats.
+static uint64_t prev_csw;
+static struct timespec prev_ts;
+
+void stats_init(int nworkers) {
+    per_worker = aligned_alloc(64, sizeof(*per_worker) * (size_t)nworkers);
+    if (!per_worker) {
+        perror("stats");
+        exit(EXIT_FAILURE);
+    }
+    memset(per_worker, 0, sizeof(*per_worker) * (size_t)nworkers);
+    stats_n = nworkers;
+    clock_gettime(CLOCK_MONOTONIC, &prev_ts);
+}
+
+struct raw_stats *stats_worker(int id) {
+    return &per_worker[id].s;
+}
+
+void stats_read(int id, struct raw_stats_snapshot *out) {
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < stats_n; i++) {
+        if (id >= 0 && i != id) continue;
+        const struct raw_stats *s = &per_worker[i].s;
+#define X(name, desc) out->name += atomic_load_explicit(&s->name, memory_order_relaxed);
+        RAW_STATS_COUNTERS(X)
+        RAW_STATS_GAUGES(X)
+#undef X
+#define X(name, desc)                                                          \
+    for (int b = 0; b < RAW_STATS_HIST_BUCKETS; b++)                           \
+        out->name[b] += atomic_load_explicit(&s->name[b], memory_order_relaxed);
+        RAW_STATS_HISTOGRAMS(X)
+#undef X
+    }
+}
+
+uint64_t stats_syscalls(const struct raw_stats_snapshot *s) {
+    return s->sys_recv + s->sys_send + s->sys_accept + s->sys_close +
+           s->sys_epoll_wait + s->sys_epoll_ctl + s->sys_uring_enter + s->sys_other;
+}
+
+// ============================================================================
+// Histograms
+// ============================================================================
+// Largest value bucket b can hold.
+static unsigned long long bucket_max(int b) {
+    return b == 0 ? 0 : (1ull << (b - 1)) * 2 - 1;
+}
+
+static unsigned long long hist_percentile(const uint64_t *h, uint64_t n, double p) {
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)n), seen = 0;
+    if (rank >= n) rank = n - 1;
+    for (int b = 0; b < RAW_STATS_HIST_BUCKETS; b++) {
+        seen += h[b];
+        if (seen > rank) return bucket_max(b);
+    }
+    return bucket_max(RAW_STATS_HIST_BUCKETS - 1);
+}
+
+static void hist_dump(FILE *out, const char *name, const char *desc, const uint64_t *h) {
+    uint64_t n = 0;
+    int top = 0;
+    for (int b = 0; b < RAW_STATS_HIST_BUCKETS; b++) {
+        n += h[b];
+        if (h[b]) top = b;
+    }
+    fprintf(out, "%s samples=%llu", name, (unsigned long long)n);
+    if (n > 0) {
+        fprintf(out, " p50<=%llu p90<=%llu p99<=%llu max<=%llu", hist_percentile(h, n, 50),
+                hist_percentile(h, n, 90), hist_percentile(h, n, 99), bucket_max(top));
+    }
+    fprintf(out, "   # %s\n", desc);
+    for (int b = 0; b < RAW_STATS_HIST_BUCKETS; b++) {
+        if (h[b]) fprintf(out, "  <=%llu %llu\n", bucket_max(b), (unsigned long long)h[b]);
+    }
+}
+
+void stats_hist_dump(FILE *out) {
+    struct raw_stats_snapshot s;
+    stats_read(-1, &s);
+    fprintf(out, "tcp_info_samples %llu\n", (unsigned long long)s.tcp_info_samples);
+    fprintf(out, "accept_queue_full %llu\n", (unsigned long long)s.accept_queue_full);
+#define X(name, desc) hist_dump(out, #name, desc, s.name);
+    RAW_STATS_HISTOGRAMS(X)
+#undef X
+}
+
+// ============================================================================
+// TIME_WAIT census
+// ----------------------------------------------------------------------------
+// /proc/net/tcp lines look like
+//   "  12: 0100007F:2328 0100007F:D43A 06 00000000:00000000 ..."
+// with hex ports and the TCP state in the 4th column (06 = TIME_WAIT).
+// Reading them is O(sockets on the host), so this only runs on demand.
+// ============================================================================
+static int is_listen_port(const struct raw_config *cfg, unsigned port) {
+    for (int i = 0; i < cfg->nlisten; i++) {
+        if ((unsigned)cfg->listen[i].port == port) return 1;
+    }
+    return 0;
+}
+
+static void scan_proc(const char *path, const struct raw_config *cfg,
+                      uint64_t *server_side, uint64_t *peer_side) {
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+    char line[512];
+    if (!fgets(line, sizeof(line), f)) {            // header
+        fclose(f);
+        return;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char local[64], remote[64];
+        unsigned state;
+        if (sscanf(line, "%*s %63s %63s %x", local, remote, &state) != 3) continue;
+        if (state != 0x06) continue;
+        const char *lp = strrchr(local, ':'), *rp = strrchr(remote, ':');
+        if (!lp || !rp) continue;
+        if (is_listen_port(cfg, (unsigned)strtoul(lp + 1, NULL, 16))) (*server_side)++;
+        if (is_listen_port(cfg, (unsigned)strtoul(rp + 1, NULL, 16))) (*peer_side)++;
+    }
+    fclose(f);
+}
+
+void stats_count_timewait(const struct raw_config *cfg, uint64_t *server_side,
+                          uint64_t *peer_side) {
+    *server_side = *peer_side = 0;
+    scan_proc("/proc/net/tcp", cfg, server_side, peer_side);
+    scan_proc("/proc/net/tcp6", cfg, server_side, peer_side);
+}
+
+// ============================================================================
+// Process resources (for leak tracking: a soak run watches these drift)
+// ============================================================================
+static unsigned long long read_rss_kb(void) {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f) return 0;
+    char line[256];
+    unsigned long long kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmRSS: %llu kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+}
+
+static unsigned long long count_open_fds(void) {
+    DIR *d = opendir("/proc/self/fd");
+    if (!d) return 0;
+    unsigned long long n = 0;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        if (e->d_name[0] != '.') n++;
+    }
+    closedir(d);
+    return n - 1;                                   // the opendir() fd itself
+}
+
+static unsigned long long tv_ms(const struct timeval *tv) {
+    return (unsigned long long)tv->tv_sec * 1000 + (unsigned long long)tv->tv_usec / 1000;
+}
+
+void stats_dump(FILE *out, const struct raw_config *cfg) {
+    struct raw_stats_snapshot s;
+    stats_read(-1, &s);
+#define X(name, desc) fprintf(out, "%s %llu\n", #name, (unsigned long long)s.name);
+    RAW_STATS_COUNTERS(X)
+    RAW_STATS_GAUGES(X)
+#undef X
+
+    uint64_t tw_server, tw_peer;
+    stats_count_timewait(cfg, &tw_server, &tw_peer);
+    fprintf(out, "timewait_server %llu\n", (unsigned long long)tw_server);
+    fprintf(out, "timewait_peer %llu\n", (unsigned long long)tw_peer);
+    fprintf(out, "rss_kb %llu\n", read_rss_kb());
+    fprintf(out, "open_fds %llu\n", count_open_fds());
+
+    // Process CPU time, so a client can compute messages per CPU-second.
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    fprintf(out, "cpu_user_ms %llu\n", tv_ms(&ru.ru_utime));
+    fprintf(out, "cpu_sys_ms %llu\n", tv_ms(&ru.ru_stime));
+
+    // Derived ratios. Context switch counts come from each worker's last
+    // sweep (every 250 ms); the rate is over the time since the previous
+    // STATS (or startup).
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t csw = s.ctx_voluntary + s.ctx_involuntary;
+    double secs = (double)(ts.tv_sec - prev_ts.tv_sec) +
+                  (double)(ts.tv_nsec - prev_ts.tv_nsec) / 1e9;
+    fprintf(out, "syscalls_per_msg %.2f\n",
+            s.msgs ? (double)stats_syscalls(&s) / (double)s.msgs : 0.0);
+    fprintf(out, "ctx_switches_per_sec %.1f\n",
+            secs > 0 ? (double)(csw - prev_csw) / secs : 0.0);
+    prev_csw = csw;
+    prev_ts = ts;
+}
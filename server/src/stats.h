@@ -0,0 +1,152 @@
+#ifndef RAW_STATS_H
+#define RAW_STATS_H
+
+// ============================================================================
+// Server counters
+// ----------------------------------------------------------------------------
+// One struct raw_stats per worker, each on its own cache lines, written only
+// by the owning worker. Writes are relaxed load+store pairs (no lock prefix):
+// a single writer needs no read-modify-write atomicity, and readers on other
+// threads (the admin port) only need untorn 64-bit values, not a consistent
+// cross-counter snapshot.
+//
+// The counter list is an X-macro so that the struct, the admin STATS output
+// and any other exporter are generated from the same table.
+//
+// Histograms use the same single-writer scheme with log2 buckets: bucket 0
+// holds 0 and bucket b holds [2^(b-1), 2^b), so a percentile read back is an
+// upper bound within a factor of two. That is coarse, but enough to tell a
+// 200 µs loopback RTT from a 40 ms WAN one, and it costs one clz per sample.
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define RAW_STATS_COUNTERS(X)                                                  \
+    X(accepted, "connections accepted")                                        \
+    X(refused, "connections refused (rate limiter, blocking thread limit)")    \
+    X(msgs, "requests answered")                                               \
+    X(too_long, "requests rejected as too long")                               \
+    X(bad_utf8, "requests rejected as malformed UTF-8 (text_mode = utf8)")     \
+    X(deadline_reqs, "requests that carried a deadline (deadlines = 1)")       \
+    X(deadline_expired, "requests dropped with ERR deadline, already expired") \
+    X(half_close, "peers that shut down writing before their last reply")      \
+    X(close_active, "server sent FIN first (TIME_WAIT stays on the server)")   \
+    X(close_passive, "client sent FIN first (TIME_WAIT moves to the client)")  \
+    X(close_abort, "closed with RST via SO_LINGER 0 (no TIME_WAIT)")           \
+    X(close_wait_timeout, "client-first close: client never closed")           \
+    X(migrated_in, "connections received from another worker")                 \
+    X(migrated_out, "connections handed to another worker")                    \
+    X(inbox_msgs, "messages received from other workers (inbox rings)")        \
+    X(inbox_wakeups, "eventfd writes sent to wake an idle worker's inbox")     \
+    X(inbox_full, "messages not sent: the target worker's inbox was full")     \
+    X(slow_requests, "requests over slow_request_us (logged)")                 \
+    X(slow_dropped, "slow requests not logged: the logger's pool was full")    \
+    X(pool_malloc, "conns allocated fresh because the pool was empty")         \
+    X(arena_spills, "scratch allocations too big for the arena (malloc'd)")    \
+    X(uring_sqes, "operations submitted to io_uring (io_backend = uring)")     \
+    X(sys_recv, "recv() calls")                                                \
+    X(sys_send, "send() calls")                                                \
+    X(sys_accept, "accept4() calls")                                           \
+    X(sys_close, "close() calls")                                              \
+    X(sys_epoll_wait, "epoll_wait() calls")                                    \
+    X(sys_epoll_ctl, "epoll_ctl() calls")                                      \
+    X(sys_uring_enter, "io_uring_enter() calls (io_backend = uring)")          \
+    X(sys_other, "setsockopt/ioctl/eventfd/getrusage calls")                   \
+    X(sys_eagain, "of the above, calls that returned EAGAIN (no work done)")   \
+    X(kv_gets, "KV GET commands")                                              \
+    X(kv_hits, "KV GETs that found their key")                                 \
+    X(kv_sets, "KV SET commands")                                              \
+    X(kv_dels, "KV DEL commands")                                              \
+    X(kv_evictions, "KV items evicted by CLOCK to stay within kv_max_mb")      \
+    X(fwd_out, "KV commands forwarded to the owning cluster member")           \
+    X(fwd_in, "KV commands answered for another cluster member")               \
+    X(fwd_errors, "forwarded commands answered ERR peer unavailable")          \
+    X(peer_connects, "links opened to other cluster members")                  \
+    X(tcp_info_samples, "TCP_INFO reads on connections and listeners")         \
+    X(accept_queue_full, "listener samples that found the accept queue full")
+
+#define RAW_STATS_GAUGES(X)                                                    \
+    X(conns, "connections currently owned")                                    \
+    X(pool_free, "recycled conns waiting on free lists")                       \
+    X(ctx_voluntary, "worker threads' voluntary context switches")             \
+    X(ctx_involuntary, "worker threads' involuntary context switches (preempted)")
+
+// Fed by the TCP_INFO sampler (worker.c, tcp_info_ms).
+#define RAW_STATS_HISTOGRAMS(X)                                                \
+    X(tcp_rtt_us, "smoothed RTT of sampled connections, µs")                   \
+    X(tcp_rttvar_us, "RTT mean deviation of sampled connections, µs")          \
+    X(tcp_retrans, "segments retransmitted since the previous sample")         \
+    X(tcp_unacked, "segments sent and not yet acknowledged")                   \
+    X(tcp_cwnd, "congestion window, segments")                                 \
+    X(tcp_zero_window, "zero-window probes sent (the peer stopped reading)")   \
+    X(accept_backlog, "listener accept queue depth, connections")
+
+#define RAW_STATS_HIST_BUCKETS 33
+
+struct raw_config;
+
+struct raw_stats {
+#define X(name, desc) _Atomic uint64_t name;
+    RAW_STATS_COUNTERS(X)
+    RAW_STATS_GAUGES(X)
+#undef X
+#define X(name, desc) _Atomic uint64_t name[RAW_STATS_HIST_BUCKETS];
+    RAW_STATS_HISTOGRAMS(X)
+#undef X
+};
+
+struct raw_stats_snapshot {
+#define X(name, desc) uint64_t name;
+    RAW_STATS_COUNTERS(X)
+    RAW_STATS_GAUGES(X)
+#undef X
+#define X(name, desc) uint64_t name[RAW_STATS_HIST_BUCKETS];
+    RAW_STATS_HISTOGRAMS(X)
+#undef X
+};
+
+#define STAT_ADD(st, field, n)                                                 \
+    atomic_store_explicit(&(st)->field,                                        \
+                          atomic_load_explicit(&(st)->field,                   \
+                                               memory_order_relaxed) + (n),    \
+                          memory_order_relaxed)
+#define STAT_SET(st, field, v)                                                 \
+    atomic_store_explicit(&(st)->field, (v), memory_order_relaxed)
+#define STAT_INC(st, field) STAT_ADD(st, field, 1)
+#define STAT_DEC(st, field) STAT_ADD(st, field, (uint64_t)-1)
+#define STAT_HIST(st, field, v) STAT_INC(st, field[stats_hist_bucket(v)])
+
+static inline int stats_hist_bucket(uint64_t v) {
+    int b = v ? 64 - __builtin_clzll(v) : 0;
+    return b < RAW_STATS_HIST_BUCKETS ? b : RAW_STATS_HIST_BUCKETS - 1;
+}
+
+// Sizes the per-worker table; call once before the workers start.
+void stats_init(int nworkers);
+
+// The calling worker's counters.
+struct raw_stats *stats_worker(int id);
+
+// Reads one worker's counters (id >= 0) or the sum over all workers (id < 0).
+void stats_read(int id, struct raw_stats_snapshot *out);
+
+// Sum of the sys_* counters except sys_eagain (which overlaps the others).
+uint64_t stats_syscalls(const struct raw_stats_snapshot *s);
+
+// Counts sockets in TIME_WAIT on this host whose local port (server side) or
+// remote port (peer side, e.g. a load generator on the same machine) is one of
+// the listen ports of 'cfg', from /proc/net/tcp and /proc/net/tcp6.
+void stats_count_timewait(const struct raw_config *cfg, uint64_t *server_side,
+                          uint64_t *peer_side);
+
+// "name value" lines for the admin STATS command, followed by process-wide
+// values read on demand (TIME_WAIT census, rss_kb, open_fds, CPU time) and
+// derived ratios: syscalls_per_msg, and ctx_switches_per_sec since the
+// previous call. 'cfg' gives the listen ports for the TIME_WAIT census.
+void stats_dump(FILE *out, const struct raw_config *cfg);
+
+// Admin TCPINFO: per histogram, the sample count and p50/p90/p99/max as
+// bucket upper bounds, followed by the non-empty buckets.
+void stats_hist_dump(FILE *out);
+
+#endif
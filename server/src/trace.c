@@ -0,0 +1,106 @@
+// ============================================================================
+// Request tracing: per-worker span rings and the Chrome trace exporter
+// ----------------------------------------------------------------------------
+// A ring is written by its worker only and read by the admin thread. The
+// reader copies the ring without stopping the writer, then re-reads 'head':
+// any slot the writer may have reused meanwhile (anything older than the new
+// head minus the ring size) is dropped, so torn records are never exported.
+// ============================================================================
+#define _GNU_SOURCE
+#include "trace.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TRACE_MAX_BUFS 256
+
+struct trace_span {
+    uint64_t start_ns, dur_ns;
+    uint64_t conn;
+    uint32_t arg;
+    uint32_t kind;                  // enum trace_kind
+};
+
+static struct trace_buf *bufs[TRACE_MAX_BUFS];
+static _Atomic int nbufs;
+
+static const char *const kind_names[] = {"accept", "read", "frame", "process", "write",
+                                         "close"};
+static const char *const arg_names[] = {"fd", "bytes", "len", "len", "bytes", "fd"};
+
+int trace_buf_init(struct trace_buf *b, int tid, const char *name) {
+    int i = atomic_load_explicit(&nbufs, memory_order_relaxed);
+    if (i == TRACE_MAX_BUFS) return -1;
+    b->spans = malloc(TRACE_SPANS * sizeof(struct trace_span));
+    if (!b->spans) return -1;
+    atomic_init(&b->head, 0);
+    b->tid = tid;
+    snprintf(b->name, sizeof(b->name), "%s", name);
+    bufs[i] = b;
+    atomic_store_explicit(&nbufs, i + 1, memory_order_release);
+    return 0;
+}
+
+void trace_span(struct trace_buf *b, enum trace_kind kind, uint64_t conn, uint64_t start,
+                uint64_t arg) {
+    uint64_t h = atomic_load_explicit(&b->head, memory_order_relaxed);
+    struct trace_span *s = &b->spans[h & (TRACE_SPANS - 1)];
+    s->start_ns = start;
+    s->dur_ns = trace_now() - start;
+    s->conn = conn;
+    s->arg = arg > UINT32_MAX ? UINT32_MAX : (uint32_t)arg;
+    s->kind = kind;
+    atomic_store_explicit(&b->head, h + 1, memory_order_release);
+}
+
+// Copies b's live spans into 'copy'; returns the index range [*first, last).
+static uint64_t snapshot(struct trace_buf *b, struct trace_span *copy, uint64_t *first) {
+    uint64_t last = atomic_load_explicit(&b->head, memory_order_acquire);
+    uint64_t lo = last > TRACE_SPANS ? last - TRACE_SPANS : 0;
+    for (uint64_t i = lo; i < last; i++) {
+        copy[i & (TRACE_SPANS - 1)] = b->spans[i & (TRACE_SPANS - 1)];
+    }
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t now = atomic_load_explicit(&b->head, memory_order_relaxed);
+    // Slots the writer has started to reuse since: up to now - TRACE_SPANS,
+    // plus the one it may be filling.
+    if (now + 1 > TRACE_SPANS && now + 1 - TRACE_SPANS > lo) lo = now + 1 - TRACE_SPANS;
+    *first = lo < last ? lo : last;
+    return last;
+}
+
+uint64_t trace_export(FILE *out) {
+    struct trace_span *copy = malloc(TRACE_SPANS * sizeof(*copy));
+    if (!copy) return 0;
+    int pid = (int)getpid(), n = atomic_load_explicit(&nbufs, memory_order_acquire);
+    uint64_t written = 0;
+    const char *sep = "";
+
+    // Timestamps are CLOCK_MONOTONIC in microseconds, the format's unit.
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (int i = 0; i < n; i++) {
+        struct trace_buf *b = bufs[i];
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                     "\"args\":{\"name\":\"%s\"}}",
+                sep, pid, b->tid, b->name);
+        sep = ",\n";
+
+        uint64_t first, last = snapshot(b, copy, &first);
+        for (uint64_t j = first; j < last; j++) {
+            const struct trace_span *s = &copy[j & (TRACE_SPANS - 1)];
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"conn\",\"ph\":\"X\",\"pid\":%d,"
+                         "\"tid\":%d,\"ts\":%llu.%03u,\"dur\":%llu.%03u,"
+                         "\"args\":{\"conn\":%llu,\"%s\":%u}}",
+                    kind_names[s->kind], pid, b->tid,
+                    (unsigned long long)(s->start_ns / 1000), (unsigned)(s->start_ns % 1000),
+                    (unsigned long long)(s->dur_ns / 1000), (unsigned)(s->dur_ns % 1000),
+                    (unsigned long long)s->conn, arg_names[s->kind], s->arg);
+            written++;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    free(copy);
+    return written;
+}
@@ -0,0 +1,60 @@
+#ifndef RAW_TRACE_H
+#define RAW_TRACE_H
+
+// ============================================================================
+// Request tracing: sampled spans, exported as a Chrome trace
+// ----------------------------------------------------------------------------
+// With trace_sample = N, one connection in N is traced from accept to close.
+// Every step the worker takes for it becomes a span with CLOCK_MONOTONIC
+// start and duration:
+//
+//   accept    accept4() through epoll registration (fd)
+//   read      one recv() (bytes received; 0 = FIN)
+//   frame     finding the next request in the input buffer (its length)
+//   process   answering it: echo, KV, forward, error (its length)
+//   write     one send() (bytes sent)
+//   close     close() of the socket (fd)
+//
+// Each worker appends to its own ring of TRACE_SPANS records (no locks, no
+// shared cache lines); the oldest spans are overwritten. Admin TRACE
+// exports what the rings hold as Chrome trace JSON, one timeline row per
+// worker thread, for chrome://tracing or ui.perfetto.dev. Untraced
+// connections pay one branch per step.
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define TRACE_SPANS 65536           // per worker, power of two (2 MiB)
+
+enum trace_kind { TRACE_ACCEPT, TRACE_READ, TRACE_FRAME, TRACE_PROCESS, TRACE_WRITE,
+                  TRACE_CLOSE };
+
+struct trace_span;
+
+struct trace_buf {
+    struct trace_span *spans;
+    _Atomic uint64_t head;          // spans ever written; the writer's only
+    char name[16];                  // timeline row label (thread name)
+    int tid;
+};
+
+// Allocates b's ring and makes it visible to trace_export(). Startup only.
+// Returns 0, or -1 with errno set.
+int trace_buf_init(struct trace_buf *b, int tid, const char *name);
+
+static inline uint64_t trace_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+// Records a span of 'kind' for connection 'conn' from 'start' (trace_now())
+// until now. Only b's owning thread may call it.
+void trace_span(struct trace_buf *b, enum trace_kind kind, uint64_t conn, uint64_t start,
+                uint64_t arg);
+
+// Writes every span currently held, oldest first per worker, as a Chrome
+// trace JSON object. Returns the number of spans written.
+uint64_t trace_export(FILE *out);
+
+#endif
@@ -0,0 +1,256 @@
+// ============================================================================
+// UTF-8 validation and code point counting: scalar and AVX2 kernels
+// ============================================================================
+#define _GNU_SOURCE
+#include "utf8.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_HAVE_AVX2 1
+#endif
+
+// ============================================================================
+// Scalar
+// ============================================================================
+int utf8_count_scalar(const char *str, size_t len, size_t *cps) {
+    const unsigned char *s = (const unsigned char *)str;
+    size_t i = 0, n = 0;
+    while (i < len) {
+        if (len - i >= 8) {
+            uint64_t v;
+            memcpy(&v, s + i, sizeof(v));
+            if ((v & 0x8080808080808080ull) == 0) {
+                i += 8;
+                n += 8;
+                continue;
+            }
+        }
+        unsigned c = s[i];
+        if (c < 0x80) {
+            i++;
+            n++;
+            continue;
+        }
+        // Lead byte: number of continuation bytes, and the legal range of
+        // the first one (narrower after E0/ED/F0/F4: overlongs, surrogates,
+        // > U+10FFFF).
+        size_t need;
+        unsigned lo = 0x80, hi = 0xbf;
+        if (c >= 0xc2 && c <= 0xdf) {
+            need = 1;
+        } else if (c >= 0xe0 && c <= 0xef) {
+            need = 2;
+            if (c == 0xe0) lo = 0xa0;
+            if (c == 0xed) hi = 0x9f;
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            need = 3;
+            if (c == 0xf0) lo = 0x90;
+            if (c == 0xf4) hi = 0x8f;
+        } else {
+            return -1;
+        }
+        if (len - i <= need || s[i + 1] < lo || s[i + 1] > hi) return -1;
+        for (size_t k = 2; k <= need; k++) {
+            if ((s[i + k] & 0xc0) != 0x80) return -1;
+        }
+        i += need + 1;
+        n++;
+    }
+    *cps = n;
+    return 0;
+}
+
+// ============================================================================
+// AVX2
+// ----------------------------------------------------------------------------
+// Error classes for the nibble tables: a byte pair is illegal when all three
+// lookups agree on at least one class.
+// ============================================================================
+#ifdef UTF8_HAVE_AVX2
+enum {
+    TOO_SHORT = 1 << 0,             // lead byte not followed by a continuation
+    TOO_LONG = 1 << 1,              // continuation after ASCII
+    OVERLONG_3 = 1 << 2,
+    TOO_LARGE = 1 << 3,             // > U+10FFFF
+    SURROGATE = 1 << 4,
+    OVERLONG_2 = 1 << 5,
+    TOO_LARGE_1000 = 1 << 6,
+    OVERLONG_4 = 1 << 6,
+    TWO_CONTS = 1 << 7,             // continuation after continuation (ok if
+                                    // a 3/4-byte sequence needs it, see below)
+    CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS,
+};
+
+// Indexed by the high nibble of the previous byte.
+static const uint8_t byte1_high[16] = {
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    TOO_SHORT | OVERLONG_2,
+    TOO_SHORT,
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+};
+
+// Indexed by the low nibble of the previous byte.
+static const uint8_t byte1_low[16] = {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    CARRY | OVERLONG_2,
+    CARRY,
+    CARRY,
+    CARRY | TOO_LARGE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+};
+
+// Indexed by the high nibble of the current byte.
+static const uint8_t byte2_high[16] = {
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+};
+
+// The last 0–3 bytes of a block that start a sequence the block cannot hold.
+static const uint8_t incomplete_max[32] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    0xf0 - 1, 0xe0 - 1, 0xc0 - 1,
+};
+
+// keep_mask + 32 - n: n bytes of 0xff, then zeros.
+static const uint8_t keep_mask[64] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+};
+
+struct avx2_state {
+    __m256i prev, error, incomplete;
+    size_t count;
+};
+
+__attribute__((target("avx2,popcnt")))
+static inline __m256i prev_n(__m256i in, __m256i prev, int n) {
+    __m256i cross = _mm256_permute2x128_si256(prev, in, 0x21);
+    switch (n) {
+    case 1: return _mm256_alignr_epi8(in, cross, 15);
+    case 2: return _mm256_alignr_epi8(in, cross, 14);
+    default: return _mm256_alignr_epi8(in, cross, 13);
+    }
+}
+
+__attribute__((target("avx2,popcnt")))
+static inline __m256i table(const uint8_t t[16]) {
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)t));
+}
+
+__attribute__((target("avx2,popcnt")))
+static inline void avx2_block(struct avx2_state *st, __m256i in) {
+    // Not a continuation byte (0x80..0xbf is -128..-65 signed): one per code
+    // point.
+    __m256i starts = _mm256_cmpgt_epi8(in, _mm256_set1_epi8(-65));
+    st->count += (size_t)__builtin_popcount((unsigned)_mm256_movemask_epi8(starts));
+
+    if (_mm256_movemask_epi8(in) == 0) {
+        // All ASCII: legal unless the previous block left a sequence open.
+        st->error = _mm256_or_si256(st->error, st->incomplete);
+        st->prev = in;
+        st->incomplete = _mm256_setzero_si256();
+        return;
+    }
+
+    const __m256i nib = _mm256_set1_epi8(0x0f);
+    __m256i prev1 = prev_n(in, st->prev, 1);
+    __m256i b1h = _mm256_shuffle_epi8(table(byte1_high),
+                                      _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nib));
+    __m256i b1l = _mm256_shuffle_epi8(table(byte1_low), _mm256_and_si256(prev1, nib));
+    __m256i b2h = _mm256_shuffle_epi8(table(byte2_high),
+                                      _mm256_and_si256(_mm256_srli_epi16(in, 4), nib));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(b1h, b1l), b2h);
+
+    // Third and fourth bytes: a continuation after a continuation is legal
+    // exactly where a 3-byte lead sits two back or a 4-byte lead three back.
+    __m256i third = _mm256_subs_epu8(prev_n(in, st->prev, 2), _mm256_set1_epi8((char)(0xe0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(prev_n(in, st->prev, 3), _mm256_set1_epi8((char)(0xf0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+
+    st->error = _mm256_or_si256(st->error, _mm256_xor_si256(must23, special));
+    st->incomplete = _mm256_subs_epu8(in, _mm256_loadu_si256((const __m256i *)incomplete_max));
+    st->prev = in;
+}
+
+__attribute__((target("avx2,popcnt")))
+static int count_avx2(const char *s, size_t len, size_t *cps) {
+    struct avx2_state st = {_mm256_setzero_si256(), _mm256_setzero_si256(),
+                            _mm256_setzero_si256(), 0};
+    size_t i = 0;
+    for (; len - i >= 32; i += 32) {
+        avx2_block(&st, _mm256_loadu_si256((const __m256i *)(s + i)));
+    }
+    size_t rem = len - i;
+    if (rem == 0) {
+        // Nothing left to read, but the last block may have opened a
+        // sequence it could not finish.
+        st.error = _mm256_or_si256(st.error, st.incomplete);
+    } else {
+        // The tail goes through one block with zeros (ASCII) past the end:
+        // a sequence the input leaves open then fails the same checks as any
+        // other truncation, and the padding's code points are taken off.
+        // When the 32 bytes stay inside the page they are loaded in place
+        // and masked, the same over-read glibc's memchr() relies on, which
+        // avoids a stack copy and its store-forwarding stall on every short
+        // line. Otherwise they are copied out first.
+        __m256i tail;
+        if (((uintptr_t)(s + i) & 4095) <= 4096 - 32) {
+            tail = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(s + i)),
+                                    _mm256_loadu_si256((const __m256i *)(keep_mask + 32 - rem)));
+        } else {
+            char buf[32] = {0};
+            memcpy(buf, s + i, rem);
+            tail = _mm256_loadu_si256((const __m256i *)buf);
+        }
+        avx2_block(&st, tail);
+        st.count -= 32 - rem;
+    }
+    if (!_mm256_testz_si256(st.error, st.error)) return -1;
+    *cps = st.count;
+    return 0;
+}
+#endif
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+static int (*count_impl)(const char *, size_t, size_t *) = utf8_count_scalar;
+static const char *impl_name = "scalar";
+
+void utf8_init(void) {
+#ifdef UTF8_HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        count_impl = count_avx2;
+        impl_name = "avx2";
+    }
+#endif
+}
+
+const char *utf8_impl(void) {
+    return impl_name;
+}
+
+int utf8_count(const char *s, size_t len, size_t *cps) {
+    return count_impl(s, len, cps);
+}
@@ -0,0 +1,44 @@
+#ifndef RAW_UTF8_H
+#define RAW_UTF8_H
+
+// ============================================================================
+// UTF-8 validation and code point counting
+// ----------------------------------------------------------------------------
+// With text_mode = utf8, max_msg_len counts code points instead of bytes, so
+// "hello cloud ☁️" is 13 characters rather than 18 bytes, and a line that is
+// not well-formed UTF-8 (stray continuation bytes, overlong forms, surrogates,
+// code points past U+10FFFF, a sequence cut off by the newline) is rejected
+// with "ERR invalid utf-8" instead of being echoed.
+//
+// Validation runs over every request during framing, so it has to cost about
+// what the memchr() for the newline already costs. Two implementations, picked
+// once at startup from the CPU (utf8_init):
+//
+//   avx2    32 bytes per step. An all-ASCII block costs one movemask. Other
+//           blocks use the Keiser–Lemire lookup algorithm (as in simdjson /
+//           simdutf): three 16-entry pshufb tables, indexed by the high and
+//           low nibble of the previous byte and the high nibble of the
+//           current one, AND together to a non-zero byte exactly where a
+//           two-byte pattern is illegal; a saturating-subtract check covers
+//           the third and fourth bytes of longer sequences. Code points are
+//           the bytes that are not continuations (signed compare > -65),
+//           popcounted from a movemask. No branches per byte.
+//   scalar  8-byte ASCII skip, then a per-sequence check with the exact
+//           second-byte ranges from RFC 3629. Used when AVX2 is missing (or
+//           on other architectures) and as the reference in the benchmark.
+#include <stddef.h>
+
+// Picks the implementation for this CPU. Call once before any utf8_count().
+void utf8_init(void);
+
+// "avx2" or "scalar".
+const char *utf8_impl(void);
+
+// Validates s[0, len) and stores its code point count. Returns 0, or -1 when
+// it is not well-formed UTF-8 (*cps is then unspecified).
+int utf8_count(const char *s, size_t len, size_t *cps);
+
+// The scalar implementation, whatever utf8_init() picked (benchmarks).
+int utf8_count_scalar(const char *s, size_t len, size_t *cps);
+
+#endif
@@ -0,0 +1,1702 @@
+// ============================================================================
+// Worker event loops
+// ----------------------------------------------------------------------------
+// Life of a connection:
+//   accept4() ──► conn_alloc() ──► [EPOLLIN] read_input() ──► process_input()
+//        ──► replies appended to c->out ──► flush_output() ──► conn_close()
+//
+// Everything a connection needs is inside struct conn, which is what makes
+// migration cheap: the donor worker removes the fd from its epoll set and
+// posts the struct to the target's inbox (mpsc.h); the target adds the fd to
+// its own epoll set and carries on exactly where the donor stopped.
+#define _GNU_SOURCE
+#include "worker.h"
+#include "arena.h"
+#include "cluster.h"
+#include "flight.h"
+#include "framer.h"
+#include "io.h"
+#include "journal.h"
+#include "kv.h"
+#include "mpsc.h"
+#include "slowlog.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/sockios.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CONN_IN_BUF 16384           // >= MSG_LEN_CAP + room for pipelined lines
+#define CONN_OUT_BUF 16384
+#define ACCEPT_BATCH 64
+#define ACCEPT_BATCH_SHARED 4       // accept_mode=exclusive: leave some for others
+#define MAX_EVENTS 256
+#define SWEEP_MS 250                // idle-timeout sweep period
+#define JOURNAL_HOLDS 32            // replies awaiting durability, per conn
+#define LINK_BUF 65536              // per cluster link, each direction
+#define LINK_DEPTH 1024             // forwarded requests in flight per link
+#define LINK_RETRY_MS 1000          // after a link fails, answer ERR this long
+#define INBOX_SLOTS 1024            // cross-worker messages in flight, per worker
+
+// epoll user data for non-connection fds; connections store their pointer.
+#define TAG_LISTENER 1u
+#define TAG_WAKE 2u
+#define TAG_PEER 3u                 // cluster link; member index in the high half
+
+struct conn {
+    struct conn *next, *prev;       // owner's list of live connections
+    int fd;
+    uint64_t id;
+    uint32_t events;                // current epoll interest mask
+    int traced;                     // sampled by trace_sample (trace.h)
+    struct sockaddr_in peer;        // client address (slow log)
+
+    int discarding;                 // inside an overlong line: drop to '\n'
+    int closing;                    // no more requests; close once flushed
+    int eof;                        // peer sent FIN
+    int awaiting_fin;               // close_mode=client: replies sent, waiting
+    struct timespec last_active;    // last input, or when awaiting_fin began
+
+    // Activity in the current and previous sweep windows; the donor uses it
+    // to pick which connections to give away during a rebalance.
+    uint32_t msgs_cur, msgs_prev;
+    uint32_t retrans_seen;          // tcpi_total_retrans at the last TCP_INFO sample
+
+    // Journal gating (journal_dir set): replies to journaled messages may only
+    // be sent once the journal is durable up to that message. out[0, out_ready)
+    // is releasable; each hold covers out up to 'end' and waits for 'lsn'.
+    // Holds are in LSN order, so they are released front to back.
+    struct conn *held_next, *held_prev;     // worker's held list, if 'held'
+    int held;
+    int journal_blocked;            // staging was full: retry after a commit
+    unsigned nholds;
+    struct { uint64_t lsn; unsigned end; } holds[JOURNAL_HOLDS];
+
+    // Cluster mode: while a request is out at its owner (link fwd_peer, ring
+    // slot fwd_slot), no further request on this conn is framed, so relayed
+    // and local replies leave in request order.
+    int forwarding;
+    int fwd_peer;
+    unsigned fwd_slot;
+    int peer_conn;                  // opened with "PEER": answer locally, keep open
+
+    // Deadlines (deadlines = 1): budgets count from when a request's bytes
+    // were read. in_at covers the oldest bytes in c->in, in_last the newest.
+    // edf_pos is 1 + the conn's index in the worker's EDF heap, 0 if not
+    // queued; edf_key is the deadline of the request at the head of c->in.
+    struct timespec in_at, in_last;
+    unsigned edf_pos;
+    uint64_t edf_key, edf_seq;
+
+    // Slow log (slow_request_us > 0): recv time not yet charged to a
+    // request, and the oldest request whose reply is not sent yet, open while
+    // slow_end > 0 (its reply ends at out[slow_end]).
+    uint64_t read_ns;
+    unsigned slow_end;
+    uint64_t slow_arrival, slow_ready;
+    struct slow_req slow;
+
+    unsigned in_len;
+    unsigned out_off, out_len, out_ready;
+    char in[CONN_IN_BUF];
+    char out[CONN_OUT_BUF];
+};
+
+// One per worker per cluster member: a persistent, pipelined connection to
+// that member's echo port. Requests go out in order and the member answers
+// them in order, so a ring of waiting conns is all the matching needed.
+struct peer_link {
+    int fd;                         // -1: down
+    int connecting;
+    struct timespec down_since;     // last failure: fail fast for LINK_RETRY_MS
+    struct { struct conn *c; uint64_t lsn; } waiting[LINK_DEPTH];
+    unsigned head, tail;
+    unsigned in_len, out_off, out_len;
+    char in[LINK_BUF];
+    char out[LINK_BUF];
+};
+
+struct worker {
+    int id;
+    int epfd;
+    int wake_fd;                    // eventfd: inbox, rebalance requests, journal
+    int fds[CONFIG_MAX_LISTEN];
+    int nfds;
+    pthread_t thread;
+    struct config_reader *rcu;
+
+    struct conn head;               // sentinel of the owned-connection list
+    struct conn held;               // sentinel: conns waiting on the journal
+    uint64_t durable_seen;          // journal LSN last acted on
+    struct conn *free_list;         // recycled conns (allocation pool)
+    int nfree;
+    int accept_batch;               // accepts per listener wakeup
+    struct timespec last_tcp_info;  // TCP_INFO sampler: last pass
+    unsigned tcp_info_phase;        // rotates which conns are sampled
+    struct peer_link *links;        // cluster mode: one per member (self unused)
+    struct conn **edf;              // deadlines = 1: min-heap of conns to serve
+    unsigned edf_n, edf_cap;
+    uint64_t edf_seq;               // tie-break: arrival order
+
+    double tokens;                  // rate_limit_cps token bucket
+    struct timespec last_refill;
+    struct timespec now;            // CLOCK_MONOTONIC, refreshed per batch
+    uint64_t slow_ns;               // slow_request_us in ns (0 = off), per batch
+    struct raw_stats *stats;
+    struct arena scratch;           // per-request transient memory (arena.h)
+    struct trace_buf trace;         // spans of traced conns (trace.h)
+    struct flight_ring flight;      // last lifecycle events (flight.h)
+
+    // Cross-thread state, each on its own cache line.
+    struct mpsc inbox;                             // messages from other workers
+    _Alignas(64) _Atomic uint32_t migrate_req;     // (target+1) << 16 | permille
+    _Alignas(64) _Atomic int journal_waiting;      // wake me after commits
+};
+
+static struct worker workers[MAX_WORKERS];
+static int nworkers;
+static _Atomic uint64_t next_conn_id = 1;
+
+static uint64_t ts_ns(const struct timespec *t) {
+    return (uint64_t)t->tv_sec * 1000000000ull + (uint64_t)t->tv_nsec;
+}
+
+static int64_t ms_since(const struct timespec *then, const struct timespec *now) {
+    return (int64_t)(now->tv_sec - then->tv_sec) * 1000 +
+           (now->tv_nsec - then->tv_nsec) / 1000000;
+}
+
+// ============================================================================
+// Connection allocation and bookkeeping
+// ----------------------------------------------------------------------------
+// struct conn is ~32 KiB; recycling them through a per-worker free list keeps
+// malloc/free (and page faults on fresh memory) off the accept path. A conn
+// that migrated is simply recycled by whichever worker closes it.
+// ============================================================================
+#define CONN_FREE_MAX 1024
+
+// Syscall accounting: every kernel crossing on a worker thread is counted in
+// that worker's stats (single writer, so a plain relaxed add), by kind. The
+// ratio to "msgs" is the number to drive down: it is what each batching
+// change (bulk recv, reply coalescing, accept batches) is supposed to buy.
+#define SYS(w, kind) STAT_INC((w)->stats, sys_##kind)
+
+static struct conn *conn_alloc(struct worker *w) {
+    struct conn *c = w->free_list;
+    if (c) {
+        w->free_list = c->next;
+        w->nfree--;
+        STAT_DEC(w->stats, pool_free);
+    } else {
+        c = malloc(sizeof(*c));
+        if (!c) return NULL;
+        STAT_INC(w->stats, pool_malloc);
+    }
+    memset(c, 0, offsetof(struct conn, in));
+    return c;
+}
+
+static void conn_release(struct worker *w, struct conn *c) {
+    if (w->nfree >= CONN_FREE_MAX) {
+        free(c);
+        return;
+    }
+    c->next = w->free_list;
+    w->free_list = c;
+    w->nfree++;
+    STAT_INC(w->stats, pool_free);
+}
+
+static void list_add(struct worker *w, struct conn *c) {
+    c->next = w->head.next;
+    c->prev = &w->head;
+    w->head.next->prev = c;
+    w->head.next = c;
+    STAT_INC(w->stats, conns);
+}
+
+static void list_del(struct worker *w, struct conn *c) {
+    c->prev->next = c->next;
+    c->next->prev = c->prev;
+    STAT_DEC(w->stats, conns);
+}
+
+static void held_del(struct conn *c) {
+    c->held_prev->held_next = c->held_next;
+    c->held_next->held_prev = c->held_prev;
+    c->held = 0;
+}
+
+// Puts c on the list the worker revisits after each journal commit.
+static void held_add(struct worker *w, struct conn *c) {
+    if (c->held) return;
+    c->held_next = w->held.held_next;
+    c->held_prev = &w->held;
+    w->held.held_next->held_prev = c;
+    w->held.held_next = c;
+    c->held = 1;
+}
+
+static void edf_remove(struct worker *w, struct conn *c);
+
+static void conn_close(struct worker *w, struct conn *c) {
+    list_del(w, c);
+    if (c->edf_pos) edf_remove(w, c);
+    if (c->held) held_del(c);
+    if (c->forwarding) w->links[c->fwd_peer].waiting[c->fwd_slot].c = NULL;
+    uint64_t t0 = c->traced ? trace_now() : 0;
+    SYS(w, close);
+    close(c->fd);   // Return the connected socket’s resources to the kernel.
+                    // This sends a FIN (orderly close) once unsent data is flushed.
+                    // close() also drops the fd from the epoll set.
+    if (c->traced) trace_span(&w->trace, TRACE_CLOSE, c->id, t0, (uint64_t)c->fd);
+    flight_note(&w->flight, FLIGHT_CLOSE, c->id, (uint64_t)c->fd);
+    conn_release(w, c);
+}
+
+// ============================================================================
+// Close path and TIME_WAIT placement
+// ----------------------------------------------------------------------------
+// TCP leaves the 2*MSL TIME_WAIT state on whichever side sends the first FIN.
+// The original server closed right after its reply, so every one-shot
+// connection parked a TIME_WAIT socket on the server: kernel memory, a slot
+// in the established hash, and FIN processing per request. close_mode picks
+// who pays instead:
+//
+//   server  close() as soon as the reply is flushed (original behaviour).
+//   client  leave the socket open and wait for the client's FIN; then the
+//           server's close is the *passive* one and TIME_WAIT lands on the
+//           client. Bounded by close_wait_ms, after which the server closes.
+//   abort   SO_LINGER {on, 0}: close() sends RST and skips TIME_WAIT on both
+//           sides. Only when the kernel send queue is empty, because an RST
+//           discards anything not yet acknowledged; otherwise fall back to an
+//           orderly close.
+//
+// A peer that already sent its FIN (half-close via shutdown(SHUT_WR), or a
+// full close) makes every mode a passive close.
+// ============================================================================
+static int send_queue_empty(struct worker *w, int fd) {
+    int pending = 0;
+    SYS(w, other);
+    return ioctl(fd, SIOCOUTQ, &pending) == 0 && pending == 0;
+}
+
+static void conn_abort(struct worker *w, struct conn *c) {
+    struct linger lg = {1, 0};
+    SYS(w, other);
+    setsockopt(c->fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    STAT_INC(w->stats, close_abort);
+    conn_close(w, c);
+}
+
+// Called once the last reply is in the kernel. Returns 1 if the connection
+// stays open (waiting for the client's FIN), 0 if it was closed.
+static int conn_finish(struct worker *w, struct conn *c, const struct raw_config *cfg) {
+    if (c->eof) {
+        STAT_INC(w->stats, close_passive);
+        conn_close(w, c);
+        return 0;
+    }
+    switch (cfg->close_mode) {
+    case CLOSE_MODE_CLIENT:
+        if (!c->awaiting_fin) {
+            c->awaiting_fin = 1;
+            c->last_active = w->now;
+        }
+        return 1;
+    case CLOSE_MODE_ABORT:
+        if (send_queue_empty(w, c->fd)) {
+            conn_abort(w, c);
+            return 0;
+        }
+        break;
+    default:
+        break;
+    }
+    STAT_INC(w->stats, close_active);
+    conn_close(w, c);
+    return 0;
+}
+
+// Keeps the epoll interest mask in sync with what the connection can do:
+// read while it may still receive requests and has room for their replies,
+// write while output is pending.
+static void conn_update_events(struct worker *w, struct conn *c) {
+    uint32_t want = 0;
+    if (c->awaiting_fin ||
+        (!c->closing && !c->eof && !c->forwarding && CONN_OUT_BUF - c->out_len >= IO_REPLY_MAX)) {
+        want |= EPOLLIN;
+    }
+    if (c->out_off < c->out_ready) want |= EPOLLOUT;
+    if (want == c->events) return;
+
+    struct epoll_event ev = {.events = want, .data.ptr = c};
+    SYS(w, epoll_ctl);
+    if (epoll_ctl(w->epfd, EPOLL_CTL_MOD, c->fd, &ev) == 0) c->events = want;
+}
+
+// ============================================================================
+// Per-connection policy: rate limiting and socket options
+// ============================================================================
+
+// Token bucket: rate_limit_cps tokens per second, capped at the burst size.
+// Each accepted connection spends one token; with none left it is refused.
+static int rate_limit_admit(struct worker *w, const struct raw_config *cfg,
+                            const struct timespec *now) {
+    if (cfg->rate_limit_cps <= 0) return 1;
+
+    double elapsed = (double)(now->tv_sec - w->last_refill.tv_sec) +
+                     (double)(now->tv_nsec - w->last_refill.tv_nsec) / 1e9;
+    double burst = cfg->rate_limit_burst > 0 ? cfg->rate_limit_burst
+                                             : cfg->rate_limit_cps;
+    w->last_refill = *now;
+    w->tokens += elapsed * cfg->rate_limit_cps;
+    if (w->tokens > burst) w->tokens = burst;
+    if (w->tokens < 1.0) return 0;
+    w->tokens -= 1.0;
+    return 1;
+}
+
+// ============================================================================
+// 9) Per-connection message processing
+// ----------------------------------------------------------------------------
+// Goal:
+//   Implement a simple request–response echo protocol:
+//     - Read up to max_msg_len bytes or until newline ('\n' or '\r').
+//     - If client sends > max_msg_len bytes before newline,
+//       discard the rest and respond with "ERR too long\n".
+//     - Otherwise, echo the received bytes back verbatim.
+//   With keepalive = 0 (the default) the connection is closed after the first
+//   request, as the original server did. With keepalive = 1 the client may
+//   pipeline any number of newline-terminated requests; replies come back in
+//   order and empty lines (e.g. the '\n' of "\r\n") are skipped.
+//
+// Design reasoning:
+//   - recv() operates on the TCP receive buffer managed by the kernel.
+//     Each call may return fewer bytes than requested; therefore, we
+//     accumulate until newline or size limit.
+//   - TCP is a stream protocol, not message-oriented — it preserves
+//     byte order but not boundaries. Hence the explicit framing below, which
+//     runs over whatever a single bulk recv() delivered.
+// ============================================================================
+static void append_reply(struct conn *c, const char *data, size_t len) {
+    // Callers guarantee IO_REPLY_MAX bytes of room (see process_input()).
+    memcpy(c->out + c->out_len, data, len);
+    c->out_len += (unsigned)len;
+}
+
+// Marks the reply just appended as sendable, or as held until journal LSN
+// 'lsn' is durable. Unjournaled replies (errors) queue behind held ones so
+// replies never overtake each other.
+static void reply_done(struct worker *w, struct conn *c, uint64_t lsn) {
+    if (lsn) {
+        c->holds[c->nholds].lsn = lsn;          // room checked by process_input()
+        c->holds[c->nholds].end = c->out_len;
+        c->nholds++;
+        held_add(w, c);
+    } else if (c->nholds) {
+        c->holds[c->nholds - 1].end = c->out_len;
+    } else {
+        c->out_ready = c->out_len;
+    }
+}
+
+static void release_holds(struct conn *c, uint64_t durable) {
+    unsigned i = 0;
+    while (i < c->nholds && c->holds[i].lsn <= durable) c->out_ready = c->holds[i++].end;
+    if (i == 0) return;
+    c->nholds -= i;
+    memmove(c->holds, c->holds + i, sizeof(c->holds[0]) * c->nholds);
+    if (c->nholds == 0) c->out_ready = c->out_len;
+}
+
+// ============================================================================
+// Cluster forwarding: request side
+// ----------------------------------------------------------------------------
+// A link is opened on first use with a non-blocking connect and stays open.
+// Forwarded lines are only appended to link->out here; links_flush() sends
+// everything queued during one event batch in a single send() per link.
+// Links are edge-triggered: they are always interested in both directions
+// and drain to EAGAIN, so no epoll_ctl is needed as their state changes.
+// ============================================================================
+static int link_open(struct worker *w, struct peer_link *l, int peer,
+                     const struct raw_config *cfg) {
+    SYS(w, other);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    SYS(w, other);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    const struct sockaddr_in *addr = cluster_peer_addr(peer);
+    SYS(w, other);
+    if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0 && errno != EINPROGRESS) {
+        SYS(w, close);
+        close(fd);
+        return -1;
+    }
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLET,
+                             .data.u64 = ((uint64_t)(uint32_t)peer << 32) | TAG_PEER};
+    SYS(w, epoll_ctl);
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        SYS(w, close);
+        close(fd);
+        return -1;
+    }
+    l->fd = fd;
+    l->connecting = 1;
+    l->in_len = l->out_off = l->out_len = 0;
+    // The greeting marks this conn as a link on the owner's side; its reply
+    // has no conn waiting for it. Until then the owner frames it like any
+    // client, so it ends in the configured delimiter; afterwards the link
+    // speaks lf both ways.
+    const struct framer *fr = framer_get(cfg->delimiter, cfg->text_mode);
+    memcpy(l->out, "PEER", 4);
+    memcpy(l->out + 4, fr->end, fr->end_len);
+    l->out_len = 4 + fr->end_len;
+    l->waiting[l->tail++ % LINK_DEPTH].c = NULL;
+    STAT_INC(w->stats, peer_connects);
+    return 0;
+}
+
+// Queues msg for member 'peer' on behalf of c. Returns -1 if the link is down
+// (and was tried within LINK_RETRY_MS) or full; the caller answers ERR.
+static int forward(struct worker *w, struct conn *c, const struct raw_config *cfg, int peer,
+                   const char *msg, size_t len, uint64_t lsn) {
+    struct peer_link *l = &w->links[peer];
+    if (l->fd < 0) {
+        if (ms_since(&l->down_since, &w->now) < LINK_RETRY_MS) return -1;
+        if (link_open(w, l, peer, cfg) < 0) {
+            l->down_since = w->now;
+            return -1;
+        }
+    }
+    if (l->tail - l->head == LINK_DEPTH) return -1;
+    if (LINK_BUF - l->out_len < len + 1 && l->out_off > 0) {
+        memmove(l->out, l->out + l->out_off, l->out_len - l->out_off);
+        l->out_len -= l->out_off;
+        l->out_off = 0;
+    }
+    if (LINK_BUF - l->out_len < len + 1) return -1;
+
+    memcpy(l->out + l->out_len, msg, len);
+    l->out[l->out_len + len] = '\n';
+    l->out_len += (unsigned)len + 1;
+    c->forwarding = 1;
+    c->fwd_peer = peer;
+    c->fwd_slot = l->tail % LINK_DEPTH;
+    l->waiting[c->fwd_slot].c = c;
+    l->waiting[c->fwd_slot].lsn = lsn;
+    l->tail++;
+    STAT_INC(w->stats, fwd_out);
+    return 0;
+}
+
+static void handle_message(struct worker *w, struct conn *c,
+                           const struct raw_config *cfg, const struct framer *fr,
+                           char *msg, size_t len, enum frame_status verdict, uint64_t lsn) {
+    // -------------------------------------------------------------------------
+    // Response path:
+    //   - If input exceeded max_msg_len before its delimiter, emit an error;
+    //     the same for malformed UTF-8 in utf8 text mode, and for a request
+    //     whose deadline passed before its turn came (deadlines = 1).
+    //   - In cluster mode, KV commands for keys another member owns are
+    //     forwarded there; the reply is relayed when it comes back.
+    //   - With the KV store on, SET/GET/DEL lines are answered from it.
+    //   - Otherwise, echo the content exactly as received.
+    // Replies end in the framer's terminator ('\n', "\r\n" or '\0').
+    // Anything transient (log records, scratch buffers) comes from
+    // w->scratch, never malloc: it is reset as soon as the reply is queued.
+    int owner;
+    uint64_t t0 = c->traced ? trace_now() : 0;
+    flight_note(&w->flight, FLIGHT_REQUEST, c->id, len);
+    if (verdict == FRAME_OK && cluster_enabled() && len == 4 && memcmp(msg, "PEER", 4) == 0) {
+        static const char ok[] = "PEER OK\n";     // links always speak lf
+        c->peer_conn = 1;
+        append_reply(c, ok, sizeof(ok) - 1);
+        reply_done(w, c, lsn);
+    } else if (verdict == FRAME_OK && cluster_enabled() && !c->peer_conn &&
+               (owner = cluster_route(msg, len)) >= 0) {
+        if (forward(w, c, cfg, owner, msg, len, lsn) < 0) {
+            static const char err[] = "ERR peer unavailable";
+            append_reply(c, err, sizeof(err) - 1);
+            append_reply(c, fr->end, fr->end_len);
+            STAT_INC(w->stats, fwd_errors);
+            reply_done(w, c, lsn);
+        }
+    } else {
+        // Errors, KV and echo: the reply every backend gives (io.c).
+        if (io_reply(c->out, &c->out_len, cfg, w->stats, &w->scratch, fr, msg, len, verdict) &&
+            c->peer_conn) {
+            STAT_INC(w->stats, fwd_in);
+        }
+        reply_done(w, c, verdict == FRAME_OK ? lsn : 0);
+    }
+    c->msgs_cur++;
+    STAT_INC(w->stats, msgs);
+    if (!cfg->keepalive && !c->peer_conn) c->closing = 1;
+    if (c->traced) trace_span(&w->trace, TRACE_PROCESS, c->id, t0, len);
+    // The reply is in c->out (or queued on a link): nothing the request
+    // allocated is needed any more.
+    arena_reset(&w->scratch);
+}
+
+// Journals a message about to be echoed. Returns its LSN (0 with the journal
+// off), or -1 if it cannot be taken now: the caller leaves the message in
+// c->in and the worker retries after the next commit.
+static int64_t journal_message(struct worker *w, struct conn *c, const char *msg, size_t len) {
+    if (!journal_enabled()) return 0;
+    // Raised before appending: the commit that covers this record then
+    // cannot miss it (the staging mutex orders the two).
+    atomic_store_explicit(&w->journal_waiting, 1, memory_order_relaxed);
+    uint64_t lsn = journal_append(msg, len);
+    if (lsn == 0) {
+        c->journal_blocked = 1;
+        held_add(w, c);
+        return -1;
+    }
+    c->journal_blocked = 0;
+    return (int64_t)lsn;
+}
+
+// ============================================================================
+// Request deadlines (deadlines = 1)
+// ----------------------------------------------------------------------------
+// A request may start with "@<ms> ", the client's remaining budget:
+//
+//     @50 GET user:42
+//
+// The header is stripped before anything else looks at the request (it does
+// not count against max_msg_len) and the budget runs from when the request's
+// bytes were read, so time spent queued in c->in behind backpressure or
+// behind other connections counts against it. A request whose deadline has
+// passed when its turn comes is answered "ERR deadline" without being
+// executed: under overload, work for a client that already gave up only
+// delays the ones still waiting. Budgets are relative so that client and
+// server clocks need not agree. A line that merely starts with '@' (no
+// digits, or no space after them) is an ordinary request.
+// ============================================================================
+#define DEADLINE_DIGITS 9           // < 2^32 ms
+
+// Parses an optional deadline header at the start of buf[0, avail). Returns
+// its length (0 if there is none), or -1 while the bytes so far could still
+// be the beginning of one.
+static int deadline_header(const char *buf, size_t avail, uint32_t *budget_ms) {
+    if (buf[0] != '@') return 0;
+    uint32_t v = 0;
+    for (size_t i = 1; i < avail; i++) {
+        char ch = buf[i];
+        if (ch == ' ' && i > 1) {
+            *budget_ms = v;
+            return (int)i + 1;
+        }
+        if (ch < '0' || ch > '9' || i > DEADLINE_DIGITS) return 0;
+        v = v * 10 + (uint32_t)(ch - '0');
+    }
+    return -1;
+}
+
+// Slow log, after a request was answered: framing started at t_frame and
+// answering at t_process; its reply is out[out_before, c->out_len). Opens
+// the conn's record unless an older request's reply is still unsent.
+static void slow_note(struct conn *c, uint64_t arrival, uint64_t t_frame, uint64_t t_process,
+                      size_t len, unsigned out_before) {
+    if (c->out_len == out_before || c->forwarding) return;     // no reply (yet)
+    uint64_t t_end = trace_now();
+    struct slow_req *r = &c->slow;
+    if (c->slow_end) {
+        r->more++;
+        if (t_end - t_process > r->more_process_ns) r->more_process_ns = t_end - t_process;
+        return;
+    }
+    uint64_t waited = t_frame > arrival ? t_frame - arrival : 0;
+    r->read_ns = c->read_ns < waited ? c->read_ns : waited;
+    r->queue_ns = waited - r->read_ns;
+    r->frame_ns = t_process - t_frame;
+    r->process_ns = t_end - t_process;
+    r->bytes_in = (uint32_t)len;
+    r->bytes_out = c->out_len - out_before;
+    r->more = 0;
+    r->more_process_ns = 0;
+    c->read_ns = 0;
+    c->slow_arrival = arrival;
+    c->slow_ready = t_end;
+    c->slow_end = c->out_len;
+}
+
+// Slow log, once out[0, slow_end) is sent: logs the open record if the
+// request took slow_request_us or more.
+static void slow_done(struct worker *w, struct conn *c) {
+    uint64_t t = trace_now();
+    c->slow_end = 0;
+    if (!w->slow_ns || t - c->slow_arrival < w->slow_ns) return;
+    struct slow_req *r = &c->slow;
+    r->total_ns = t - c->slow_arrival;
+    r->write_ns = t - c->slow_ready;
+    r->conn = c->id;
+    r->peer = c->peer;
+    r->worker = w->id;
+    if (slowlog_submit(r) < 0) STAT_INC(w->stats, slow_dropped);
+    else STAT_INC(w->stats, slow_requests);
+}
+
+// Frames and answers up to 'limit' complete requests in c->in. Returns the
+// number of input bytes consumed, so callers can tell whether a retry could
+// progress.
+static size_t process_input(struct worker *w, struct conn *c,
+                            const struct raw_config *cfg, size_t limit) {
+    // Links always speak lf/bytes; clients get the configured framer. Picked
+    // once per batch, so the loop below never looks at the protocol settings.
+    // A PEER greeting turns the conn into a link: framing stops there and
+    // drive() comes back for the rest with the link's framer.
+    const int peer = c->peer_conn;
+    const struct framer *fr = peer ? framer_get(DELIM_LF, TEXT_MODE_BYTES)
+                                   : framer_get(cfg->delimiter, cfg->text_mode);
+    const size_t max_len = (size_t)cfg->max_msg_len;
+    const uint64_t now_ns = ts_ns(&w->now), in_at_ns = ts_ns(&c->in_at);
+    size_t pos = 0, answered = 0;
+    unsigned before = c->in_len;
+
+    while (pos < c->in_len && !c->closing && !c->forwarding && c->peer_conn == peer &&
+           answered < limit) {
+        // Backpressure: leave requests in the buffer until their reply fits
+        // (and, with the journal on, until there is a free hold slot).
+        if (CONN_OUT_BUF - c->out_len < IO_REPLY_MAX || c->nholds == JOURNAL_HOLDS) break;
+
+        char *start = c->in + pos;
+        size_t avail = c->in_len - pos;
+        uint64_t t0 = c->traced || w->slow_ns ? trace_now() : 0;
+        size_t hdr = 0;
+        uint64_t deadline = 0;
+        struct frame f;
+        enum frame_status st;
+
+        if (c->discarding) {
+            // Dropping an overlong line: answer it once its delimiter shows.
+            size_t used = fr->skip(start, avail);
+            if (!used) {
+                pos = c->in_len;
+                break;
+            }
+            f.len = 0;
+            f.used = used;
+            st = FRAME_TOO_LONG;
+        } else {
+            uint32_t budget;
+            int h = cfg->deadlines ? deadline_header(start, avail, &budget) : 0;
+            if (h < 0) break;
+            if (h > 0) {
+                hdr = (size_t)h;
+                deadline = in_at_ns + (uint64_t)budget * 1000000u;
+            }
+            st = fr->next(start + hdr, avail - hdr, max_len, &f);
+            if (st == FRAME_PARTIAL) break;
+            if (st == FRAME_OVERFLOW) {
+                // Already over the limit: drop it, up to its delimiter if
+                // that is in the buffer, else keep draining input until the
+                // delimiter arrives.
+                c->discarding = 1;
+                continue;
+            }
+            f.used += hdr;
+            if (deadline && deadline <= now_ns) st = FRAME_EXPIRED;
+        }
+        if (c->traced) trace_span(&w->trace, TRACE_FRAME, c->id, t0, f.len);
+
+        char *msg = start + hdr;
+        int64_t lsn = 0;
+        if (st == FRAME_OK && f.len > 0 && (lsn = journal_message(w, c, msg, f.len)) < 0) {
+            break;
+        }
+        pos += f.used;
+        answered++;
+        c->discarding = 0;
+        if (deadline) STAT_INC(w->stats, deadline_reqs);
+
+        uint64_t t_proc = w->slow_ns ? trace_now() : 0;
+        unsigned out_before = c->out_len;
+        if (st != FRAME_OK) {
+            handle_message(w, c, cfg, fr, NULL, 0, st, 0);
+        } else if (f.len == 0) {
+            // Empty or connection closed before sending data.
+            if (!cfg->keepalive && !c->peer_conn) {
+                if (cfg->log_messages) printf("ℹ️  connection closed with no data\n");
+                c->closing = 1;
+            }
+        } else {
+            handle_message(w, c, cfg, fr, msg, f.len, FRAME_OK, (uint64_t)lsn);
+        }
+        if (w->slow_ns) slow_note(c, in_at_ns, t0, t_proc, f.len, out_before);
+    }
+
+    if (c->closing) {
+        c->in_len = 0;                      // one-shot: ignore anything after
+    } else if (pos > 0) {
+        memmove(c->in, c->in + pos, c->in_len - pos);
+        c->in_len -= (unsigned)pos;
+        // What is left arrived no later than the last read.
+        c->in_at = c->in_last;
+    }
+
+    // Peer performed an orderly shutdown (sent FIN) mid-line: what arrived is
+    // the final request, just as the original blocking loop treated it. With
+    // shutdown(SHUT_WR) the peer is still reading, so every reply owed to it
+    // is flushed before the (passive) close.
+    if (c->eof && !c->closing && !c->forwarding && c->peer_conn == peer && answered < limit &&
+        CONN_OUT_BUF - c->out_len >= IO_REPLY_MAX && c->nholds < JOURNAL_HOLDS) {
+        uint64_t t0 = c->traced || w->slow_ns ? trace_now() : 0;
+        uint32_t budget;
+        int h = cfg->deadlines && c->in_len > 0 && !c->discarding
+                    ? deadline_header(c->in, c->in_len, &budget) : 0;
+        size_t hdr = h > 0 ? (size_t)h : 0, len = c->in_len - hdr;
+        enum frame_status st = c->discarding ? FRAME_TOO_LONG
+                               : len > 0 ? fr->check(c->in + hdr, len, max_len)
+                                         : FRAME_OK;
+        if (st == FRAME_OK && h > 0 && in_at_ns + (uint64_t)budget * 1000000u <= now_ns) {
+            st = FRAME_EXPIRED;
+        }
+        if (c->traced) trace_span(&w->trace, TRACE_FRAME, c->id, t0, len);
+        int64_t lsn = 0;
+        if (st == FRAME_OK && len > 0 && (lsn = journal_message(w, c, c->in + hdr, len)) < 0) {
+            return before - c->in_len;
+        }
+        if (c->in_len > 0 || c->discarding || c->out_len > c->out_off) {
+            STAT_INC(w->stats, half_close);
+        }
+        if (h > 0) STAT_INC(w->stats, deadline_reqs);
+        uint64_t t_proc = w->slow_ns ? trace_now() : 0;
+        unsigned out_before = c->out_len;
+        if (st != FRAME_OK) {
+            handle_message(w, c, cfg, fr, NULL, 0, st, 0);
+        } else if (len > 0) {
+            handle_message(w, c, cfg, fr, c->in + hdr, len, FRAME_OK, (uint64_t)lsn);
+        } else if (cfg->log_messages && c->msgs_cur + c->msgs_prev == 0) {
+            printf("ℹ️  connection closed with no data\n");
+        }
+        if (w->slow_ns) slow_note(c, in_at_ns, t0, t_proc, len, out_before);
+        c->in_len = 0;
+        c->closing = 1;
+    }
+    return before - c->in_len;
+}
+
+// send() semantics:
+//   - Copies user-space bytes into the kernel’s send buffer. The kernel
+//     handles segmentation and retransmission transparently.
+//   - A short write or EAGAIN means the send buffer is full: keep the rest and
+//     wait for EPOLLOUT. On EPIPE/ECONNRESET the peer is gone; close quietly.
+// Returns -1 if the connection was closed.
+static int flush_output(struct worker *w, struct conn *c, const struct raw_config *cfg) {
+    while (c->out_off < c->out_ready) {
+        uint64_t t0 = c->traced ? trace_now() : 0;
+        SYS(w, send);
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_ready - c->out_off,
+                         MSG_NOSIGNAL);
+        if (c->traced && n >= 0) trace_span(&w->trace, TRACE_WRITE, c->id, t0, (uint64_t)n);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                SYS(w, eagain);
+                break;
+            }
+            flight_note(&w->flight, FLIGHT_ERROR, c->id, (uint64_t)errno);
+            if (errno != EPIPE && errno != ECONNRESET) perror("send");
+            conn_close(w, c);
+            return -1;
+        }
+        flight_note(&w->flight, FLIGHT_WRITE, c->id, (uint64_t)n);
+        c->out_off += (unsigned)n;
+    }
+    if (c->slow_end && c->out_off >= c->slow_end) slow_done(w, c);
+    if (c->out_off == c->out_len) c->out_off = c->out_len = c->out_ready = 0;
+
+    if (c->closing && c->out_len == 0 && !c->forwarding && !conn_finish(w, c, cfg)) return -1;
+    conn_update_events(w, c);
+    return 0;
+}
+
+// Drains the socket into c->in. recv() here asks for as much as fits rather
+// than one byte at a time: a single syscall may deliver many pipelined lines.
+static int read_input(struct worker *w, struct conn *c) {
+    if (c->awaiting_fin) c->in_len = 0;     // replies are done; ignore stragglers
+    while (c->in_len < CONN_IN_BUF && !c->eof) {
+        size_t room = CONN_IN_BUF - c->in_len;
+        uint64_t t0 = c->traced || w->slow_ns ? trace_now() : 0;
+        SYS(w, recv);
+        ssize_t n = recv(c->fd, c->in + c->in_len, room, 0);
+        if (c->traced && n >= 0) trace_span(&w->trace, TRACE_READ, c->id, t0, (uint64_t)n);
+        if (w->slow_ns) c->read_ns += trace_now() - t0;
+        if (n >= 0) flight_note(&w->flight, FLIGHT_READ, c->id, (uint64_t)n);
+        if (n == 0) {
+            c->eof = 1;
+        } else if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                SYS(w, eagain);
+                break;
+            }
+            flight_note(&w->flight, FLIGHT_ERROR, c->id, (uint64_t)errno);
+            if (errno != ECONNRESET) perror("recv");
+            conn_close(w, c);
+            return -1;
+        } else {
+            if (c->in_len == 0) c->in_at = w->now;
+            c->in_last = w->now;
+            c->in_len += (unsigned)n;
+            if ((size_t)n < room) break;    // socket drained for now
+        }
+    }
+    return 0;
+}
+
+// Alternates framing and flushing until neither makes progress: a flush that
+// frees output space can unblock requests that were held back by
+// backpressure, and no further EPOLLIN may arrive for data already buffered.
+// Returns -1 if the connection was closed.
+static int drive(struct worker *w, struct conn *c, const struct raw_config *cfg) {
+    for (;;) {
+        size_t consumed = process_input(w, c, cfg, SIZE_MAX);
+        if (flush_output(w, c, cfg) < 0) return -1;
+        if (consumed == 0 || c->in_len == 0) return 0;
+    }
+}
+
+// ============================================================================
+// Earliest-deadline-first scheduling (deadlines = 1)
+// ----------------------------------------------------------------------------
+// Without deadlines a worker answers connections in the order epoll reports
+// them, each one drained completely before the next. With deadlines on, the
+// two halves are split: service_conn() only reads, and queues the conn in a
+// min-heap keyed by the deadline of the request at the head of its input.
+// After the event batch, edf_run() answers one request at a time from the
+// conn whose head request is due first, then re-keys that conn by its next
+// request. Requests without a deadline sort after all others, in arrival
+// order, and the heap drains every batch, so they cannot starve.
+//
+// Replies on one connection still leave in request order (pipelining), so
+// EDF reorders only across connections; a conn leaves the heap when it has
+// no complete request left, and drive() then flushes its replies in one
+// send().
+// ============================================================================
+static int edf_less(const struct conn *a, const struct conn *b) {
+    return a->edf_key != b->edf_key ? a->edf_key < b->edf_key : a->edf_seq < b->edf_seq;
+}
+
+static void edf_place(struct worker *w, unsigned i, struct conn *c) {
+    w->edf[i] = c;
+    c->edf_pos = i + 1;
+}
+
+static void edf_sift_up(struct worker *w, unsigned i) {
+    struct conn *c = w->edf[i];
+    while (i > 0 && edf_less(c, w->edf[(i - 1) / 2])) {
+        edf_place(w, i, w->edf[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    edf_place(w, i, c);
+}
+
+static void edf_sift_down(struct worker *w, unsigned i) {
+    struct conn *c = w->edf[i];
+    for (;;) {
+        unsigned m = 2 * i + 1;
+        if (m >= w->edf_n) break;
+        if (m + 1 < w->edf_n && edf_less(w->edf[m + 1], w->edf[m])) m++;
+        if (!edf_less(w->edf[m], c)) break;
+        edf_place(w, i, w->edf[m]);
+        i = m;
+    }
+    edf_place(w, i, c);
+}
+
+static void edf_remove(struct worker *w, struct conn *c) {
+    unsigned i = c->edf_pos - 1;
+    struct conn *last = w->edf[--w->edf_n];
+    c->edf_pos = 0;
+    if (last == c) return;
+    edf_place(w, i, last);
+    edf_sift_down(w, i);
+    edf_sift_up(w, last->edf_pos - 1);
+}
+
+// Queues c by the deadline of its head request. Returns -1 if the heap
+// cannot grow; the caller then serves c in arrival order.
+static int edf_push(struct worker *w, struct conn *c) {
+    if (c->edf_pos) return 0;
+    if (w->edf_n == w->edf_cap) {
+        unsigned cap = w->edf_cap ? 2 * w->edf_cap : 64;
+        struct conn **heap = realloc(w->edf, cap * sizeof(*heap));
+        if (!heap) return -1;
+        w->edf = heap;
+        w->edf_cap = cap;
+    }
+    uint32_t budget;
+    c->edf_key = deadline_header(c->in, c->in_len, &budget) > 0
+                     ? ts_ns(&c->in_at) + (uint64_t)budget * 1000000u
+                     : UINT64_MAX;
+    c->edf_seq = w->edf_seq++;
+    edf_place(w, w->edf_n++, c);
+    edf_sift_up(w, w->edf_n - 1);
+    return 0;
+}
+
+static void edf_run(struct worker *w, const struct raw_config *cfg) {
+    // Expiry is judged when a request's turn comes, not when the batch began.
+    clock_gettime(CLOCK_MONOTONIC, &w->now);
+    while (w->edf_n > 0) {
+        struct conn *c = w->edf[0];
+        edf_remove(w, c);
+        if (process_input(w, c, cfg, 1) > 0 && c->in_len > 0 && !c->closing &&
+            !c->forwarding && edf_push(w, c) == 0) {
+            continue;
+        }
+        drive(w, c, cfg);
+    }
+}
+
+// After a journal commit: release replies that became durable and retry
+// conns whose messages did not fit in the staging buffer. The list is taken
+// whole, so drive() may close conns or re-add them without disturbing the
+// walk.
+static void journal_progress(struct worker *w, const struct raw_config *cfg) {
+    uint64_t durable = journal_durable();
+    if (durable == w->durable_seen) return;
+    w->durable_seen = durable;
+
+    struct conn pending;
+    if (w->held.held_next == &w->held) {
+        atomic_store_explicit(&w->journal_waiting, 0, memory_order_relaxed);
+        return;
+    }
+    pending.held_next = w->held.held_next;
+    pending.held_prev = w->held.held_prev;
+    pending.held_next->held_prev = &pending;
+    pending.held_prev->held_next = &pending;
+    w->held.held_next = w->held.held_prev = &w->held;
+
+    while (pending.held_next != &pending) {
+        struct conn *c = pending.held_next;
+        held_del(c);
+        release_holds(c, durable);
+        if (drive(w, c, cfg) < 0) continue;
+        if (c->nholds || c->journal_blocked) held_add(w, c);
+    }
+    if (w->held.held_next == &w->held) {
+        atomic_store_explicit(&w->journal_waiting, 0, memory_order_relaxed);
+    }
+}
+
+// ============================================================================
+// Cluster forwarding: reply side
+// ============================================================================
+static void relay_reply(struct worker *w, struct conn *c, uint64_t lsn,
+                        const char *data, size_t len, const struct raw_config *cfg) {
+    c->forwarding = 0;
+    const struct framer *fr = framer_get(cfg->delimiter, cfg->text_mode);
+    append_reply(c, data, len);             // room reserved when it was framed
+    append_reply(c, fr->end, fr->end_len);
+    reply_done(w, c, lsn);
+    drive(w, c, cfg);                       // frame what queued up behind it
+}
+
+// Closes the link and answers everything still waiting on it. New requests
+// for this member get ERR at once until LINK_RETRY_MS has passed.
+static void link_fail(struct worker *w, int peer, const struct raw_config *cfg) {
+    static const char err[] = "ERR peer unavailable";
+    struct peer_link *l = &w->links[peer];
+    SYS(w, close);
+    close(l->fd);
+    l->fd = -1;
+    l->connecting = 0;
+    l->down_since = w->now;
+    l->in_len = l->out_off = l->out_len = 0;
+    fprintf(stderr, "⚠️  worker %d: link to cluster member %d lost\n", w->id, peer);
+    while (l->head != l->tail) {
+        unsigned slot = l->head++ % LINK_DEPTH;
+        struct conn *c = l->waiting[slot].c;
+        if (!c) continue;
+        STAT_INC(w->stats, fwd_errors);
+        relay_reply(w, c, l->waiting[slot].lsn, err, sizeof(err) - 1, cfg);
+    }
+}
+
+// Returns -1 if the link failed.
+static int link_readable(struct worker *w, int peer, const struct raw_config *cfg) {
+    struct peer_link *l = &w->links[peer];
+    for (;;) {
+        SYS(w, recv);
+        ssize_t n = recv(l->fd, l->in + l->in_len, LINK_BUF - l->in_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            SYS(w, eagain);
+            return 0;
+        }
+        if (n <= 0) break;
+        l->in_len += (unsigned)n;
+
+        // Every line answers the oldest request on the link.
+        char *p = l->in, *end = l->in + l->in_len, *nl;
+        while ((nl = memchr(p, '\n', (size_t)(end - p)))) {
+            if (l->head == l->tail) goto fail;      // a reply nobody asked for
+            unsigned slot = l->head++ % LINK_DEPTH;
+            struct conn *c = l->waiting[slot].c;
+            if (c) relay_reply(w, c, l->waiting[slot].lsn, p, (size_t)(nl - p), cfg);
+            p = nl + 1;
+        }
+        l->in_len = (unsigned)(end - p);
+        memmove(l->in, p, l->in_len);
+        if (l->in_len == LINK_BUF) break;            // a line longer than any reply
+    }
+fail:
+    link_fail(w, peer, cfg);
+    return -1;
+}
+
+static void link_flush(struct worker *w, int peer, const struct raw_config *cfg) {
+    struct peer_link *l = &w->links[peer];
+    while (l->fd >= 0 && !l->connecting && l->out_off < l->out_len) {
+        SYS(w, send);
+        ssize_t n = send(l->fd, l->out + l->out_off, l->out_len - l->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                SYS(w, eagain);
+                return;                     // EPOLLOUT edge resumes it
+            }
+            link_fail(w, peer, cfg);
+            return;
+        }
+        l->out_off += (unsigned)n;
+    }
+    if (l->out_off == l->out_len) l->out_off = l->out_len = 0;
+}
+
+static void service_link(struct worker *w, int peer, uint32_t events,
+                         const struct raw_config *cfg) {
+    struct peer_link *l = &w->links[peer];
+    if (l->fd < 0) return;
+    if (l->connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int err = 0;
+        socklen_t elen = sizeof(err);
+        SYS(w, other);
+        if (getsockopt(l->fd, SOL_SOCKET, SO_ERROR, &err, &elen) < 0 || err != 0) {
+            link_fail(w, peer, cfg);
+            return;
+        }
+        l->connecting = 0;
+    }
+    if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && link_readable(w, peer, cfg) < 0) return;
+    link_flush(w, peer, cfg);
+}
+
+// End of an event batch: one send() per link carries every request that was
+// forwarded during the batch.
+static void links_flush(struct worker *w, const struct raw_config *cfg) {
+    for (int i = 0; i < cluster_npeers(); i++) link_flush(w, i, cfg);
+}
+
+static void service_conn(struct worker *w, struct conn *c,
+                         const struct raw_config *cfg, uint32_t events,
+                         const struct timespec *now) {
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        if (read_input(w, c) < 0) return;
+        c->last_active = *now;
+    }
+    // deadlines = 1: answered after the batch, in deadline order (edf_run).
+    if (cfg->deadlines && c->in_len > 0 && !c->closing && !c->forwarding &&
+        edf_push(w, c) == 0) {
+        return;
+    }
+    drive(w, c, cfg);
+}
+
+// ============================================================================
+// 8) Accepting: convert pending SYNs into connected sockets
+// ----------------------------------------------------------------------------
+// Model:
+//   - Each listening socket remains in LISTEN state. Each successful
+//     accept4() returns a *new* connected socket descriptor bound
+//     to the 5-tuple (src IP/port, dst IP/port, protocol) for that client.
+//   - Listeners are level-triggered and drained in batches, so one busy
+//     listener cannot starve the connections already being served.
+//
+// accept_mode decides how workers share a listen address:
+//   reuseport  each worker has its own SO_REUSEPORT socket and accept queue;
+//              the kernel picks the queue by 4-tuple hash, blind to how busy
+//              the worker behind it is. Zero sharing, but with connection
+//              lifetimes that vary, some workers end up with far more work.
+//   exclusive  one socket and one accept queue, registered in every worker's
+//              epoll set with EPOLLEXCLUSIVE: each new connection wakes one
+//              worker that is parked in epoll_wait() (an idle one, by
+//              construction) instead of all of them (thundering herd). Busy
+//              workers simply are not waiting, so new connections flow to
+//              whoever has capacity. The batch is small so one wakeup does
+//              not pull a whole burst onto a single worker.
+// ============================================================================
+static void add_conn(struct worker *w, struct conn *c) {
+    list_add(w, c);
+    c->events = EPOLLIN;
+    struct epoll_event ev = {.events = c->events, .data.ptr = c};
+    SYS(w, epoll_ctl);
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+        perror("epoll_ctl add");
+        conn_close(w, c);
+    }
+}
+
+static void accept_ready(struct worker *w, int lfd, const struct raw_config *cfg,
+                         const struct timespec *now) {
+    for (int i = 0; i < w->accept_batch; i++) {
+        struct sockaddr_in cli;
+        socklen_t clen = sizeof(cli);
+        uint64_t t0 = cfg->trace_sample > 0 ? trace_now() : 0;
+        SYS(w, accept);
+        int cfd = accept4(lfd, (struct sockaddr *)&cli, &clen,
+                          SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EINTR) continue;      // retry on signal interruption
+            if (errno == EAGAIN || errno == EWOULDBLOCK) SYS(w, eagain);
+            else perror("accept");             // transient errors logged; continue serving
+            return;
+        }
+
+        // Optional: observe peer address (for logging/diagnostics).
+        // inet_ntop converts the binary address back to presentation format.
+        char client_ip[INET_ADDRSTRLEN] = "";
+        if (cfg->log_messages) inet_ntop(AF_INET, &cli.sin_addr, client_ip, sizeof(client_ip));
+
+        if (!rate_limit_admit(w, cfg, now)) {
+            static const char busy[] = "ERR busy\n";
+            SYS(w, send);
+            send(cfd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+            STAT_INC(w->stats, refused);
+            flight_note(&w->flight, FLIGHT_REFUSED, 0, (uint64_t)cfd);
+            if (cfg->log_messages)
+                printf("🚦  rate limit: refused %s:%d\n", client_ip, ntohs(cli.sin_port));
+            SYS(w, close);
+            close(cfd);
+            continue;
+        }
+
+        struct conn *c = conn_alloc(w);
+        if (!c) {
+            SYS(w, close);
+            close(cfd);
+            continue;
+        }
+        c->fd = cfd;
+        c->id = atomic_fetch_add_explicit(&next_conn_id, 1, memory_order_relaxed);
+        c->traced = cfg->trace_sample > 0 && c->id % (uint64_t)cfg->trace_sample == 0;
+        c->peer = cli;
+        c->last_active = *now;
+        STAT_INC(w->stats, accepted);
+        if (cfg->log_messages)
+            printf("👋  client connected from %s:%d\n", client_ip, ntohs(cli.sin_port));
+        io_socket_options(cfd, cfg, w->stats);
+        if (c->traced) trace_span(&w->trace, TRACE_ACCEPT, c->id, t0, (uint64_t)cfd);
+        flight_note(&w->flight, FLIGHT_ACCEPT, c->id, (uint64_t)cfd);
+        add_conn(w, c);
+    }
+}
+
+// ============================================================================
+// Inbox and migration: donor side and receiver side
+// ----------------------------------------------------------------------------
+// Workers talk to each other through their inboxes (mpsc.h): a sender posts
+// any number of messages, then kicks the receiver once, which costs an
+// eventfd write only if the receiver is parked in epoll_wait(). The receiver
+// drains its inbox after every event batch. The rebalancer and the journal
+// signal through flags instead and always wake (wake()); they are rare.
+// ============================================================================
+enum { WMSG_HANDOFF = 1 };          // ptr: a struct conn now owned by the receiver
+
+static void wake(struct worker *w) {
+    uint64_t one = 1;
+    ssize_t rc = write(w->wake_fd, &one, sizeof(one));
+    (void)rc;                               // counter saturation is harmless
+}
+
+static int post(struct worker *from, struct worker *target, const struct mpsc_msg *m) {
+    if (mpsc_push(&target->inbox, m) < 0) {
+        STAT_INC(from->stats, inbox_full);
+        return -1;
+    }
+    return 0;
+}
+
+static void kick(struct worker *from, struct worker *target) {
+    if (mpsc_kick(&target->inbox)) {
+        SYS(from, other);
+        STAT_INC(from->stats, inbox_wakeups);
+    }
+}
+
+static void adopt(struct worker *w, struct conn *c, const struct raw_config *cfg,
+                  const struct timespec *now) {
+    list_add(w, c);
+    c->events = 0;
+    c->last_active = *now;
+    struct epoll_event ev = {.events = 0, .data.ptr = c};
+    SYS(w, epoll_ctl);
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+        perror("epoll_ctl add (migrated)");
+        conn_close(w, c);
+        return;
+    }
+    STAT_INC(w->stats, migrated_in);
+    flight_note(&w->flight, FLIGHT_MIGRATE_IN, c->id, (uint64_t)c->fd);
+
+    // Buffered requests and pending replies travelled with the conn.
+    drive(w, c, cfg);
+}
+
+static void drain_inbox(struct worker *w, const struct raw_config *cfg,
+                        const struct timespec *now) {
+    struct mpsc_msg m;
+    while (mpsc_pop(&w->inbox, &m)) {
+        STAT_INC(w->stats, inbox_msgs);
+        if (m.type == WMSG_HANDOFF) adopt(w, m.ptr, cfg, now);
+    }
+}
+
+// Gives away active connections worth roughly 'permille'/1000 of this
+// worker's recent message load. Runs between event batches, so no event for a
+// migrating fd can still be sitting in this worker's epoll_wait() results.
+static void donate(struct worker *w, struct worker *target, unsigned permille) {
+    uint64_t total = 0;
+    int n = 0;
+    for (struct conn *c = w->head.next; c != &w->head; c = c->next) {
+        total += c->msgs_cur + c->msgs_prev;
+        n++;
+    }
+    if (n < 2 || total == 0) return;
+
+    uint64_t budget = total * permille / 1000;
+    int moved = 0;
+    struct conn *c = w->head.next;
+    while (c != &w->head && budget > 0 && moved < n - 1) {
+        struct conn *next = c->next;
+        uint64_t load = c->msgs_cur + c->msgs_prev;
+        // Moving load L narrows a gap of 2*budget as long as L < 2*budget,
+        // even when L alone overshoots the budget (few heavy connections).
+        // Conns waiting on the journal or on a cluster link stay: their holds
+        // and link slots live on this worker.
+        if (load > 0 && load < 2 * budget && !c->closing && !c->held && !c->forwarding) {
+            SYS(w, epoll_ctl);
+            epoll_ctl(w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+            list_del(w, c);
+            flight_note(&w->flight, FLIGHT_MIGRATE_OUT, c->id, (uint64_t)target->id);
+            struct mpsc_msg m = {.type = WMSG_HANDOFF, .ptr = c};
+            if (post(w, target, &m) < 0) {
+                // The target's inbox is full: keep this one and stop here.
+                list_add(w, c);
+                struct epoll_event ev = {.events = c->events, .data.ptr = c};
+                SYS(w, epoll_ctl);
+                if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+                    perror("epoll_ctl add (not migrated)");
+                    conn_close(w, c);
+                }
+                break;
+            }
+            // From here on the conn is the target's: do not touch it.
+            budget -= load < budget ? load : budget;
+            STAT_INC(w->stats, migrated_out);
+            moved++;
+        }
+        c = next;
+    }
+    if (moved > 0) {
+        kick(w, target);
+        printf("⚖️  worker %d → worker %d: migrated %d connection%s\n",
+               w->id, target->id, moved, moved == 1 ? "" : "s");
+    }
+}
+
+static void check_migrate_request(struct worker *w) {
+    if (atomic_load_explicit(&w->migrate_req, memory_order_relaxed) == 0) return;
+    uint32_t req = atomic_exchange_explicit(&w->migrate_req, 0, memory_order_acquire);
+    if (req == 0) return;
+    int target = (int)(req >> 16) - 1;
+    if (target >= 0 && target < nworkers && target != w->id) {
+        donate(w, &workers[target], req & 0xffff);
+    }
+}
+
+// ============================================================================
+// Periodic maintenance: idle timeouts and activity windows
+// ============================================================================
+static void sweep(struct worker *w, const struct raw_config *cfg,
+                  const struct timespec *now) {
+    // Context switches of this thread only: voluntary ones are mostly
+    // epoll_wait() sleeps, involuntary ones mean the core is oversubscribed.
+    struct rusage ru;
+    SYS(w, other);
+    if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+        STAT_SET(w->stats, ctx_voluntary, (uint64_t)ru.ru_nvcsw);
+        STAT_SET(w->stats, ctx_involuntary, (uint64_t)ru.ru_nivcsw);
+    }
+
+    struct conn *c = w->head.next;
+    while (c != &w->head) {
+        struct conn *next = c->next;
+        c->msgs_prev = c->msgs_cur;
+        c->msgs_cur = 0;
+        if (c->awaiting_fin) {
+            if (ms_since(&c->last_active, now) >= cfg->close_wait_ms) {
+                // The client never closed: stop waiting. An RST is safe once
+                // everything we sent has been acknowledged.
+                STAT_INC(w->stats, close_wait_timeout);
+                if (send_queue_empty(w, c->fd)) {
+                    conn_abort(w, c);
+                } else {
+                    STAT_INC(w->stats, close_active);
+                    conn_close(w, c);
+                }
+            }
+        } else if (cfg->recv_timeout_ms > 0 && !c->peer_conn &&
+                   ms_since(&c->last_active, now) >= cfg->recv_timeout_ms) {
+            // The client went quiet mid-conversation.
+            if (cfg->log_messages) printf("⏱️  idle timeout, closing connection %llu\n",
+                                          (unsigned long long)c->id);
+            conn_close(w, c);
+        }
+        c = next;
+    }
+}
+
+// ============================================================================
+// TCP_INFO telemetry
+// ----------------------------------------------------------------------------
+// Client-side latency alone cannot say *why* an echo was slow. Once per
+// tcp_info_ms (rounded up to the sweep period) each worker reads TCP_INFO
+// from up to tcp_info_conns of its connections and from its listeners, and
+// feeds the kernel's view into the stats histograms (admin TCPINFO):
+//
+//   network loss       tcp_retrans climbs, tcp_cwnd collapses, tcp_rtt_us and
+//                      tcp_rttvar_us spread out (RTO backoff)
+//   receiver stalls    tcp_zero_window probes: the client stopped reading and
+//                      its receive window closed; tcp_unacked stays high
+//   accept backlog     accept_backlog near the listen backlog, and
+//                      accept_queue_full counting: connections wait in the
+//                      kernel before this process ever sees them
+//
+// For a listening socket the kernel reports the current accept queue length
+// in tcpi_unacked and the backlog limit in tcpi_sacked.
+//
+// The connections sampled are every k-th one on the worker's list (k =
+// conns / tcp_info_conns) starting at a phase that advances each pass, so
+// over k passes every connection is seen once and the cost per pass stays
+// bounded: one getsockopt() per sampled socket.
+// ============================================================================
+static int tcp_info(struct worker *w, int fd, struct tcp_info *ti) {
+    socklen_t len = sizeof(*ti);
+    SYS(w, other);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, ti, &len) < 0) return -1;
+    STAT_INC(w->stats, tcp_info_samples);
+    return 0;
+}
+
+static void tcp_info_sample(struct worker *w, const struct raw_config *cfg) {
+    struct tcp_info ti;
+    // A shared (accept_mode = exclusive) listener is sampled by worker 0 only.
+    if (cfg->accept_mode != ACCEPT_MODE_EXCLUSIVE || w->id == 0) {
+        for (int i = 0; i < w->nfds; i++) {
+            if (tcp_info(w, w->fds[i], &ti) < 0) continue;
+            STAT_HIST(w->stats, accept_backlog, ti.tcpi_unacked);
+            if (ti.tcpi_sacked > 0 && ti.tcpi_unacked >= ti.tcpi_sacked) {
+                STAT_INC(w->stats, accept_queue_full);
+            }
+        }
+    }
+
+    uint64_t conns = atomic_load_explicit(&w->stats->conns, memory_order_relaxed);
+    unsigned stride = (unsigned)((conns + (unsigned)cfg->tcp_info_conns - 1) /
+                                 (unsigned)cfg->tcp_info_conns);
+    if (stride == 0) return;
+    unsigned phase = w->tcp_info_phase++ % stride, k = 0;
+    for (struct conn *c = w->head.next; c != &w->head; c = c->next, k++) {
+        if (k % stride != phase || tcp_info(w, c->fd, &ti) < 0) continue;
+        STAT_HIST(w->stats, tcp_rtt_us, ti.tcpi_rtt);
+        STAT_HIST(w->stats, tcp_rttvar_us, ti.tcpi_rttvar);
+        // A lifetime total: only the increase since this conn's last sample.
+        STAT_HIST(w->stats, tcp_retrans, ti.tcpi_total_retrans - c->retrans_seen);
+        c->retrans_seen = ti.tcpi_total_retrans;
+        STAT_HIST(w->stats, tcp_unacked, ti.tcpi_unacked);
+        STAT_HIST(w->stats, tcp_cwnd, ti.tcpi_snd_cwnd);
+        STAT_HIST(w->stats, tcp_zero_window, ti.tcpi_probes);
+    }
+}
+
+// ============================================================================
+// The loop
+// ----------------------------------------------------------------------------
+// Blocking semantics:
+//   - epoll_wait() blocks until a listener, a connection or the wake eventfd
+//     is ready, or the sweep period elapses. While parked there the worker is
+//     "offline" for config reclamation: it holds no config pointer.
+// ============================================================================
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    char name[16];
+    snprintf(name, sizeof(name), "raw-worker-%d", w->id);
+    pthread_setname_np(pthread_self(), name);
+    flight_thread_init();
+
+    struct epoll_event events[MAX_EVENTS];
+    struct timespec now, last_sweep;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    w->last_refill = last_sweep = w->last_tcp_info = now;
+
+    for (;;) {
+        // Parked, other workers' messages come with an eventfd write; awake,
+        // they are picked up after this batch without one.
+        int timeout = mpsc_park(&w->inbox) ? SWEEP_MS : 0;
+        config_reader_offline(w->rcu);
+        SYS(w, epoll_wait);
+        int n = epoll_wait(w->epfd, events, MAX_EVENTS, timeout);
+        config_reader_online(w->rcu);
+        mpsc_unpark(&w->inbox);
+        if (n < 0) {
+            if (errno != EINTR) perror("epoll_wait");
+            continue;
+        }
+
+        const struct raw_config *cfg = config_current();
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        w->now = now;
+        w->slow_ns = (uint64_t)cfg->slow_request_us * 1000u;
+
+        for (int i = 0; i < n; i++) {
+            uint64_t tag = events[i].data.u64;
+            if (tag == TAG_WAKE) {
+                uint64_t drained;
+                SYS(w, other);
+                ssize_t rc = read(w->wake_fd, &drained, sizeof(drained));
+                (void)rc;
+                if (journal_enabled()) journal_progress(w, cfg);
+            } else if ((tag & 0xffff) == TAG_LISTENER) {
+                accept_ready(w, (int)(tag >> 32), cfg, &now);
+            } else if ((tag & 0xffff) == TAG_PEER) {
+                service_link(w, (int)(tag >> 32), events[i].events, cfg);
+            } else {
+                service_conn(w, events[i].data.ptr, cfg, events[i].events, &now);
+            }
+        }
+
+        drain_inbox(w, cfg, &now);
+        if (w->edf_n > 0) edf_run(w, cfg);
+        if (w->links) links_flush(w, cfg);
+        check_migrate_request(w);
+        if (ms_since(&last_sweep, &now) >= SWEEP_MS) {
+            sweep(w, cfg, &now);
+            last_sweep = now;
+            if (cfg->tcp_info_ms > 0 && ms_since(&w->last_tcp_info, &now) >= cfg->tcp_info_ms) {
+                tcp_info_sample(w, cfg);
+                w->last_tcp_info = now;
+            }
+        }
+        config_reader_quiescent(w->rcu);
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Rebalancer
+// ----------------------------------------------------------------------------
+// Load signal: per-thread CPU time (pthread_getcpuclockid), which measures
+// exactly what we want to even out — core utilization — regardless of
+// whether a worker is busy because of many cheap requests or few heavy ones.
+//
+// Policy, once per rebalance_ms:
+//   - Find the busiest and the idlest worker.
+//   - If their utilization differs by more than rebalance_threshold_pct of a
+//     core, ask the busiest to hand the idlest half the difference, expressed
+//     as a fraction of its own recent message load.
+//   - Only one donor per tick, so a migration can take effect (and be
+//     measured) before the next decision; this avoids ping-ponging.
+// ============================================================================
+static void *rebalancer_main(void *arg) {
+    (void)arg;
+    pthread_setname_np(pthread_self(), "raw-rebalance");
+    struct config_reader *rcu = config_reader_register();
+
+    clockid_t clocks[MAX_WORKERS];
+    uint64_t prev_ns[MAX_WORKERS] = {0};
+    for (int i = 0; i < nworkers; i++) {
+        if (pthread_getcpuclockid(workers[i].thread, &clocks[i]) != 0) return NULL;
+    }
+
+    struct timespec prev_wall;
+    clock_gettime(CLOCK_MONOTONIC, &prev_wall);
+    for (;;) {
+        config_reader_online(rcu);
+        int period = config_current()->rebalance_ms;
+        int threshold = config_current()->rebalance_threshold_pct;
+        config_reader_offline(rcu);
+
+        struct timespec nap = {(period > 0 ? period : 1000) / 1000,
+                               ((period > 0 ? period : 1000) % 1000) * 1000000L};
+        nanosleep(&nap, NULL);
+
+        struct timespec wall;
+        clock_gettime(CLOCK_MONOTONIC, &wall);
+        double wall_ns = (double)(wall.tv_sec - prev_wall.tv_sec) * 1e9 +
+                         (double)(wall.tv_nsec - prev_wall.tv_nsec);
+        prev_wall = wall;
+
+        int busiest = 0, idlest = 0;
+        double util[MAX_WORKERS];
+        for (int i = 0; i < nworkers; i++) {
+            struct timespec cpu;
+            clock_gettime(clocks[i], &cpu);
+            uint64_t ns = (uint64_t)cpu.tv_sec * 1000000000ULL + (uint64_t)cpu.tv_nsec;
+            util[i] = wall_ns > 0 ? (double)(ns - prev_ns[i]) / wall_ns : 0.0;
+            prev_ns[i] = ns;
+            if (util[i] > util[busiest]) busiest = i;
+            if (util[i] < util[idlest]) idlest = i;
+        }
+
+        if (period <= 0 || busiest == idlest) continue;
+        double gap = util[busiest] - util[idlest];
+        if (gap * 100.0 < threshold || util[busiest] <= 0.0) continue;
+
+        unsigned permille = (unsigned)(gap / 2.0 / util[busiest] * 1000.0);
+        if (permille == 0) continue;
+        if (permille > 500) permille = 500;
+        atomic_store_explicit(&workers[busiest].migrate_req,
+                              ((uint32_t)(idlest + 1) << 16) | permille,
+                              memory_order_release);
+        wake(&workers[busiest]);
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Startup and introspection
+// ============================================================================
+static int worker_init(struct worker *w, int id, const int *fds, int nfds) {
+    w->id = id;
+    w->stats = stats_worker(id);
+    w->nfds = nfds;
+    w->head.next = w->head.prev = &w->head;
+    w->held.held_next = w->held.held_prev = &w->held;
+    w->durable_seen = journal_durable();
+    if (arena_init(&w->scratch, ARENA_BYTES, w->stats) < 0) return -1;
+    char name[16];
+    snprintf(name, sizeof(name), "raw-worker-%d", id);
+    if (trace_buf_init(&w->trace, id, name) < 0) return -1;
+    if (flight_ring_init(&w->flight, id) < 0) return -1;
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+    w->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (w->epfd < 0 || w->wake_fd < 0) return -1;
+    if (mpsc_init(&w->inbox, INBOX_SLOTS, w->wake_fd) < 0) return -1;
+    if (cluster_enabled()) {
+        w->links = calloc((size_t)cluster_npeers(), sizeof(*w->links));
+        if (!w->links) return -1;
+        for (int i = 0; i < cluster_npeers(); i++) w->links[i].fd = -1;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = TAG_WAKE};
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->wake_fd, &ev) < 0) return -1;
+
+    int exclusive = config_current()->accept_mode == ACCEPT_MODE_EXCLUSIVE;
+    w->accept_batch = exclusive ? ACCEPT_BATCH_SHARED : ACCEPT_BATCH;
+    for (int i = 0; i < nfds; i++) {
+        w->fds[i] = fds[i];
+        // Listeners must not block accept4() once epoll has reported them
+        // (another worker may win the race for a connection in exclusive
+        // wakeup scenarios, or the peer may reset before we get to it).
+        int fl = fcntl(fds[i], F_GETFL);
+        if (fl < 0 || fcntl(fds[i], F_SETFL, fl | O_NONBLOCK) < 0) return -1;
+        ev.events = EPOLLIN | (exclusive ? EPOLLEXCLUSIVE : 0);
+        ev.data.u64 = ((uint64_t)(uint32_t)fds[i] << 32) | TAG_LISTENER;
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, fds[i], &ev) < 0) return -1;
+    }
+    w->rcu = config_reader_register();
+    return 0;
+}
+
+int workers_start(int n, int fds[][CONFIG_MAX_LISTEN], int nfds) {
+    if (n < 1 || n > MAX_WORKERS) {
+        errno = EINVAL;
+        return -1;
+    }
+    nworkers = n;
+    stats_init(n);
+    if (slowlog_start() < 0) return -1;
+    for (int i = 0; i < n; i++) {
+        if (worker_init(&workers[i], i, fds[i], nfds) < 0) return -1;
+    }
+    int cpu_pin = config_current()->cpu_pin;
+    for (int i = 0; i < n; i++) {
+        int rc = pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+        if (rc != 0) {
+            errno = rc;
+            return -1;
+        }
+        if (cpu_pin >= 0) io_pin_worker(workers[i].thread, i, cpu_pin + i);
+    }
+    if (n > 1) {
+        pthread_t tid;
+        int rc = pthread_create(&tid, NULL, rebalancer_main, NULL);
+        if (rc != 0) {
+            errno = rc;
+            return -1;
+        }
+        pthread_detach(tid);
+    }
+    return 0;
+}
+
+void workers_journal_wake(void) {
+    for (int i = 0; i < nworkers; i++) {
+        if (atomic_load_explicit(&workers[i].journal_waiting, memory_order_relaxed)) {
+            wake(&workers[i]);
+        }
+    }
+}
+
+void workers_join(void) {
+    for (int i = 0; i < nworkers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+}
+
+void workers_dump(FILE *out) {
+    for (int i = 0; i < nworkers; i++) {
+        struct worker *w = &workers[i];
+        double cpu = 0.0;
+        clockid_t cid;
+        struct timespec ts;
+        if (pthread_getcpuclockid(w->thread, &cid) == 0 && clock_gettime(cid, &ts) == 0) {
+            cpu = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+        }
+        struct raw_stats_snapshot s;
+        stats_read(i, &s);
+        uint64_t sys = stats_syscalls(&s);
+        fprintf(out, "worker %d: conns=%llu accepted=%llu msgs=%llu cpu=%.3fs migrated_in=%llu"
+                     " migrated_out=%llu inbox=%llu wakeups_sent=%llu syscalls/msg=%.2f"
+                     " csw=%llu/%llu\n",
+                i, (unsigned long long)s.conns, (unsigned long long)s.accepted,
+                (unsigned long long)s.msgs, cpu,
+                (unsigned long long)s.migrated_in, (unsigned long long)s.migrated_out,
+                (unsigned long long)s.inbox_msgs, (unsigned long long)s.inbox_wakeups,
+                s.msgs ? (double)sys / (double)s.msgs : 0.0,
+                (unsigned long long)s.ctx_voluntary, (unsigned long long)s.ctx_involuntary);
+    }
+}
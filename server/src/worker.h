@@ -0,0 +1,38 @@
+#ifndef RAW_WORKER_H
+#define RAW_WORKER_H
+
+// ============================================================================
+// Worker threads: event loops, connections and rebalancing
+// ----------------------------------------------------------------------------
+// Each worker runs one epoll(7) loop over its listeners (its own SO_REUSEPORT
+// sockets, or the shared ones with accept_mode = exclusive) and the
+// connections it owns. A connection belongs to exactly one worker at a
+// time; only the owner touches its buffers or its epoll registration.
+//
+// Ownership can move: a rebalancer thread watches per-worker CPU time and,
+// when one worker is markedly busier than another, asks the busy worker to
+// hand some of its active connections over. The handoff carries the whole
+// struct conn (fd, buffered input, pending output) through the receiving
+// worker's inbox, a bounded lock-free ring (mpsc.h).
+#include <stdio.h>
+
+#include "config.h"
+
+#define MAX_WORKERS 256
+
+// Takes ownership of the listening sockets in fds[w][0..nfds) for worker w
+// and starts n worker threads (plus the rebalancer when n > 1).
+// Returns 0 or -1 with errno set.
+int workers_start(int n, int fds[][CONFIG_MAX_LISTEN], int nfds);
+
+// Blocks until every worker thread exits (in practice: forever).
+void workers_join(void);
+
+// Journal commit callback: wakes every worker holding replies for
+// durability (see journal.h).
+void workers_journal_wake(void);
+
+// One line per worker: connections, messages, CPU time, migrations.
+void workers_dump(FILE *out);
+
+#endif
@@ -0,0 +1,75 @@
+#!/bin/sh
+# ============================================================================
+# accept_compare.sh — accept_mode = reuseport vs. exclusive under skewed load
+# ----------------------------------------------------------------------------
+# usage: tools/accept_compare.sh [WORKERS] [CPS_MAX] [STEP_SECS]
+#                                                  (or `make accept-compare`)
+#
+# For each accept_mode:
+#   1) start raw_server with WORKERS workers, keepalive on and the rebalancer
+#      off (rebalance_ms = 0), so only the accept path decides placement;
+#   2) pin a few long-lived, deeply pipelined echo connections in the
+#      background (raw_bench --mode echo): the workers they hash to are busy
+#      for the whole run, the others are not;
+#   3) step new connections up to CPS_MAX with raw_bench --mode cps and read
+#      its RESULT line.
+#
+# Reading the table:
+#   best_cps       highest sustained conn/s (p99 within the SLO)
+#   fb_p50/p99     first-byte latency at that step: accept + first reply;
+#                  a connection queued behind a busy worker shows up here
+#   accept_imb     max/mean of connections accepted per worker (1.00 = even)
+#   cpu_imb        max/mean of worker CPU time over the cps run
+#
+# With reuseport the kernel hashes each new connection to a worker without
+# looking at load, so the busy workers get their full share and first-byte
+# p99 grows with their backlog. With exclusive the shared queue is drained
+# by whichever worker is waiting, so new connections go to idle workers:
+# accept_imb moves away from 1.00 on purpose while first-byte p99 drops.
+set -eu
+
+WORKERS=${1:-4}
+CPS_MAX=${2:-8000}
+STEP=${3:-2}
+PORT=${ACCEPT_PORT:-9600}
+ADMIN=${ACCEPT_ADMIN_PORT:-9601}
+HOGS=${ACCEPT_HOG_CONNS:-2}
+
+. "$(dirname "$0")/bench_lib.sh"
+
+printf "%-10s %9s %8s %8s %10s %8s\n" mode best_cps fb_p50 fb_p99 accept_imb cpu_imb
+for mode in reuseport exclusive; do
+    cat > "$CONF" <<CONF
+listen = 127.0.0.1:$PORT
+admin_port = $ADMIN
+workers = $WORKERS
+accept_mode = $mode
+keepalive = 1
+rebalance_ms = 0
+log_messages = 0
+backlog = 4096
+CONF
+    "$BIN/raw_server" -c "$CONF" > /dev/null 2>&1 &
+    SERVER=$!
+    sleep 0.5
+
+    "$BIN/raw_bench" --mode echo -t 1 --conns "$HOGS" --depth 32 -d 3600 \
+        "127.0.0.1:$PORT" > /dev/null 2>&1 &
+    HOG=$!
+    sleep 0.5
+
+    "$BIN/raw_bench" --mode cps -t 2 --cps-start $((CPS_MAX / 4)) --cps-step $((CPS_MAX / 4)) \
+        --cps-max "$CPS_MAX" --step-secs "$STEP" --admin "$ADMIN" \
+        "127.0.0.1:$PORT" > "$RESULT" || true
+
+    kill "$HOG"; wait "$HOG" 2>/dev/null || true; HOG=
+    kill "$SERVER"; wait "$SERVER" 2>/dev/null || true; SERVER=
+
+    if [ -z "$(field best_cps)" ]; then
+        echo "$mode: no result" >&2
+        continue
+    fi
+    printf "%-10s %9s %8s %8s %10s %8s\n" "$mode" "$(field best_cps)" \
+        "$(field first_byte_p50_ms)" "$(field first_byte_p99_ms)" \
+        "$(field accept_imbalance)" "$(field cpu_imbalance)"
+done
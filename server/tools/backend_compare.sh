@@ -0,0 +1,93 @@
+#!/bin/sh
+# ============================================================================
+# backend_compare.sh — the same workloads against each io_backend
+# ----------------------------------------------------------------------------
+# usage: tools/backend_compare.sh [WORKERS] [SECS] [OUT.csv]
+#                                                  (or `make backend-compare`)
+#
+# For each io_backend (epoll, blocking, uring) and each load shape:
+#   1) start raw_server with WORKERS workers, keepalive on, logging off and
+#      the rebalancer off (only epoll has one);
+#   2) run raw_bench --mode echo for SECS with --admin and read its RESULT
+#      line.
+#
+# Load shapes (raw_bench threads x conns per thread x depth):
+#   fanout     many connections, one request in flight on each: what a
+#              request/response service with many idle-ish clients sees
+#   pipelined  few connections, many requests in flight on each: batching
+#              territory, where per-syscall work is amortized
+#
+# Reading the table:
+#   msgs/s        throughput
+#   p50/p99       round-trip latency, ms
+#   srv_cores     server CPU over the run (process user + sys)
+#   msgs/cpu-s    server efficiency: messages per second of server CPU
+#   sys/msg       server syscalls per message (stats.h sys_*): epoll pays
+#                 epoll_wait + recv + send, blocking recv + send per batch
+#                 but a context switch per wakeup, uring one
+#                 io_uring_enter() for many operations
+#   cli_cores     load generator CPU; if it nears the cores it has, the
+#                 client is the bottleneck and the row understates the server
+#
+# A backend that cannot run on this host (io_uring disabled by a seccomp
+# profile or kernel.io_uring_disabled) is reported and skipped.
+set -eu
+
+WORKERS=${1:-2}
+SECS=${2:-5}
+CSV=${3:-backends.csv}
+PORT=${BACKEND_PORT:-9700}
+ADMIN=${BACKEND_ADMIN_PORT:-9701}
+BACKENDS=${BACKEND_LIST:-"epoll blocking uring"}
+# name:threads:conns:depth
+SHAPES=${BACKEND_SHAPES:-"fanout:4:64:1 pipelined:2:2:32"}
+
+. "$(dirname "$0")/bench_lib.sh"
+
+echo "backend,shape,threads,conns,depth,msgs_per_s,p50_ms,p99_ms,server_cores,msgs_per_cpu_s,syscalls_per_msg,client_cores" > "$CSV"
+printf "%-9s %-10s %10s %8s %8s %9s %11s %8s %9s\n" \
+    backend shape msgs/s p50 p99 srv_cores msgs/cpu-s sys/msg cli_cores
+for backend in $BACKENDS; do
+    cat > "$CONF" <<CONF
+listen = 127.0.0.1:$PORT
+admin_port = $ADMIN
+workers = $WORKERS
+io_backend = $backend
+keepalive = 1
+rebalance_ms = 0
+log_messages = 0
+tcp_info_ms = 0
+backlog = 4096
+CONF
+    "$BIN/raw_server" -c "$CONF" > "$LOG" 2>&1 &
+    SERVER=$!
+    sleep 0.5
+    if ! kill -0 "$SERVER" 2>/dev/null; then
+        echo "$backend: server did not start: $(tail -n 1 "$LOG")" >&2
+        wait "$SERVER" 2>/dev/null || true; SERVER=
+        continue
+    fi
+
+    for shape in $SHAPES; do
+        IFS=: read -r name threads conns depth <<SHAPE
+$shape
+SHAPE
+        "$BIN/raw_bench" --mode echo -t "$threads" --conns "$conns" --depth "$depth" \
+            -d "$SECS" --admin "$ADMIN" "127.0.0.1:$PORT" > "$RESULT" 2>&1 || true
+        if [ -z "$(field msgs_per_s)" ]; then
+            echo "$backend/$name: no result" >&2
+            continue
+        fi
+        printf "%-9s %-10s %10s %8s %8s %9s %11s %8s %9s\n" "$backend" "$name" \
+            "$(field msgs_per_s)" "$(field p50_ms)" "$(field p99_ms)" \
+            "$(field server_cores)" "$(field msgs_per_cpu_s)" \
+            "$(field syscalls_per_msg)" "$(field client_cores)"
+        echo "$backend,$name,$threads,$conns,$depth,$(field msgs_per_s),$(field p50_ms)," \
+             "$(field p99_ms),$(field server_cores),$(field msgs_per_cpu_s)," \
+             "$(field syscalls_per_msg),$(field client_cores)" | tr -d ' ' >> "$CSV"
+    done
+
+    kill "$SERVER"; wait "$SERVER" 2>/dev/null || true; SERVER=
+    sleep 0.2
+done
+echo "wrote $CSV"
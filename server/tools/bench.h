@@ -0,0 +1,113 @@
+#ifndef RAW_BENCH_H
+#define RAW_BENCH_H
+
+// ============================================================================
+// raw_bench internals shared by the benchmark modes
+// ============================================================================
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_MAX_THREADS 256
+#define BENCH_MAX_STATS 64
+#define BENCH_MAX_SRC 1024
+
+struct options {
+    const char *mode;
+    struct sockaddr_in target;
+    int threads;
+    double duration;
+    const char *message;
+    int wait_server_close;
+    int admin_port;
+
+    // cps mode
+    struct in_addr src[BENCH_MAX_SRC];  // local source addresses to rotate through
+    int nsrc;
+    double cps_start, cps_step, cps_max;
+    double step_secs;
+    double slo_ms;                      // p99 bound for a step to count as sustained
+    int max_inflight;                   // per thread
+    const char *csv_path;
+    const char *profile_path;           // PROFILE output for the --profile-at step
+    double profile_at;
+
+    // echo mode
+    int echo_conns;                     // persistent connections per thread
+    int echo_depth;                     // outstanding requests per connection
+    int echo_lib;                       // through libraw instead of raw sockets
+    int echo_deadline_ms;               // "@<ms> " budget on every request, 0 = none
+
+    // soak mode
+    double soak_rate;                   // connections/s, all threads
+    double soak_interval;               // seconds between samples
+};
+
+extern struct options opt;
+
+// ============================================================================
+// Latency histogram
+// ----------------------------------------------------------------------------
+// Log-linear buckets: 16 linear sub-buckets per power of two of nanoseconds,
+// so any recorded value is within ~6% of its bucket's lower bound. Fixed
+// size, no allocation, mergeable by addition.
+// ============================================================================
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS (64u * HIST_SUB)
+
+struct hist {
+    uint64_t n;
+    uint64_t max;
+    uint64_t counts[HIST_BUCKETS];
+};
+
+void hist_record(struct hist *h, uint64_t ns);
+void hist_merge(struct hist *into, const struct hist *from);
+uint64_t hist_percentile(const struct hist *h, double p);   // ns, p in [0,100]
+
+// ============================================================================
+// Server-side helpers
+// ============================================================================
+struct stat_kv {
+    char name[48];
+    unsigned long long value;
+};
+
+// Runs an admin command and parses "name value" lines. Returns the count.
+int bench_fetch_stats(int admin_port, struct stat_kv *kv, int max);
+unsigned long long bench_stat_value(const struct stat_kv *kv, int n, const char *name);
+
+// Per-worker counters from the admin WORKERS command. Returns the number of
+// workers parsed, or -1 when the admin port is unreachable.
+struct worker_kv {
+    unsigned long long accepted;
+    double cpu;                         // seconds
+};
+int bench_fetch_workers(int admin_port, struct worker_kv *w, int max);
+
+// Sends an arbitrary admin command and copies the reply to 'out'.
+int bench_admin_to_file(int admin_port, const char *cmd, FILE *out);
+
+// TIME_WAIT census on this host for the target port.
+void bench_count_timewait(unsigned port, unsigned long long *server_side,
+                          unsigned long long *client_side);
+
+// Host-wide TcpExt counter from /proc/net/netstat (e.g. "ListenOverflows").
+unsigned long long bench_tcpext(const char *name);
+
+// ============================================================================
+// Modes
+// ============================================================================
+int bench_run_cps(void);
+int bench_run_soak(void);
+int bench_run_echo(void);
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,171 @@
+// ============================================================================
+// raw_bench shared helpers: histogram, admin access, kernel counters
+// ============================================================================
+#define _GNU_SOURCE
+#include "bench.h"
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// ============================================================================
+// Histogram
+// ============================================================================
+static unsigned hist_index(uint64_t v) {
+    if (v < HIST_SUB) return (unsigned)v;
+    unsigned msb = 63u - (unsigned)__builtin_clzll(v);
+    unsigned shift = msb - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + (unsigned)((v >> shift) & (HIST_SUB - 1));
+}
+
+static uint64_t hist_value(unsigned idx) {
+    if (idx < HIST_SUB) return idx;
+    unsigned shift = idx / HIST_SUB - 1;
+    return (uint64_t)(HIST_SUB + idx % HIST_SUB) << shift;
+}
+
+void hist_record(struct hist *h, uint64_t ns) {
+    h->counts[hist_index(ns)]++;
+    h->n++;
+    if (ns > h->max) h->max = ns;
+}
+
+void hist_merge(struct hist *into, const struct hist *from) {
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) into->counts[i] += from->counts[i];
+    into->n += from->n;
+    if (from->max > into->max) into->max = from->max;
+}
+
+uint64_t hist_percentile(const struct hist *h, double p) {
+    if (h->n == 0) return 0;
+    uint64_t rank = (uint64_t)((p / 100.0) * (double)h->n);
+    if (rank >= h->n) rank = h->n - 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > rank) {
+            uint64_t v = hist_value(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+// ============================================================================
+// Admin port access
+// ============================================================================
+static FILE *admin_open(int admin_port, const char *cmd) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return NULL;
+    struct sockaddr_in a = {.sin_family = AF_INET, .sin_port = htons((uint16_t)admin_port)};
+    inet_pton(AF_INET, "127.0.0.1", &a.sin_addr);
+    size_t len = strlen(cmd);
+    if (connect(fd, (struct sockaddr *)&a, sizeof(a)) < 0 ||
+        send(fd, cmd, len, MSG_NOSIGNAL) != (ssize_t)len ||
+        send(fd, "\n", 1, MSG_NOSIGNAL) != 1) {
+        close(fd);
+        return NULL;
+    }
+    FILE *f = fdopen(fd, "r");
+    if (!f) close(fd);
+    return f;
+}
+
+int bench_fetch_stats(int admin_port, struct stat_kv *kv, int max) {
+    FILE *f = admin_open(admin_port, "STATS");
+    if (!f) return -1;
+    int n = 0;
+    char line[128];
+    while (n < max && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%47s %llu", kv[n].name, &kv[n].value) == 2) n++;
+    }
+    fclose(f);
+    return n;
+}
+
+unsigned long long bench_stat_value(const struct stat_kv *kv, int n, const char *name) {
+    for (int i = 0; i < n; i++) {
+        if (strcmp(kv[i].name, name) == 0) return kv[i].value;
+    }
+    return 0;
+}
+
+int bench_fetch_workers(int admin_port, struct worker_kv *w, int max) {
+    FILE *f = admin_open(admin_port, "WORKERS");
+    if (!f) return -1;
+    int n = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        int id;
+        struct worker_kv v;
+        if (sscanf(line, "worker %d: conns=%*u accepted=%llu msgs=%*u cpu=%lfs", &id,
+                   &v.accepted, &v.cpu) == 3 && id >= 0 && id < max) {
+            w[id] = v;
+            if (id + 1 > n) n = id + 1;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+int bench_admin_to_file(int admin_port, const char *cmd, FILE *out) {
+    FILE *f = admin_open(admin_port, cmd);
+    if (!f) return -1;
+    char buf[8192];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) fwrite(buf, 1, n, out);
+    fclose(f);
+    return 0;
+}
+
+// ============================================================================
+// Kernel-side views
+// ============================================================================
+void bench_count_timewait(unsigned port, unsigned long long *server_side,
+                          unsigned long long *client_side) {
+    *server_side = *client_side = 0;
+    const char *paths[] = {"/proc/net/tcp", "/proc/net/tcp6"};
+    for (int p = 0; p < 2; p++) {
+        FILE *f = fopen(paths[p], "r");
+        if (!f) continue;
+        char line[512];
+        while (fgets(line, sizeof(line), f)) {
+            char local[64], remote[64];
+            unsigned state;
+            if (sscanf(line, "%*s %63s %63s %x", local, remote, &state) != 3) continue;
+            if (state != 0x06) continue;
+            const char *lp = strrchr(local, ':'), *rp = strrchr(remote, ':');
+            if (!lp || !rp) continue;
+            if (strtoul(lp + 1, NULL, 16) == port) (*server_side)++;
+            if (strtoul(rp + 1, NULL, 16) == port) (*client_side)++;
+        }
+        fclose(f);
+    }
+}
+
+// /proc/net/netstat holds pairs of lines: "TcpExt: Name1 Name2 ..." followed
+// by "TcpExt: v1 v2 ...".
+unsigned long long bench_tcpext(const char *name) {
+    FILE *f = fopen("/proc/net/netstat", "r");
+    if (!f) return 0;
+    static char names[8192], values[8192];
+    unsigned long long result = 0;
+    while (fgets(names, sizeof(names), f) && fgets(values, sizeof(values), f)) {
+        if (strncmp(names, "TcpExt:", 7) != 0) continue;
+        char *ns, *vs;
+        char *n = strtok_r(names + 7, " \n", &ns);
+        char *v = strtok_r(values + 7, " \n", &vs);
+        while (n && v) {
+            if (strcmp(n, name) == 0) {
+                result = strtoull(v, NULL, 10);
+                break;
+            }
+            n = strtok_r(NULL, " \n", &ns);
+            v = strtok_r(NULL, " \n", &vs);
+        }
+    }
+    fclose(f);
+    return result;
+}
@@ -0,0 +1,530 @@
+// ============================================================================
+// raw_bench --mode cps — maximum sustainable new connections per second
+// ----------------------------------------------------------------------------
+// The conn mode is closed-loop: each thread waits for one connection to
+// finish before starting the next, so a slow server simply gets fewer
+// attempts and latency never looks bad. This mode is open-loop instead:
+// connections are launched on a fixed schedule (target CPS / threads per
+// thread) whatever the server is doing, and the rate is stepped up from
+// --cps-start by --cps-step until --cps-max. Each step reports the achieved
+// rate and the latency of every phase of the one-request-per-connection flow
+// separately:
+//
+//   handshake   connect() start → socket writable (SYN / SYN-ACK / ACK,
+//               plus any time spent in a full accept queue)
+//   first-byte  request sent → first reply byte (accept() + epoll + read +
+//               reply on the server side)
+//   close       --close client: time spent in close()
+//               --close server: reply line → server's FIN (how long the
+//               server takes to tear the connection down)
+//   total       connect() start → connection done; the SLO applies to this
+//
+// A step is "sustained" when it completes ≥95% of its target, fewer than
+// 0.1% of attempts fail and total p99 stays under --slo-ms. The highest such
+// step is the reported maximum; the run ends after two consecutive steps
+// that are not sustained (the knee has been passed).
+//
+// Under the hood:
+//   - Every thread owns an epoll instance and up to --max-inflight
+//     nonblocking sockets; the whole connection lifecycle is a small state
+//     machine driven by readiness, so one thread can keep thousands of
+//     handshakes in flight.
+//   - --src spreads connections over many local addresses. A client can only
+//     have ~28k ports (ip_local_port_range) in use or in TIME_WAIT per
+//     (src, dst) pair; at 10k+ CPS with client-first close that is exhausted
+//     in seconds. IP_BIND_ADDRESS_NO_PORT defers port choice to connect(),
+//     so the kernel picks a port that is free for the full 4-tuple instead
+//     of reserving one per address at bind() time. Any 127.0.0.0/8 address
+//     works on loopback. EADDRNOTAVAIL is counted separately so exhaustion
+//     is visible rather than folded into "errors".
+//   - With --admin, server "accepted" and the host's TcpExt ListenOverflows
+//     / ListenDrops are sampled around every step: a rising overflow count
+//     means the accept queue, not the handshake, is the limit.
+//   - With --admin, per-worker "accepted" and CPU time are also sampled
+//     around the whole run and summarized as max/mean ratios (1.00 is a
+//     perfect spread): how evenly the server's accept_mode hands new
+//     connections to its workers. The last line is a "RESULT key=value ..."
+//     record for scripts (tools/accept_compare.sh).
+//   - --profile FILE --profile-at CPS runs the admin PROFILE command for the
+//     duration of the first step whose target reaches CPS, so the folded
+//     stacks show where the server spends the accept path at that load.
+// ============================================================================
+#define _GNU_SOURCE
+#include "bench.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef IP_BIND_ADDRESS_NO_PORT
+#define IP_BIND_ADDRESS_NO_PORT 24
+#endif
+
+#define CPS_CONN_TIMEOUT_NS (3ull * 1000000000ull)   // covers one SYN retransmit
+#define CPS_DRAIN_NS (1ull * 1000000000ull)          // grace after a step ends
+
+enum slot_state { SLOT_FREE, SLOT_CONNECTING, SLOT_REPLY, SLOT_EOF };
+
+struct slot {
+    int fd;
+    enum slot_state state;
+    int got_first;
+    uint64_t t_start;       // connect() issued
+    uint64_t t_sent;        // request written
+    uint64_t t_reply;       // reply line complete
+};
+
+struct step_result {
+    uint64_t ok;
+    uint64_t errors;
+    uint64_t addr_exhausted;    // EADDRNOTAVAIL from bind/connect
+    uint64_t timeouts;
+    uint64_t missed;            // launches skipped because max-inflight was reached
+    struct hist handshake, first_byte, close, total;
+};
+
+struct cps_thread {
+    int id;
+    pthread_t tid;
+    int epfd;
+    struct slot *slots;
+    int *free_idx;
+    int nfree;
+    unsigned src_next;
+    struct step_result r;
+};
+
+static struct cps_thread *threads;
+static pthread_barrier_t step_go, step_done;
+static double step_target;          // CPS for the current step, all threads
+static _Atomic int finished;
+static char request[4096];
+static size_t request_len;
+
+// ============================================================================
+// Connection lifecycle
+// ============================================================================
+static void slot_finish(struct cps_thread *t, int idx) {
+    struct slot *s = &t->slots[idx];
+    close(s->fd);
+    s->fd = -1;
+    s->state = SLOT_FREE;
+    t->free_idx[t->nfree++] = idx;
+}
+
+static void slot_fail(struct cps_thread *t, int idx, int err) {
+    if (err == EADDRNOTAVAIL) t->r.addr_exhausted++;
+    else t->r.errors++;
+    slot_finish(t, idx);
+}
+
+static void slot_done(struct cps_thread *t, int idx, uint64_t now) {
+    struct slot *s = &t->slots[idx];
+    uint64_t close_ns;
+    if (s->state == SLOT_EOF) {
+        close_ns = now - s->t_reply;
+        slot_finish(t, idx);
+    } else {
+        slot_finish(t, idx);
+        uint64_t after = bench_now_ns();
+        close_ns = after - now;
+        now = after;
+    }
+    hist_record(&t->r.close, close_ns);
+    hist_record(&t->r.total, now - s->t_start);
+    t->r.ok++;
+}
+
+static void launch(struct cps_thread *t, uint64_t now) {
+    if (t->nfree == 0) {
+        t->r.missed++;
+        return;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        t->r.errors++;
+        return;
+    }
+    if (opt.nsrc > 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+        struct sockaddr_in local = {.sin_family = AF_INET,
+                                    .sin_addr = opt.src[t->src_next++ % (unsigned)opt.nsrc]};
+        if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+            if (errno == EADDRNOTAVAIL) t->r.addr_exhausted++;
+            else t->r.errors++;
+            close(fd);
+            return;
+        }
+    }
+
+    int idx = t->free_idx[--t->nfree];
+    struct slot *s = &t->slots[idx];
+    s->fd = fd;
+    s->state = SLOT_CONNECTING;
+    s->got_first = 0;
+    s->t_start = now;
+
+    if (connect(fd, (struct sockaddr *)&opt.target, sizeof(opt.target)) < 0 &&
+        errno != EINPROGRESS) {
+        slot_fail(t, idx, errno);
+        return;
+    }
+    struct epoll_event ev = {.events = EPOLLOUT, .data.u64 = (uint64_t)idx};
+    if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) slot_fail(t, idx, errno);
+}
+
+static void on_writable(struct cps_thread *t, int idx, uint64_t now) {
+    struct slot *s = &t->slots[idx];
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err) {
+        slot_fail(t, idx, err);
+        return;
+    }
+    hist_record(&t->r.handshake, now - s->t_start);
+
+    // One short line always fits an empty send buffer.
+    if (send(s->fd, request, request_len, MSG_NOSIGNAL) != (ssize_t)request_len) {
+        slot_fail(t, idx, errno);
+        return;
+    }
+    s->t_sent = now;
+    s->state = SLOT_REPLY;
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = (uint64_t)idx};
+    epoll_ctl(t->epfd, EPOLL_CTL_MOD, s->fd, &ev);
+}
+
+static void on_readable(struct cps_thread *t, int idx, uint64_t now) {
+    struct slot *s = &t->slots[idx];
+    char buf[4096];
+    for (;;) {
+        ssize_t n = recv(s->fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            slot_fail(t, idx, errno);
+            return;
+        }
+        if (n == 0) {
+            // EOF before the reply line is a failure; after it, the server's
+            // FIN is what --close server waits for.
+            if (s->state == SLOT_EOF) slot_done(t, idx, now);
+            else slot_fail(t, idx, ECONNRESET);
+            return;
+        }
+        if (s->state == SLOT_EOF) continue;
+        if (!s->got_first) {
+            s->got_first = 1;
+            hist_record(&t->r.first_byte, now - s->t_sent);
+        }
+        if (memchr(buf, '\n', (size_t)n)) {
+            s->t_reply = now;
+            if (!opt.wait_server_close) {
+                slot_done(t, idx, now);
+                return;
+            }
+            s->state = SLOT_EOF;
+        }
+    }
+}
+
+static void expire(struct cps_thread *t, uint64_t now) {
+    for (int i = 0; i < opt.max_inflight; i++) {
+        struct slot *s = &t->slots[i];
+        if (s->state != SLOT_FREE && now - s->t_start > CPS_CONN_TIMEOUT_NS) {
+            t->r.timeouts++;
+            slot_finish(t, i);
+        }
+    }
+}
+
+static void expire_all(struct cps_thread *t) {
+    for (int i = 0; i < opt.max_inflight; i++) {
+        if (t->slots[i].state != SLOT_FREE) {
+            t->r.timeouts++;
+            slot_finish(t, i);
+        }
+    }
+}
+
+// ============================================================================
+// One step on one thread
+// ============================================================================
+static void run_step(struct cps_thread *t) {
+    uint64_t start = bench_now_ns();
+    uint64_t end = start + (uint64_t)(opt.step_secs * 1e9);
+    double per_thread = step_target / opt.threads;
+    uint64_t interval = (uint64_t)(1e9 / per_thread);
+    if (interval == 0) interval = 1;
+    // Stagger threads so their launches interleave instead of bunching.
+    uint64_t next = start + interval * (uint64_t)t->id / (uint64_t)opt.threads;
+    uint64_t next_expire = start + 100000000ull;
+
+    struct epoll_event evs[256];
+    for (;;) {
+        uint64_t now = bench_now_ns();
+        while (next <= now && next < end) {
+            launch(t, now);
+            next += interval;
+        }
+        int inflight = opt.max_inflight - t->nfree;
+        if (now >= end && inflight == 0) break;
+        if (now >= end + CPS_DRAIN_NS) {
+            expire_all(t);
+            break;
+        }
+        if (now >= next_expire) {
+            expire(t, now);
+            next_expire = now + 100000000ull;
+        }
+
+        int timeout_ms = 10;
+        if (next < end) {
+            uint64_t wait = next > now ? next - now : 0;
+            timeout_ms = (int)((wait + 999999) / 1000000);
+            if (timeout_ms > 10) timeout_ms = 10;
+        }
+        int n = epoll_wait(t->epfd, evs, 256, timeout_ms);
+        now = bench_now_ns();
+        for (int i = 0; i < n; i++) {
+            int idx = (int)evs[i].data.u64;
+            struct slot *s = &t->slots[idx];
+            if (s->state == SLOT_CONNECTING) on_writable(t, idx, now);
+            else if (s->state != SLOT_FREE) on_readable(t, idx, now);
+        }
+    }
+}
+
+static void *cps_thread_main(void *arg) {
+    struct cps_thread *t = arg;
+    for (;;) {
+        pthread_barrier_wait(&step_go);
+        if (atomic_load(&finished)) return NULL;
+        run_step(t);
+        pthread_barrier_wait(&step_done);
+    }
+}
+
+// ============================================================================
+// Driver: step the rate, aggregate, report
+// ============================================================================
+struct server_sample {
+    unsigned long long accepted, overflows, drops;
+};
+
+static void sample_server(struct server_sample *s) {
+    s->overflows = bench_tcpext("ListenOverflows");
+    s->drops = bench_tcpext("ListenDrops");
+    s->accepted = 0;
+    if (opt.admin_port) {
+        struct stat_kv kv[BENCH_MAX_STATS];
+        int n = bench_fetch_stats(opt.admin_port, kv, BENCH_MAX_STATS);
+        if (n > 0) s->accepted = bench_stat_value(kv, n, "accepted");
+    }
+}
+
+static double ms(uint64_t ns) {
+    return (double)ns / 1e6;
+}
+
+// max/mean of the per-worker deltas; 0 when nothing moved.
+static double imbalance(const double *delta, int n) {
+    double sum = 0, max = 0;
+    for (int i = 0; i < n; i++) {
+        sum += delta[i];
+        if (delta[i] > max) max = delta[i];
+    }
+    return sum > 0 ? max * n / sum : 0;
+}
+
+int bench_run_cps(void) {
+    request_len = (size_t)snprintf(request, sizeof(request), "%s\n", opt.message);
+
+    threads = calloc((size_t)opt.threads, sizeof(*threads));
+    struct step_result *sum = malloc(sizeof(*sum));
+    if (!threads || !sum) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < opt.threads; i++) {
+        struct cps_thread *t = &threads[i];
+        t->id = i;
+        t->src_next = (unsigned)i;
+        t->epfd = epoll_create1(EPOLL_CLOEXEC);
+        t->slots = calloc((size_t)opt.max_inflight, sizeof(*t->slots));
+        t->free_idx = malloc(sizeof(int) * (size_t)opt.max_inflight);
+        if (t->epfd < 0 || !t->slots || !t->free_idx) {
+            perror("cps setup");
+            return 1;
+        }
+        for (int k = 0; k < opt.max_inflight; k++) {
+            t->slots[k].fd = -1;
+            t->free_idx[k] = opt.max_inflight - 1 - k;
+        }
+        t->nfree = opt.max_inflight;
+    }
+
+    FILE *csv = NULL;
+    if (opt.csv_path) {
+        csv = fopen(opt.csv_path, "w");
+        if (!csv) {
+            perror(opt.csv_path);
+            return 1;
+        }
+        fprintf(csv, "target_cps,achieved_cps,ok,errors,addr_exhausted,timeouts,missed,"
+                     "handshake_p50_ms,handshake_p99_ms,first_byte_p50_ms,first_byte_p99_ms,"
+                     "close_p50_ms,close_p99_ms,total_p50_ms,total_p99_ms,total_max_ms,"
+                     "server_accepted,listen_overflows,listen_drops,sustained\n");
+    }
+
+    pthread_barrier_init(&step_go, NULL, (unsigned)opt.threads + 1);
+    pthread_barrier_init(&step_done, NULL, (unsigned)opt.threads + 1);
+    for (int i = 0; i < opt.threads; i++) {
+        pthread_create(&threads[i].tid, NULL, cps_thread_main, &threads[i]);
+    }
+
+    printf("mode=cps threads=%d step=%.1fs slo=p99<%.1fms close=%s src=%d max-inflight=%d\n",
+           opt.threads, opt.step_secs, opt.slo_ms,
+           opt.wait_server_close ? "server" : "client", opt.nsrc, opt.max_inflight);
+    printf("%8s %8s %6s %6s | %15s %15s %15s %15s | %8s %6s %6s\n", "target", "achieved",
+           "err", "eaddr", "handshake", "first-byte", "close", "total", "accepted",
+           "ovfl", "drops");
+    printf("%8s %8s %6s %6s | %15s %15s %15s %15s |\n", "cps", "cps", "", "",
+           "p50/p99 ms", "p50/p99 ms", "p50/p99 ms", "p50/p99 ms");
+
+    struct worker_kv wk_before[BENCH_MAX_THREADS], wk_after[BENCH_MAX_THREADS];
+    int nworkers = opt.admin_port ? bench_fetch_workers(opt.admin_port, wk_before,
+                                                        BENCH_MAX_THREADS) : 0;
+    double last_fb50 = 0, last_fb99 = 0;
+    double best = 0;
+    int misses = 0;
+    int profiled = 0;
+    for (double target = opt.cps_start; target <= opt.cps_max + 1e-9; target += opt.cps_step) {
+        step_target = target;
+        for (int i = 0; i < opt.threads; i++) memset(&threads[i].r, 0, sizeof(threads[i].r));
+
+        struct server_sample before, after;
+        sample_server(&before);
+        uint64_t t0 = bench_now_ns();
+        pthread_barrier_wait(&step_go);
+
+        if (opt.profile_path && !profiled && target >= opt.profile_at && opt.admin_port) {
+            profiled = 1;
+            FILE *pf = fopen(opt.profile_path, "w");
+            if (pf) {
+                char cmd[64];
+                unsigned secs = opt.step_secs < 1 ? 1u : (unsigned)opt.step_secs;
+                snprintf(cmd, sizeof(cmd), "PROFILE %u", secs);
+                if (bench_admin_to_file(opt.admin_port, cmd, pf) < 0) {
+                    fprintf(stderr, "profile: admin port unreachable\n");
+                }
+                fclose(pf);
+            } else {
+                perror(opt.profile_path);
+            }
+        }
+
+        pthread_barrier_wait(&step_done);
+        double elapsed = (double)(bench_now_ns() - t0) / 1e9;
+        sample_server(&after);
+
+        memset(sum, 0, sizeof(*sum));
+        for (int i = 0; i < opt.threads; i++) {
+            const struct step_result *r = &threads[i].r;
+            sum->ok += r->ok;
+            sum->errors += r->errors;
+            sum->addr_exhausted += r->addr_exhausted;
+            sum->timeouts += r->timeouts;
+            sum->missed += r->missed;
+            hist_merge(&sum->handshake, &r->handshake);
+            hist_merge(&sum->first_byte, &r->first_byte);
+            hist_merge(&sum->close, &r->close);
+            hist_merge(&sum->total, &r->total);
+        }
+        // Rate over the scheduled window; the drain tail is not extra capacity.
+        double achieved = (double)sum->ok / (opt.step_secs < elapsed ? opt.step_secs : elapsed);
+        uint64_t failed = sum->errors + sum->addr_exhausted + sum->timeouts + sum->missed;
+        uint64_t attempts = sum->ok + failed;
+        int sustained = achieved >= 0.95 * target && failed * 1000 <= attempts &&
+                        ms(hist_percentile(&sum->total, 99)) <= opt.slo_ms;
+        if (sustained) {
+            if (achieved > best) {
+                last_fb50 = ms(hist_percentile(&sum->first_byte, 50));
+                last_fb99 = ms(hist_percentile(&sum->first_byte, 99));
+            }
+            best = achieved > best ? achieved : best;
+            misses = 0;
+        } else {
+            misses++;
+        }
+
+        printf("%8.0f %8.0f %6llu %6llu | %7.2f/%-7.2f %7.2f/%-7.2f %7.2f/%-7.2f %7.2f/%-7.2f"
+               " | %8llu %6llu %6llu %s\n",
+               target, achieved, (unsigned long long)(sum->errors + sum->timeouts + sum->missed),
+               (unsigned long long)sum->addr_exhausted,
+               ms(hist_percentile(&sum->handshake, 50)), ms(hist_percentile(&sum->handshake, 99)),
+               ms(hist_percentile(&sum->first_byte, 50)), ms(hist_percentile(&sum->first_byte, 99)),
+               ms(hist_percentile(&sum->close, 50)), ms(hist_percentile(&sum->close, 99)),
+               ms(hist_percentile(&sum->total, 50)), ms(hist_percentile(&sum->total, 99)),
+               after.accepted - before.accepted, after.overflows - before.overflows,
+               after.drops - before.drops, sustained ? "" : "  <- not sustained");
+        fflush(stdout);
+        if (csv) {
+            fprintf(csv,
+                    "%.0f,%.0f,%llu,%llu,%llu,%llu,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,"
+                    "%.3f,%.3f,%.3f,%llu,%llu,%llu,%d\n",
+                    target, achieved, (unsigned long long)sum->ok,
+                    (unsigned long long)sum->errors, (unsigned long long)sum->addr_exhausted,
+                    (unsigned long long)sum->timeouts, (unsigned long long)sum->missed,
+                    ms(hist_percentile(&sum->handshake, 50)),
+                    ms(hist_percentile(&sum->handshake, 99)),
+                    ms(hist_percentile(&sum->first_byte, 50)),
+                    ms(hist_percentile(&sum->first_byte, 99)),
+                    ms(hist_percentile(&sum->close, 50)), ms(hist_percentile(&sum->close, 99)),
+                    ms(hist_percentile(&sum->total, 50)), ms(hist_percentile(&sum->total, 99)),
+                    ms(sum->total.max), after.accepted - before.accepted,
+                    after.overflows - before.overflows, after.drops - before.drops, sustained);
+            fflush(csv);
+        }
+        if (misses >= 2) break;
+    }
+
+    atomic_store(&finished, 1);
+    pthread_barrier_wait(&step_go);
+    for (int i = 0; i < opt.threads; i++) pthread_join(threads[i].tid, NULL);
+    if (csv) fclose(csv);
+
+    unsigned long long tw_server, tw_client;
+    bench_count_timewait(ntohs(opt.target.sin_port), &tw_server, &tw_client);
+    printf("max sustainable %.0f conn/s (p99 total < %.1f ms)\n", best, opt.slo_ms);
+    printf("time_wait    server-side %llu, client-side %llu (this host, now)\n",
+           tw_server, tw_client);
+    if (opt.profile_path && profiled) printf("profile      %s\n", opt.profile_path);
+
+    double accept_imb = 0, cpu_imb = 0;
+    if (nworkers > 0 && bench_fetch_workers(opt.admin_port, wk_after, BENCH_MAX_THREADS) ==
+                            nworkers) {
+        double acc[BENCH_MAX_THREADS], cpu[BENCH_MAX_THREADS];
+        printf("workers     ");
+        for (int i = 0; i < nworkers; i++) {
+            acc[i] = (double)(wk_after[i].accepted - wk_before[i].accepted);
+            cpu[i] = wk_after[i].cpu - wk_before[i].cpu;
+            printf(" %d:%.0f/%.2fs", i, acc[i], cpu[i]);
+        }
+        accept_imb = imbalance(acc, nworkers);
+        cpu_imb = imbalance(cpu, nworkers);
+        printf("\nbalance      accepted max/mean %.2f, cpu max/mean %.2f\n", accept_imb, cpu_imb);
+    }
+    printf("RESULT best_cps=%.0f first_byte_p50_ms=%.3f first_byte_p99_ms=%.3f"
+           " accept_imbalance=%.2f cpu_imbalance=%.2f\n",
+           best, last_fb50, last_fb99, accept_imb, cpu_imb);
+    return best > 0 ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+// ============================================================================
+// raw_bench --mode echo — message throughput over persistent connections
+// ----------------------------------------------------------------------------
+// Each thread opens --conns keepalive connections (server keepalive = 1) and
+// keeps --depth requests outstanding on each: every reply line completes the
+// oldest request on that connection and immediately sends the next. This
+// isolates the per-message cost of the server (read, frame, reply, write)
+// from the per-connection cost the conn/cps modes measure, which is what a
+// cores-vs-throughput curve needs.
+//
+// With --admin, server "msgs" and process CPU time (cpu_user_ms + cpu_sys_ms)
+// are sampled around the run, giving messages per server CPU-second: if that
+// number falls as workers are added, the extra cores are being spent on
+// contention rather than work. The sys_* counters give syscalls per message
+// over the same window, the direct measure of kernel crossings per echo.
+//
+// With --lib the same connections and depth are driven through libraw
+// (lib/raw.h) instead: one client per thread with a pool of --conns and
+// max_inflight = --depth, every callback sending the next request. This
+// process's own CPU time per message is reported either way, so the two runs
+// show what the library costs on top of hand-rolled sockets, and whether the
+// client rather than the server is the bottleneck; requests per send()
+// shows how much the library's batching saves.
+//
+// --deadline MS puts an "@MS " budget on every request (server deadlines =
+// 1). Overloading the server with a short budget then shows how many
+// requests it dropped as expired instead of serving them late, and the
+// latency of the rest.
+//
+// The last line is a single "RESULT key=value ..." record for scripts
+// (tools/scale.sh).
+// ============================================================================
+#define _GNU_SOURCE
+#include "bench.h"
+#include "../lib/raw.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define ECHO_MAX_DEPTH 64
+
+struct echo_conn {
+    int fd;
+    unsigned head, tail;                    // ring of send timestamps
+    uint64_t sent_at[ECHO_MAX_DEPTH];
+};
+
+struct echo_thread {
+    pthread_t tid;
+    struct echo_conn *conns;
+    uint64_t ok, errors;
+    uint64_t writes;                        // send() calls
+    unsigned lib_idle;                      // --lib: requests raw_send() refused
+    struct hist lat;
+};
+
+static _Atomic int stop;
+static char request[4096];
+static size_t request_len;
+
+static int echo_send(struct echo_thread *t, struct echo_conn *c) {
+    t->writes++;
+    if (send(c->fd, request, request_len, MSG_NOSIGNAL) != (ssize_t)request_len) return -1;
+    c->sent_at[c->tail++ % ECHO_MAX_DEPTH] = bench_now_ns();
+    return 0;
+}
+
+static int echo_open(struct echo_thread *t, struct echo_conn *c, int epfd, int idx) {
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    c->head = c->tail = 0;
+    if (c->fd < 0) return -1;
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c->fd, (struct sockaddr *)&opt.target, sizeof(opt.target)) < 0) goto fail;
+    for (int i = 0; i < opt.echo_depth; i++) {
+        if (echo_send(t, c) < 0) goto fail;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = (uint64_t)idx};
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) goto fail;
+    return 0;
+fail:
+    close(c->fd);
+    c->fd = -1;
+    return -1;
+}
+
+// Reads what is available, completing one request per '\n'. Returns -1 when
+// the connection is unusable.
+static int echo_readable(struct echo_thread *t, struct echo_conn *c) {
+    char buf[16384];
+    ssize_t n = recv(c->fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n < 0) return errno == EAGAIN ? 0 : -1;
+    if (n == 0) return -1;
+    uint64_t now = bench_now_ns();
+    for (char *p = buf, *end = buf + n; (p = memchr(p, '\n', (size_t)(end - p))); p++) {
+        if (c->head == c->tail) return -1;          // reply nobody asked for
+        hist_record(&t->lat, now - c->sent_at[c->head++ % ECHO_MAX_DEPTH]);
+        t->ok++;
+        if (!atomic_load_explicit(&stop, memory_order_relaxed) && echo_send(t, c) < 0) return -1;
+    }
+    return 0;
+}
+
+static void *echo_thread_main(void *arg) {
+    struct echo_thread *t = arg;
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    t->conns = calloc((size_t)opt.echo_conns, sizeof(*t->conns));
+    if (epfd < 0 || !t->conns) {
+        t->errors++;
+        return NULL;
+    }
+    for (int i = 0; i < opt.echo_conns; i++) {
+        if (echo_open(t, &t->conns[i], epfd, i) < 0) t->errors++;
+    }
+
+    struct epoll_event evs[256];
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        int n = epoll_wait(epfd, evs, 256, 100);
+        for (int i = 0; i < n; i++) {
+            struct echo_conn *c = &t->conns[evs[i].data.u64];
+            if (c->fd >= 0 && echo_readable(t, c) < 0) {
+                // Reconnect so a dropped connection does not shrink the load.
+                t->errors++;
+                close(c->fd);
+                echo_open(t, c, epfd, (int)evs[i].data.u64);
+            }
+        }
+    }
+    for (int i = 0; i < opt.echo_conns; i++) {
+        if (t->conns[i].fd >= 0) close(t->conns[i].fd);
+    }
+    free(t->conns);
+    close(epfd);
+    return NULL;
+}
+
+// ============================================================================
+// --lib: the same load through libraw
+// ============================================================================
+struct lib_request {
+    struct echo_thread *t;
+    struct raw_client *rc;
+    uint64_t sent_at;
+    int idle;                               // not in flight: send it again
+};
+
+static void lib_send(struct lib_request *r);
+
+static void lib_done(void *arg, int status, const char *reply, size_t len) {
+    struct lib_request *r = arg;
+    (void)reply;
+    (void)len;
+    if (status == RAW_OK) {
+        hist_record(&r->t->lat, bench_now_ns() - r->sent_at);
+        r->t->ok++;
+    } else {
+        r->t->errors++;
+    }
+    r->idle = 1;
+    if (!atomic_load_explicit(&stop, memory_order_relaxed)) lib_send(r);
+}
+
+static void lib_send(struct lib_request *r) {
+    r->sent_at = bench_now_ns();
+    r->idle = raw_send(r->rc, request, request_len, lib_done, r) < 0;
+    r->t->lib_idle += (unsigned)r->idle;
+}
+
+static void *lib_thread_main(void *arg) {
+    struct echo_thread *t = arg;
+    struct raw_options o;
+    raw_options_init(&o);
+    o.pool_size = opt.echo_conns;
+    o.max_inflight = opt.echo_depth;
+    o.request_timeout_ms = 5000;
+    char target[64];
+    snprintf(target, sizeof(target), "%s:%u", inet_ntoa(opt.target.sin_addr),
+             ntohs(opt.target.sin_port));
+    size_t nreq = (size_t)opt.echo_conns * (size_t)opt.echo_depth;
+    struct raw_client *rc = raw_client_new(target, &o);
+    struct lib_request *reqs = calloc(nreq, sizeof(*reqs));
+    if (!rc || !reqs) {
+        t->errors++;
+        raw_client_free(rc);
+        free(reqs);
+        return NULL;
+    }
+    for (size_t i = 0; i < nreq; i++) {
+        reqs[i].t = t;
+        reqs[i].rc = rc;
+        lib_send(&reqs[i]);
+    }
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        if (raw_poll(rc, 100) < 0) {
+            t->errors++;
+            break;
+        }
+        // Requests raw_send() refused (pool reconnecting) go out again.
+        if (t->lib_idle) {
+            t->lib_idle = 0;
+            for (size_t i = 0; i < nreq; i++) {
+                if (reqs[i].idle) lib_send(&reqs[i]);
+            }
+        }
+    }
+    struct raw_client_stats st;
+    raw_client_stats(rc, &st);
+    t->writes = st.writes;
+    raw_client_free(rc);
+    free(reqs);
+    return NULL;
+}
+
+static double cpu_seconds(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1e6 +
+           (double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec / 1e6;
+}
+
+struct server_sample {
+    unsigned long long msgs, cpu_ms, syscalls, expired;
+    int ok;
+};
+
+static const char *const syscall_keys[] = {"sys_recv", "sys_send", "sys_accept", "sys_close",
+                                           "sys_epoll_wait", "sys_epoll_ctl", "sys_uring_enter",
+                                           "sys_other"};
+
+static void sample_server(struct server_sample *s) {
+    struct stat_kv kv[BENCH_MAX_STATS];
+    int n = opt.admin_port ? bench_fetch_stats(opt.admin_port, kv, BENCH_MAX_STATS) : -1;
+    s->ok = n > 0;
+    if (!s->ok) return;
+    s->msgs = bench_stat_value(kv, n, "msgs");
+    s->expired = bench_stat_value(kv, n, "deadline_expired");
+    s->cpu_ms = bench_stat_value(kv, n, "cpu_user_ms") + bench_stat_value(kv, n, "cpu_sys_ms");
+    s->syscalls = 0;
+    for (size_t i = 0; i < sizeof(syscall_keys) / sizeof(syscall_keys[0]); i++) {
+        s->syscalls += bench_stat_value(kv, n, syscall_keys[i]);
+    }
+}
+
+int bench_run_echo(void) {
+    // libraw appends the delimiter itself.
+    request_len = 0;
+    if (opt.echo_deadline_ms > 0) {
+        request_len = (size_t)snprintf(request, sizeof(request), "@%d ", opt.echo_deadline_ms);
+    }
+    request_len += (size_t)snprintf(request + request_len, sizeof(request) - request_len,
+                                    opt.echo_lib ? "%s" : "%s\n", opt.message);
+    struct echo_thread *threads = calloc((size_t)opt.threads, sizeof(*threads));
+    struct hist *lat = calloc(1, sizeof(*lat));
+    if (!threads || !lat) {
+        perror("calloc");
+        return 1;
+    }
+
+    struct server_sample before, after;
+    sample_server(&before);
+    uint64_t t0 = bench_now_ns();
+    double cpu0 = cpu_seconds();
+    for (int i = 0; i < opt.threads; i++) {
+        pthread_create(&threads[i].tid, NULL, opt.echo_lib ? lib_thread_main : echo_thread_main,
+                       &threads[i]);
+    }
+    struct timespec nap = {(time_t)opt.duration,
+                           (long)((opt.duration - (double)(time_t)opt.duration) * 1e9)};
+    nanosleep(&nap, NULL);
+    atomic_store(&stop, 1);
+    uint64_t ok = 0, errors = 0, writes = 0;
+    for (int i = 0; i < opt.threads; i++) {
+        pthread_join(threads[i].tid, NULL);
+        ok += threads[i].ok;
+        errors += threads[i].errors;
+        writes += threads[i].writes;
+        hist_merge(lat, &threads[i].lat);
+    }
+    double elapsed = (double)(bench_now_ns() - t0) / 1e9;
+    double client_cpu = cpu_seconds() - cpu0;
+    sample_server(&after);
+
+    double rate = (double)ok / elapsed;
+    double p50 = (double)hist_percentile(lat, 50) / 1e6;
+    double p99 = (double)hist_percentile(lat, 99) / 1e6;
+    double p999 = (double)hist_percentile(lat, 99.9) / 1e6;
+    printf("mode=echo%s threads=%d conns=%d depth=%d duration=%.1fs\n",
+           opt.echo_lib ? " (libraw)" : "", opt.threads, opt.threads * opt.echo_conns,
+           opt.echo_depth, elapsed);
+    printf("messages     %llu ok, %llu errors, %.0f msg/s\n", (unsigned long long)ok,
+           (unsigned long long)errors, rate);
+    printf("latency      p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n", p50, p99,
+           p999, (double)lat->max / 1e6);
+
+    double client_ns = ok ? client_cpu * 1e9 / (double)ok : 0;
+    double per_write = writes ? (double)ok / (double)writes : 0;
+    printf("client       %.2f CPU-s (%.2f cores), %.0f ns CPU per msg, %.2f msgs per send()\n",
+           client_cpu, client_cpu / elapsed, client_ns, per_write);
+
+    double per_cpu = 0, server_cpu = 0, per_msg = 0;
+    if (before.ok && after.ok) {
+        server_cpu = (double)(after.cpu_ms - before.cpu_ms) / 1000.0;
+        unsigned long long msgs = after.msgs - before.msgs;
+        per_cpu = server_cpu > 0 ? (double)msgs / server_cpu : 0;
+        per_msg = msgs ? (double)(after.syscalls - before.syscalls) / (double)msgs : 0;
+        printf("server       %llu msgs, %.2f CPU-s (%.2f cores), %.0f msgs per CPU-second, "
+               "%.2f syscalls per msg\n",
+               msgs, server_cpu, server_cpu / elapsed, per_cpu, per_msg);
+        if (opt.echo_deadline_ms > 0) {
+            unsigned long long expired = after.expired - before.expired;
+            printf("deadline     %d ms: %llu requests expired (%.2f%%), answered ERR deadline\n",
+                   opt.echo_deadline_ms, expired, msgs ? 100.0 * (double)expired / (double)msgs : 0);
+        }
+    }
+    printf("RESULT msgs_per_s=%.0f p50_ms=%.3f p99_ms=%.3f p999_ms=%.3f errors=%llu "
+           "server_cores=%.2f msgs_per_cpu_s=%.0f syscalls_per_msg=%.2f client_cores=%.2f "
+           "client_ns_per_msg=%.0f msgs_per_write=%.2f\n",
+           rate, p50, p99, p999, (unsigned long long)errors, server_cpu / elapsed, per_cpu,
+           per_msg, client_cpu / elapsed, client_ns, per_write);
+    return ok == 0;
+}
@@ -0,0 +1,32 @@
+# ============================================================================
+# bench_lib.sh — shared setup for the benchmark drivers in tools/
+# ----------------------------------------------------------------------------
+# Sourced (not run) right after a driver's own settings:
+#
+#     . "$(dirname "$0")/bench_lib.sh"
+#
+# It sets BIN (the build's bin/ directory) and three temporary files: CONF
+# for the raw_server config, RESULT for raw_bench's output and LOG for the
+# server's. SERVER and HOG start empty; a driver stores the pids of the
+# server and of any background load there, and both are killed, and the
+# temporary files removed, however the script exits.
+# ============================================================================
+
+BIN=$(dirname "$0")/../bin
+CONF=$(mktemp)
+RESULT=$(mktemp)
+LOG=$(mktemp)
+SERVER=
+HOG=
+cleanup() {
+    [ -n "$HOG" ] && kill "$HOG" 2>/dev/null || true
+    [ -n "$SERVER" ] && kill "$SERVER" 2>/dev/null || true
+    rm -f "$CONF" "$RESULT" "$LOG"
+}
+trap cleanup EXIT INT TERM
+
+# field NAME: the value of NAME=... on the RESULT line in the file $RESULT,
+# or nothing if raw_bench did not report it.
+field() {
+    sed -n "s/^RESULT.* $1=\([^ ]*\).*/\1/p; s/^RESULT $1=\([^ ]*\).*/\1/p" "$RESULT" | head -n 1
+}
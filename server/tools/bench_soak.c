@@ -0,0 +1,372 @@
+// ============================================================================
+// raw_bench --mode soak — long-running mixed traffic with drift tracking
+// ----------------------------------------------------------------------------
+// A benchmark run answers "how fast"; a soak run answers "does it stay that
+// way". Leaks and slow degradations (an fd not closed on a rare error path, a
+// pool that never shrinks, a list that grows with every migration) only show
+// up after hours of varied traffic, so this mode:
+//
+//   1) Drives a paced mix of client behaviours from every thread, covering
+//      the server's uncommon paths as well as the happy one:
+//        normal      connect, one line, read reply, close         (60%)
+//        split       the line arrives in two writes               (10%)
+//        half_close  shutdown(SHUT_WR) right after the request    (10%)
+//        too_long    a line over max_msg_len                      ( 5%)
+//        empty       a bare "\n"                                  ( 5%)
+//        reset       partial line, then RST (SO_LINGER 0)         ( 5%)
+//        idle        connect, stay silent for a while, then send  ( 5%)
+//   2) Every --interval seconds samples the server through the admin port
+//      (rss_kb, open_fds, conns, pool_free, pool_malloc, timewait_server,
+//      msgs) and this side's latency percentiles for the interval, and
+//      appends a row to the CSV (--csv, default soak.csv).
+//   3) At the end compares the series for monotonic growth or drift (see
+//      trend()) and exits non-zero if anything is flagged.
+//
+// Latency is recorded for the normal scenario only (connect → reply line),
+// so the percentiles are comparable across intervals whatever the mix does.
+// ============================================================================
+#define _GNU_SOURCE
+#include "bench.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define SOAK_MAX_SAMPLES 100000
+#define SOAK_IO_TIMEOUT_MS 3000
+#define SOAK_BIG_LEN 5000           // over MSG_LEN_CAP, so too long for any config
+
+enum scenario { SC_NORMAL, SC_SPLIT, SC_HALF_CLOSE, SC_TOO_LONG, SC_EMPTY, SC_RESET,
+                SC_IDLE, SC_COUNT };
+
+// Cumulative weights out of 100, in enum order.
+static const int scenario_cdf[SC_COUNT] = {60, 70, 80, 85, 90, 95, 100};
+
+struct soak_thread {
+    pthread_t tid;
+    unsigned seed;
+    pthread_mutex_t lock;       // guards the interval fields below
+    struct hist lat;
+    uint64_t ok, errors;
+};
+
+static struct soak_thread *threads;
+static _Atomic int stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    atomic_store(&stop, 1);
+}
+
+// ============================================================================
+// Client behaviours
+// ============================================================================
+static int dial(void) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    struct timeval tv = {SOAK_IO_TIMEOUT_MS / 1000, (SOAK_IO_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    if (connect(fd, (struct sockaddr *)&opt.target, sizeof(opt.target)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int send_all(int fd, const char *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Reads until a full line arrives (1) or the server closes (0); -1 on error.
+static int read_line(int fd) {
+    char buf[4096];
+    for (;;) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0) return -1;
+        if (n == 0) return 0;
+        if (memchr(buf, '\n', (size_t)n)) return 1;
+    }
+}
+
+static void drain(int fd) {
+    char buf[4096];
+    while (recv(fd, buf, sizeof(buf), 0) > 0) {
+    }
+}
+
+static void nap_ms(unsigned ms) {
+    struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000};
+    nanosleep(&ts, NULL);
+}
+
+static int run_scenario(enum scenario sc, struct soak_thread *t, const char *msg,
+                        size_t len) {
+    uint64_t t0 = bench_now_ns();
+    int fd = dial();
+    if (fd < 0) return -1;
+    int rc = -1;
+
+    switch (sc) {
+    case SC_NORMAL:
+        if (send_all(fd, msg, len) < 0 || read_line(fd) != 1) break;
+        pthread_mutex_lock(&t->lock);
+        hist_record(&t->lat, bench_now_ns() - t0);
+        pthread_mutex_unlock(&t->lock);
+        rc = 0;
+        break;
+    case SC_SPLIT:
+        if (send_all(fd, msg, len / 2) < 0) break;
+        nap_ms(1 + rand_r(&t->seed) % 20);
+        if (send_all(fd, msg + len / 2, len - len / 2) < 0) break;
+        rc = read_line(fd) == 1 ? 0 : -1;
+        break;
+    case SC_HALF_CLOSE:
+        if (send_all(fd, msg, len) < 0) break;
+        shutdown(fd, SHUT_WR);
+        rc = read_line(fd) == 1 ? 0 : -1;
+        break;
+    case SC_TOO_LONG: {
+        // The server answers with an error line and/or closes, possibly with
+        // RST while the tail is still in flight; only a hang is a failure.
+        char big[SOAK_BIG_LEN + 1];
+        memset(big, 'x', SOAK_BIG_LEN);
+        big[SOAK_BIG_LEN] = '\n';
+        send_all(fd, big, sizeof(big));
+        rc = read_line(fd) >= 0 || errno != EAGAIN ? 0 : -1;
+        break;
+    }
+    case SC_EMPTY:
+        if (send_all(fd, "\n", 1) < 0) break;
+        rc = read_line(fd) >= 0 ? 0 : -1;
+        break;
+    case SC_RESET: {
+        struct linger lg = {1, 0};
+        send_all(fd, msg, len / 2);
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        rc = 0;
+        break;
+    }
+    case SC_IDLE:
+        nap_ms(100 + rand_r(&t->seed) % 900);
+        if (send_all(fd, msg, len) < 0) break;
+        rc = read_line(fd) == 1 ? 0 : -1;
+        break;
+    case SC_COUNT:
+        break;
+    }
+    if (rc == 0 && sc != SC_RESET && opt.wait_server_close) drain(fd);
+    close(fd);
+    return rc;
+}
+
+static void *soak_thread_main(void *arg) {
+    struct soak_thread *t = arg;
+    char msg[4096];
+    size_t len = (size_t)snprintf(msg, sizeof(msg), "%s\n", opt.message);
+    // Per-thread pacing: --rate is the total for all threads.
+    uint64_t interval = (uint64_t)(1e9 * opt.threads / opt.soak_rate);
+    uint64_t next = bench_now_ns();
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        int r = (int)(rand_r(&t->seed) % 100);
+        enum scenario sc = SC_NORMAL;
+        while (r >= scenario_cdf[sc]) sc++;
+        int rc = run_scenario(sc, t, msg, len);
+        pthread_mutex_lock(&t->lock);
+        if (rc == 0) t->ok++;
+        else t->errors++;
+        pthread_mutex_unlock(&t->lock);
+
+        next += interval;
+        uint64_t now = bench_now_ns();
+        if (next > now) {
+            struct timespec ts = {(time_t)((next - now) / 1000000000ull),
+                                  (long)((next - now) % 1000000000ull)};
+            nanosleep(&ts, NULL);
+        } else if (now - next > 1000000000ull) {
+            next = now;                     // fell behind; don't burst to catch up
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Sampling
+// ============================================================================
+enum series { S_RSS, S_FDS, S_CONNS, S_POOL, S_P99, S_COUNT };
+static const char *const series_name[S_COUNT] = {"rss_kb", "open_fds", "conns",
+                                                 "pool_total", "p99_ms"};
+
+struct sample {
+    double elapsed;
+    double v[S_COUNT];
+};
+
+static struct sample *samples;
+static int nsamples;
+
+// ============================================================================
+// Drift detection
+// ----------------------------------------------------------------------------
+// Two tests per series, over samples after the warm-up (first 10% of the
+// run, when pools fill and caches warm):
+//   - Mann-Kendall tau: over all sample pairs (i < j), the fraction that go
+//     up minus the fraction that go down. +1 is strictly monotonic growth;
+//     noise around a flat level stays near 0. Robust to outliers and needs
+//     no model of the growth.
+//   - Relative change: mean of the last quarter vs the first quarter, so a
+//     consistent but negligible rise (a few KB of RSS) is not flagged.
+// A series is flagged when tau > 0.5 and it grew more than its tolerance.
+// ============================================================================
+static double tolerance(enum series s) {
+    switch (s) {
+    case S_P99: return 0.25;            // latency is noisy
+    case S_CONNS: return 0.50;          // load-dependent; only gross growth
+    default: return 0.10;
+    }
+}
+
+static int trend(enum series s, int from, double *tau_out, double *change_out) {
+    int n = nsamples - from;
+    *tau_out = *change_out = 0;
+    if (n < 8) return 0;
+    long long score = 0;
+    for (int i = from; i < nsamples; i++) {
+        for (int j = i + 1; j < nsamples; j++) {
+            double d = samples[j].v[s] - samples[i].v[s];
+            score += (d > 0) - (d < 0);
+        }
+    }
+    double tau = (double)score / ((double)n * (n - 1) / 2);
+
+    int q = n / 4;
+    double first = 0, last = 0;
+    for (int i = 0; i < q; i++) {
+        first += samples[from + i].v[s];
+        last += samples[nsamples - q + i].v[s];
+    }
+    first /= q;
+    last /= q;
+    double change = first > 0 ? (last - first) / first : (last > 0 ? INFINITY : 0);
+    *tau_out = tau;
+    *change_out = change;
+    return tau > 0.5 && change > tolerance(s);
+}
+
+// ============================================================================
+// Driver
+// ============================================================================
+int bench_run_soak(void) {
+    if (!opt.admin_port) {
+        fprintf(stderr, "soak: --admin is required (server resources come from STATS)\n");
+        return 2;
+    }
+    const char *csv_path = opt.csv_path ? opt.csv_path : "soak.csv";
+    FILE *csv = fopen(csv_path, "w");
+    samples = calloc(SOAK_MAX_SAMPLES, sizeof(*samples));
+    threads = calloc((size_t)opt.threads, sizeof(*threads));
+    if (!csv || !samples || !threads) {
+        perror(csv ? "calloc" : csv_path);
+        return 2;
+    }
+    fprintf(csv, "elapsed_s,rss_kb,open_fds,conns,pool_free,pool_malloc,timewait_server,"
+                 "msgs_per_s,ok,errors,p50_ms,p99_ms,p999_ms,max_ms\n");
+
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    for (int i = 0; i < opt.threads; i++) {
+        threads[i].seed = (unsigned)(0x9e3779b9u * (unsigned)(i + 1));
+        pthread_mutex_init(&threads[i].lock, NULL);
+        pthread_create(&threads[i].tid, NULL, soak_thread_main, &threads[i]);
+    }
+    printf("mode=soak threads=%d rate=%.0f/s duration=%.0fs interval=%.0fs csv=%s\n",
+           opt.threads, opt.soak_rate, opt.duration, opt.soak_interval, csv_path);
+
+    static struct hist lat;             // merged per interval; too big for the stack
+    uint64_t t0 = bench_now_ns();
+    uint64_t next = t0;
+    unsigned long long last_msgs = 0;
+    int first = 1;
+    while (!atomic_load(&stop)) {
+        next += (uint64_t)(opt.soak_interval * 1e9);
+        while (!atomic_load(&stop) && bench_now_ns() < next) nap_ms(100);
+        double elapsed = (double)(bench_now_ns() - t0) / 1e9;
+
+        memset(&lat, 0, sizeof(lat));
+        uint64_t ok = 0, errors = 0;
+        for (int i = 0; i < opt.threads; i++) {
+            struct soak_thread *t = &threads[i];
+            pthread_mutex_lock(&t->lock);
+            hist_merge(&lat, &t->lat);
+            memset(&t->lat, 0, sizeof(t->lat));
+            ok += t->ok;
+            errors += t->errors;
+            t->ok = t->errors = 0;
+            pthread_mutex_unlock(&t->lock);
+        }
+
+        struct stat_kv kv[BENCH_MAX_STATS];
+        int n = bench_fetch_stats(opt.admin_port, kv, BENCH_MAX_STATS);
+        if (n <= 0) {
+            fprintf(stderr, "soak: admin port unreachable at %.0fs — server gone?\n", elapsed);
+            atomic_store(&stop, 1);
+            break;
+        }
+        unsigned long long msgs = bench_stat_value(kv, n, "msgs");
+        double rate = first ? 0 : (double)(msgs - last_msgs) / opt.soak_interval;
+        last_msgs = msgs;
+        first = 0;
+
+        struct sample *s = &samples[nsamples < SOAK_MAX_SAMPLES ? nsamples++ : nsamples - 1];
+        s->elapsed = elapsed;
+        s->v[S_RSS] = (double)bench_stat_value(kv, n, "rss_kb");
+        s->v[S_FDS] = (double)bench_stat_value(kv, n, "open_fds");
+        s->v[S_CONNS] = (double)bench_stat_value(kv, n, "conns");
+        s->v[S_POOL] = s->v[S_CONNS] + (double)bench_stat_value(kv, n, "pool_free");
+        s->v[S_P99] = (double)hist_percentile(&lat, 99) / 1e6;
+
+        fprintf(csv, "%.0f,%.0f,%.0f,%.0f,%llu,%llu,%llu,%.0f,%llu,%llu,%.3f,%.3f,%.3f,%.3f\n",
+                elapsed, s->v[S_RSS], s->v[S_FDS], s->v[S_CONNS],
+                bench_stat_value(kv, n, "pool_free"), bench_stat_value(kv, n, "pool_malloc"),
+                bench_stat_value(kv, n, "timewait_server"), rate, (unsigned long long)ok,
+                (unsigned long long)errors, (double)hist_percentile(&lat, 50) / 1e6,
+                s->v[S_P99], (double)hist_percentile(&lat, 99.9) / 1e6, (double)lat.max / 1e6);
+        fflush(csv);
+        printf("%7.0fs rss=%.0fkB fds=%.0f conns=%.0f pool=%.0f %.0f msg/s err=%llu "
+               "p99=%.2fms\n",
+               elapsed, s->v[S_RSS], s->v[S_FDS], s->v[S_CONNS], s->v[S_POOL], rate,
+               (unsigned long long)errors, s->v[S_P99]);
+        fflush(stdout);
+        if (elapsed >= opt.duration) atomic_store(&stop, 1);
+    }
+    for (int i = 0; i < opt.threads; i++) pthread_join(threads[i].tid, NULL);
+    fclose(csv);
+
+    int warmup = nsamples / 10;
+    int flagged = 0;
+    printf("drift (after %d warm-up samples of %d):\n", warmup, nsamples);
+    for (int s = 0; s < S_COUNT; s++) {
+        double tau, change;
+        int bad = trend((enum series)s, warmup, &tau, &change);
+        flagged |= bad;
+        printf("  %-10s tau=%+.2f change=%+.1f%% %s\n", series_name[s], tau, change * 100,
+               bad ? "<- GROWING" : "ok");
+    }
+    if (nsamples - warmup < 8) printf("  (too few samples to judge; run longer)\n");
+    return flagged ? 1 : 0;
+}
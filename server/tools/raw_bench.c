@@ -0,0 +1,329 @@
+// ============================================================================
+// raw_bench — load generator for raw_server
+// ----------------------------------------------------------------------------
+// Modes:
+//   conn   connection-rate test: each thread loops connect → send one line →
+//          read the reply → close, as fast as it can (closed loop). This is
+//          the one-request-per-connection flow the server implements by
+//          default, so it stresses accept(), FIN handling and TIME_WAIT.
+//   cps    open-loop connection-rate sweep: connections are launched on a
+//          schedule, the rate is stepped up until latency or errors break the
+//          SLO, and the maximum sustainable conn/s is reported together with
+//          per-phase latency (see bench_cps.c).
+//   echo   message throughput: persistent keepalive connections with a fixed
+//          number of requests in flight (see bench_echo.c); with --lib the
+//          same load goes through the libraw client library.
+//   soak   hours of paced, mixed client behaviour while server RSS, fds, pool
+//          occupancy and latency are sampled to CSV and checked for drift
+//          (see bench_soak.c; `make soak` runs it against a fresh server).
+//
+// Close behaviour (--close):
+//   client  close as soon as the reply line arrives (client sends FIN first
+//           unless the server beat it to it)
+//   server  wait for the server's EOF, then close (server sends FIN first)
+//
+// When the server's admin port is given (--admin), STATS is sampled before
+// and after the run and the close-path counters are reported as deltas,
+// together with a TIME_WAIT census taken on this host.
+//
+//   $ ./bin/raw_bench --mode conn -t 4 -d 10 --admin 9001 127.0.0.1:9000
+//   $ ./bin/raw_bench --mode cps -t 2 --cps-start 2000 --cps-step 2000
+//         --cps-max 40000 --src 127.0.0.2+32 --admin 9001 --csv cps.csv
+//         127.0.0.1:9000
+#define _GNU_SOURCE
+#include "bench.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+struct thread_result {
+    uint64_t ok;
+    uint64_t errors;
+};
+
+struct options opt;
+static _Atomic int stop;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// ============================================================================
+// Connection-rate worker
+// ============================================================================
+static int one_connection(const char *msg, size_t len) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int rc = -1;
+    if (connect(fd, (struct sockaddr *)&opt.target, sizeof(opt.target)) < 0) goto out;
+    if (send(fd, msg, len, MSG_NOSIGNAL) != (ssize_t)len) goto out;
+
+    char buf[4096];
+    size_t got = 0;
+    while (got < sizeof(buf)) {
+        ssize_t n = recv(fd, buf + got, sizeof(buf) - got, 0);
+        if (n <= 0) goto out;
+        got += (size_t)n;
+        if (memchr(buf, '\n', got)) break;
+    }
+    if (opt.wait_server_close) {
+        while (recv(fd, buf, sizeof(buf), 0) > 0) {
+        }
+    }
+    rc = 0;
+out:
+    close(fd);
+    return rc;
+}
+
+static void *conn_thread(void *arg) {
+    struct thread_result *r = arg;
+    char msg[4096];
+    int len = snprintf(msg, sizeof(msg), "%s\n", opt.message);
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        if (one_connection(msg, (size_t)len) == 0) r->ok++;
+        else r->errors++;
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Driver
+// ============================================================================
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [options] <ip:port>\n"
+            "  --mode MODE          conn (default): closed-loop connection rate\n"
+            "                       cps: open-loop CPS sweep\n"
+            "                       echo: keepalive message throughput\n"
+            "                       soak: long mixed run with drift checks\n"
+            "  -t, --threads N      concurrent client threads (default 1)\n"
+            "  -d, --duration TIME  run time, seconds or with s/m/h suffix (default 5)\n"
+            "  -m, --message TEXT   request payload (default \"hello\")\n"
+            "  --close client|server  who closes first (default client)\n"
+            "  --admin PORT         server admin port for STATS deltas\n"
+            "cps mode:\n"
+            "  --cps-start N        first step's target conn/s (default 1000)\n"
+            "  --cps-step N         increment per step (default 1000)\n"
+            "  --cps-max N          last step (default 50000)\n"
+            "  --step-secs SECS     duration of each step (default 5)\n"
+            "  --slo-ms MS          p99 bound on total latency (default 10)\n"
+            "  --max-inflight N     open connections per thread (default 4096)\n"
+            "  --src LIST           local addresses, comma separated; A.B.C.D+N\n"
+            "                       means N consecutive addresses from A.B.C.D\n"
+            "  --csv FILE           write the CPS/latency curve as CSV\n"
+            "  --profile FILE       save admin PROFILE output (needs --admin)\n"
+            "  --profile-at N       ...taken during the first step >= N conn/s\n"
+            "echo mode (server keepalive = 1):\n"
+            "  --conns N            connections per thread (default 16)\n"
+            "  --depth N            requests in flight per connection (default 1)\n"
+            "  --lib                drive the connections through libraw (lib/raw.h)\n"
+            "                       instead of hand-rolled sockets\n"
+            "  --deadline MS        prefix requests with an \"@MS \" budget (server\n"
+            "                       deadlines = 1); expired ones are counted\n"
+            "soak mode (needs --admin):\n"
+            "  --rate N             connections/s across all threads (default 200)\n"
+            "  --interval SECS      sampling period (default 10)\n"
+            "  --csv FILE           samples (default soak.csv)\n",
+            prog);
+    exit(EXIT_FAILURE);
+}
+
+static void parse_target(const char *s, const char *prog) {
+    char ip[64];
+    const char *colon = strrchr(s, ':');
+    if (!colon || (size_t)(colon - s) >= sizeof(ip)) usage(prog);
+    memcpy(ip, s, (size_t)(colon - s));
+    ip[colon - s] = '\0';
+    opt.target.sin_family = AF_INET;
+    opt.target.sin_port = htons((uint16_t)atoi(colon + 1));
+    if (inet_pton(AF_INET, ip, &opt.target.sin_addr) != 1) usage(prog);
+}
+
+// "90", "90s", "15m", "4h" → seconds
+static double parse_duration(const char *s, const char *prog) {
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || v <= 0) usage(prog);
+    switch (*end) {
+    case '\0': case 's': return v;
+    case 'm': return v * 60;
+    case 'h': return v * 3600;
+    default: usage(prog);
+    }
+    return 0;
+}
+
+// "10.0.0.1,127.0.0.2+16" → 10.0.0.1, 127.0.0.2 … 127.0.0.17
+static void parse_src(const char *list, const char *prog) {
+    char *copy = strdup(list), *save = NULL;
+    for (char *tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        long count = 1;
+        char *plus = strchr(tok, '+');
+        if (plus) {
+            *plus = '\0';
+            count = strtol(plus + 1, NULL, 10);
+        }
+        struct in_addr base;
+        if (inet_pton(AF_INET, tok, &base) != 1 || count < 1) usage(prog);
+        for (long i = 0; i < count; i++) {
+            if (opt.nsrc == BENCH_MAX_SRC) usage(prog);
+            opt.src[opt.nsrc++].s_addr = htonl(ntohl(base.s_addr) + (uint32_t)i);
+        }
+    }
+    free(copy);
+}
+
+int main(int argc, char **argv) {
+    opt.mode = "conn";
+    opt.threads = 1;
+    opt.duration = 5.0;
+    opt.message = "hello";
+    opt.cps_start = 1000;
+    opt.cps_step = 1000;
+    opt.cps_max = 50000;
+    opt.step_secs = 5.0;
+    opt.slo_ms = 10.0;
+    opt.max_inflight = 4096;
+    opt.echo_conns = 16;
+    opt.echo_depth = 1;
+    opt.soak_rate = 200;
+    opt.soak_interval = 10;
+
+    static const struct option longopts[] = {
+        {"mode", required_argument, NULL, 'M'},
+        {"threads", required_argument, NULL, 't'},
+        {"duration", required_argument, NULL, 'd'},
+        {"message", required_argument, NULL, 'm'},
+        {"close", required_argument, NULL, 'C'},
+        {"admin", required_argument, NULL, 'A'},
+        {"cps-start", required_argument, NULL, 'S'},
+        {"cps-step", required_argument, NULL, 'I'},
+        {"cps-max", required_argument, NULL, 'X'},
+        {"step-secs", required_argument, NULL, 'T'},
+        {"slo-ms", required_argument, NULL, 'L'},
+        {"max-inflight", required_argument, NULL, 'F'},
+        {"src", required_argument, NULL, 'R'},
+        {"csv", required_argument, NULL, 'V'},
+        {"profile", required_argument, NULL, 'P'},
+        {"profile-at", required_argument, NULL, 'W'},
+        {"conns", required_argument, NULL, 'c'},
+        {"depth", required_argument, NULL, 'D'},
+        {"lib", no_argument, NULL, 'B'},
+        {"deadline", required_argument, NULL, 'E'},
+        {"rate", required_argument, NULL, 'r'},
+        {"interval", required_argument, NULL, 'i'},
+        {NULL, 0, NULL, 0},
+    };
+    int ch;
+    while ((ch = getopt_long(argc, argv, "t:d:m:", longopts, NULL)) != -1) {
+        switch (ch) {
+        case 'M': opt.mode = optarg; break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'd': opt.duration = parse_duration(optarg, argv[0]); break;
+        case 'm': opt.message = optarg; break;
+        case 'C':
+            if (strcmp(optarg, "server") == 0) opt.wait_server_close = 1;
+            else if (strcmp(optarg, "client") != 0) usage(argv[0]);
+            break;
+        case 'A': opt.admin_port = atoi(optarg); break;
+        case 'S': opt.cps_start = atof(optarg); break;
+        case 'I': opt.cps_step = atof(optarg); break;
+        case 'X': opt.cps_max = atof(optarg); break;
+        case 'T': opt.step_secs = atof(optarg); break;
+        case 'L': opt.slo_ms = atof(optarg); break;
+        case 'F': opt.max_inflight = atoi(optarg); break;
+        case 'R': parse_src(optarg, argv[0]); break;
+        case 'V': opt.csv_path = optarg; break;
+        case 'P': opt.profile_path = optarg; break;
+        case 'W': opt.profile_at = atof(optarg); break;
+        case 'c': opt.echo_conns = atoi(optarg); break;
+        case 'D': opt.echo_depth = atoi(optarg); break;
+        case 'B': opt.echo_lib = 1; break;
+        case 'E': opt.echo_deadline_ms = atoi(optarg); break;
+        case 'r': opt.soak_rate = atof(optarg); break;
+        case 'i': opt.soak_interval = atof(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    int cps = strcmp(opt.mode, "cps") == 0;
+    int soak = strcmp(opt.mode, "soak") == 0;
+    int echo = strcmp(opt.mode, "echo") == 0;
+    if (optind != argc - 1 || opt.threads < 1 || opt.threads > BENCH_MAX_THREADS ||
+        (!cps && !soak && !echo && strcmp(opt.mode, "conn") != 0)) {
+        usage(argv[0]);
+    }
+    if (cps && (opt.cps_start <= 0 || opt.cps_step <= 0 || opt.step_secs <= 0 ||
+                opt.max_inflight < 1)) {
+        usage(argv[0]);
+    }
+    if (echo && (opt.echo_conns < 1 || opt.echo_depth < 1 || opt.echo_depth > 64)) {
+        usage(argv[0]);
+    }
+    if (soak && (opt.soak_rate <= 0 || opt.soak_interval <= 0)) usage(argv[0]);
+    parse_target(argv[optind], argv[0]);
+    if (cps) return bench_run_cps();
+    if (soak) return bench_run_soak();
+    if (echo) return bench_run_echo();
+
+    struct stat_kv before[BENCH_MAX_STATS], after[BENCH_MAX_STATS];
+    int nbefore = 0, nafter = 0;
+    if (opt.admin_port) nbefore = bench_fetch_stats(opt.admin_port, before, BENCH_MAX_STATS);
+
+    pthread_t tids[BENCH_MAX_THREADS];
+    struct thread_result results[BENCH_MAX_THREADS];
+    memset(results, 0, sizeof(results));
+    double t0 = now_sec();
+    for (int i = 0; i < opt.threads; i++) {
+        pthread_create(&tids[i], NULL, conn_thread, &results[i]);
+    }
+    struct timespec nap = {(time_t)opt.duration,
+                           (long)((opt.duration - (double)(time_t)opt.duration) * 1e9)};
+    nanosleep(&nap, NULL);
+    atomic_store(&stop, 1);
+    uint64_t ok = 0, errors = 0;
+    for (int i = 0; i < opt.threads; i++) {
+        pthread_join(tids[i], NULL);
+        ok += results[i].ok;
+        errors += results[i].errors;
+    }
+    double elapsed = now_sec() - t0;
+
+    printf("mode=conn threads=%d duration=%.1fs close=%s\n", opt.threads, elapsed,
+           opt.wait_server_close ? "server" : "client");
+    printf("connections  %llu ok, %llu errors, %.0f conn/s\n",
+           (unsigned long long)ok, (unsigned long long)errors, (double)ok / elapsed);
+
+    unsigned long long tw_server, tw_client;
+    bench_count_timewait(ntohs(opt.target.sin_port), &tw_server, &tw_client);
+    printf("time_wait    server-side %llu, client-side %llu (this host, now)\n",
+           tw_server, tw_client);
+
+    if (opt.admin_port && nbefore > 0) {
+        nafter = bench_fetch_stats(opt.admin_port, after, BENCH_MAX_STATS);
+        static const char *const keys[] = {"accepted", "close_active", "close_passive",
+                                           "close_abort", "close_wait_timeout",
+                                           "half_close"};
+        printf("server       ");
+        for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+            printf("%s=%llu ", keys[i],
+                   bench_stat_value(after, nafter, keys[i]) - bench_stat_value(before, nbefore, keys[i]));
+        }
+        printf("\n");
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+// ============================================================================
+// raw_metrics — read raw_server's shared-memory metrics page
+// ----------------------------------------------------------------------------
+// usage: raw_metrics [-w SECS] PATH
+//
+// Maps the page that raw_server publishes at metrics_path (see
+// src/metrics.h) read-only and prints every counter and gauge as
+// "name value", then one summary line per histogram. The server is never
+// contacted: no socket, no admin command, just loads from the mapping, so
+// this is safe to run in a tight loop next to a struggling server.
+//
+// With -w SECS it keeps the mapping and prints, every SECS seconds, the
+// counters that moved since the previous read as "name value +delta rate/s".
+//
+// Reads follow the seqlock protocol: retry while the sequence number is odd
+// (a publish is in progress) or changed across the copy.
+// ============================================================================
+#define _GNU_SOURCE
+#include "../src/metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+struct page_view {
+    const struct metrics_header *h;
+    const char *names;
+    _Atomic uint64_t *values;
+    size_t nvalues;
+};
+
+struct sample {
+    uint64_t seq, updated_ns, publishes;
+    uint64_t *values;
+};
+
+static int map_page(const char *path, struct page_view *p) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "raw_metrics: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) < 0 || (size_t)sb.st_size < sizeof(struct metrics_header)) {
+        fprintf(stderr, "raw_metrics: %s: too small for a metrics page\n", path);
+        close(fd);
+        return -1;
+    }
+    // PROT_READ only, but the writer updates the values in place, so this
+    // must be MAP_SHARED to see them.
+    void *map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "raw_metrics: mmap %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    const struct metrics_header *h = map;
+    if (memcmp(h->magic, METRICS_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != METRICS_VERSION) {
+        fprintf(stderr, "raw_metrics: %s: not a version %d metrics page (server starting?)\n",
+                path, METRICS_VERSION);
+        return -1;
+    }
+    p->h = h;
+    p->names = (const char *)map + h->header_size;
+    p->values = (_Atomic uint64_t *)((char *)map + h->values_off);
+    p->nvalues = h->ncounters + (size_t)h->nhists * h->nbuckets;
+    if (h->values_off + p->nvalues * sizeof(uint64_t) > (uint64_t)sb.st_size) {
+        fprintf(stderr, "raw_metrics: %s: truncated\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static void read_page(const struct page_view *p, struct sample *s) {
+    struct metrics_header *h = (struct metrics_header *)p->h;
+    for (;;) {
+        uint64_t s1 = atomic_load_explicit(&h->seq, memory_order_acquire);
+        if (s1 & 1) {
+            sched_yield();
+            continue;
+        }
+        for (size_t i = 0; i < p->nvalues; i++) {
+            s->values[i] = atomic_load_explicit(&p->values[i], memory_order_relaxed);
+        }
+        s->updated_ns = atomic_load_explicit(&h->updated_ns, memory_order_relaxed);
+        s->publishes = atomic_load_explicit(&h->publishes, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&h->seq, memory_order_relaxed) == s1) {
+            s->seq = s1;
+            return;
+        }
+    }
+}
+
+static const char *name_at(const struct page_view *p, size_t i) {
+    return p->names + i * METRICS_NAME_LEN;
+}
+
+static uint64_t now_realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void print_status(const struct page_view *p, const struct sample *s) {
+    double age = (double)(now_realtime_ns() - s->updated_ns) / 1e6;
+    printf("# raw_server pid %llu%s, %u workers, publish %llu, %.0f ms ago\n",
+           (unsigned long long)p->h->pid,
+           kill((pid_t)p->h->pid, 0) == 0 || errno == EPERM ? "" : " (not running)",
+           p->h->nworkers, (unsigned long long)s->publishes, age);
+}
+
+// Largest value a log2 bucket can hold (bucket 0 is exactly 0).
+static unsigned long long bucket_max(uint32_t b) {
+    return b == 0 ? 0 : (1ull << (b - 1)) * 2 - 1;
+}
+
+static unsigned long long percentile(const uint64_t *h, uint32_t nb, uint64_t n, double pct) {
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)n), seen = 0;
+    if (rank >= n) rank = n - 1;
+    for (uint32_t b = 0; b < nb; b++) {
+        seen += h[b];
+        if (seen > rank) return bucket_max(b);
+    }
+    return bucket_max(nb - 1);
+}
+
+static void print_all(const struct page_view *p, const struct sample *s) {
+    print_status(p, s);
+    uint32_t nc = p->h->ncounters, nb = p->h->nbuckets;
+    for (uint32_t i = 0; i < nc; i++) {
+        printf("%s %llu\n", name_at(p, i), (unsigned long long)s->values[i]);
+    }
+    for (uint32_t k = 0; k < p->h->nhists; k++) {
+        const uint64_t *h = s->values + nc + (size_t)k * nb;
+        uint64_t n = 0;
+        for (uint32_t b = 0; b < nb; b++) n += h[b];
+        printf("%s samples=%llu", name_at(p, nc + k), (unsigned long long)n);
+        if (n > 0) {
+            printf(" p50<=%llu p90<=%llu p99<=%llu", percentile(h, nb, n, 50),
+                   percentile(h, nb, n, 90), percentile(h, nb, n, 99));
+        }
+        printf("\n");
+    }
+}
+
+static void print_deltas(const struct page_view *p, const struct sample *prev,
+                         const struct sample *cur) {
+    print_status(p, cur);
+    double secs = (double)(cur->updated_ns - prev->updated_ns) / 1e9;
+    for (uint32_t i = 0; i < p->h->ncounters; i++) {
+        if (cur->values[i] == prev->values[i]) continue;
+        long long d = (long long)(cur->values[i] - prev->values[i]);
+        printf("%s %llu %+lld %.1f/s\n", name_at(p, i), (unsigned long long)cur->values[i], d,
+               secs > 0 ? (double)d / secs : 0.0);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    double watch = 0;
+    int c;
+    while ((c = getopt(argc, argv, "w:h")) != -1) {
+        if (c == 'w') {
+            watch = atof(optarg);
+        } else {
+            fprintf(stderr, "usage: %s [-w SECS] PATH\n", argv[0]);
+            return c == 'h' ? 0 : 2;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-w SECS] PATH\n", argv[0]);
+        return 2;
+    }
+
+    struct page_view p;
+    if (map_page(argv[optind], &p) < 0) return 1;
+    struct sample a = {.values = calloc(p.nvalues, sizeof(uint64_t))};
+    struct sample b = {.values = calloc(p.nvalues, sizeof(uint64_t))};
+    if (!a.values || !b.values) {
+        perror("calloc");
+        return 1;
+    }
+
+    read_page(&p, &a);
+    print_all(&p, &a);
+    if (watch <= 0) return 0;
+
+    struct timespec nap = {(time_t)watch, (long)((watch - (double)(time_t)watch) * 1e9)};
+    for (;;) {
+        nanosleep(&nap, NULL);
+        read_page(&p, &b);
+        print_deltas(&p, &a, &b);
+        struct sample t = a;
+        a = b;
+        b = t;
+    }
+}
@@ -0,0 +1,79 @@
+#!/bin/sh
+# ============================================================================
+# scale.sh — throughput vs. cores for raw_server
+# ----------------------------------------------------------------------------
+# usage: tools/scale.sh [MAX_WORKERS] [SECS] [OUT.csv]    (or `make scale`)
+#
+# For workers = 1..MAX_WORKERS:
+#   1) start raw_server with that many workers, pinned to CPUs 0..n-1
+#      (cpu_pin = 0), keepalive on, logging off;
+#   2) run raw_bench --mode echo pinned to the *other* CPUs (taskset), with
+#      two load threads per server worker so the client is never the limit;
+#   3) record msg/s, p99, server cores used and messages per CPU-second.
+#
+# Reading the curve:
+#   speedup     msg/s relative to 1 worker; ideal is n
+#   efficiency  speedup / n; where this drops, scaling breaks down
+#   msgs/cpu-s  falls when added cores go to contention (shared counters,
+#               accept queue, allocator) instead of echoing
+#
+# If the host has fewer than 2*n CPUs the client shares cores with the
+# server and the row is marked "shared" — numbers past that point measure
+# the box, not the server.
+set -eu
+
+MAX=${1:-$(( $(nproc) / 2 > 0 ? $(nproc) / 2 : 1 ))}
+SECS=${2:-10}
+CSV=${3:-scale.csv}
+PORT=${SCALE_PORT:-9500}
+ADMIN=${SCALE_ADMIN_PORT:-9501}
+CONNS=${SCALE_CONNS:-32}
+DEPTH=${SCALE_DEPTH:-4}
+NCPU=$(nproc)
+
+. "$(dirname "$0")/bench_lib.sh"
+
+echo "workers,msgs_per_s,speedup,efficiency,p50_ms,p99_ms,server_cores,msgs_per_cpu_s,client_cpus" > "$CSV"
+printf "%7s %10s %7s %6s %8s %8s %7s %11s  %s\n" \
+    workers msg/s speedup eff p50_ms p99_ms cores msgs/cpu-s client
+base=
+n=1
+while [ "$n" -le "$MAX" ]; do
+    cat > "$CONF" <<CONF
+listen = 127.0.0.1:$PORT
+admin_port = $ADMIN
+workers = $n
+cpu_pin = 0
+keepalive = 1
+log_messages = 0
+backlog = 4096
+CONF
+    "$BIN/raw_server" -c "$CONF" > /dev/null 2>&1 &
+    SERVER=$!
+    sleep 0.5
+
+    if [ $((2 * n)) -le "$NCPU" ]; then
+        client_cpus="$n-$((NCPU - 1))"
+    else
+        client_cpus="0-$((NCPU - 1))(shared)"
+    fi
+    taskset -c "${client_cpus%(shared)}" "$BIN/raw_bench" --mode echo -t $((2 * n)) \
+        --conns "$CONNS" --depth "$DEPTH" -d "$SECS" --admin "$ADMIN" \
+        "127.0.0.1:$PORT" > "$RESULT" || true
+    kill "$SERVER"
+    wait "$SERVER" 2>/dev/null || true
+    SERVER=
+
+    rate=$(field msgs_per_s)
+    [ -z "$rate" ] && { echo "workers=$n: no result" >&2; n=$((n + 1)); continue; }
+    [ -z "$base" ] && base=$rate
+    speedup=$(awk -v r="$rate" -v b="$base" 'BEGIN { printf "%.2f", (b > 0 ? r / b : 0) }')
+    eff=$(awk -v s="$speedup" -v n="$n" 'BEGIN { printf "%.2f", s / n }')
+    p50=$(field p50_ms); p99=$(field p99_ms)
+    cores=$(field server_cores); per_cpu=$(field msgs_per_cpu_s)
+    printf "%7d %10s %7s %6s %8s %8s %7s %11s  %s\n" \
+        "$n" "$rate" "$speedup" "$eff" "$p50" "$p99" "$cores" "$per_cpu" "$client_cpus"
+    echo "$n,$rate,$speedup,$eff,$p50,$p99,$cores,$per_cpu,$client_cpus" >> "$CSV"
+    n=$((n + 1))
+done
+echo "curve written to $CSV"
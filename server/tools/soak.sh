@@ -0,0 +1,42 @@
+#!/bin/sh
+# ============================================================================
+# soak.sh — start a fresh raw_server and soak it with raw_bench --mode soak
+# ----------------------------------------------------------------------------
+# usage: tools/soak.sh DURATION RATE WORKERS OUTDIR   (normally via `make soak`)
+#
+# The server runs from a generated config with several workers, the
+# rebalancer on and per-message logging off (hours of log lines would
+# dominate the run). Everything lands in OUTDIR:
+#   soak.csv      one row per sample (RSS, fds, pool, latency percentiles)
+#   server.log    server stdout/stderr
+# The exit status is raw_bench's: non-zero when drift was flagged.
+set -eu
+
+DURATION=${1:-1h}
+RATE=${2:-200}
+WORKERS=${3:-2}
+OUT=${4:-soak}
+PORT=${SOAK_PORT:-9400}
+ADMIN=${SOAK_ADMIN_PORT:-9401}
+
+BIN=$(dirname "$0")/../bin
+mkdir -p "$OUT"
+cat > "$OUT/raw_server.conf" <<CONF
+listen = 127.0.0.1:$PORT
+workers = $WORKERS
+admin_port = $ADMIN
+backlog = 1024
+recv_timeout_ms = 2000
+rebalance_ms = 1000
+log_messages = 0
+CONF
+
+"$BIN/raw_server" -c "$OUT/raw_server.conf" > "$OUT/server.log" 2>&1 &
+SERVER=$!
+trap 'kill $SERVER 2>/dev/null || true' EXIT INT TERM
+sleep 1
+
+status=0
+"$BIN/raw_bench" --mode soak -t 4 -d "$DURATION" --rate "$RATE" --interval "${SOAK_INTERVAL:-10}" \
+    --admin "$ADMIN" --csv "$OUT/soak.csv" "127.0.0.1:$PORT" || status=$?
+exit $status
@@ -0,0 +1,108 @@
+// ============================================================================
+// utf8_bench — cost of text_mode = utf8 against the byte-counting path
+// ----------------------------------------------------------------------------
+// usage: utf8_bench [MB]            (or `make utf8-bench`)
+//
+// Frames MB megabytes of newline-terminated lines (default 256) the way
+// process_input() does and reports GB/s for each way of checking a line:
+//
+//   memcpy   copying the line once: the floor for touching every byte
+//   bytes    text_mode = bytes: memchr() for the newline, length compare
+//   scalar   bytes + utf8_count_scalar()
+//   simd     bytes + utf8_count() with the implementation utf8_init() picked
+//
+// for ASCII and for mixed text (Latin-1 accents, CJK, emoji), at three line
+// lengths. utf8 mode is cheap enough when "simd" stays close to "bytes".
+// ============================================================================
+#define _GNU_SOURCE
+#include "../src/utf8.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Fills buf with lines of about 'line' bytes, each ending in '\n'.
+static void fill(char *buf, size_t size, size_t line, int mixed) {
+    static const char *const ascii[] = {"hello", " ", "cloud", "raw", "echo", "42"};
+    static const char *const multi[] = {"héllo", " ", "☁️", "日本語", "😀", "naïve", "x"};
+    const char *const *words = mixed ? multi : ascii;
+    size_t nwords = mixed ? 7 : 6;
+    size_t pos = 0, in_line = 0;
+    unsigned r = 12345;
+    while (pos + 16 < size) {
+        r = r * 1103515245u + 12345u;
+        const char *wd = words[(r >> 16) % nwords];
+        size_t wl = strlen(wd);
+        if (in_line + wl + 1 > line) {
+            buf[pos++] = '\n';
+            in_line = 0;
+            continue;
+        }
+        memcpy(buf + pos, wd, wl);
+        pos += wl;
+        in_line += wl;
+    }
+    memset(buf + pos, '\n', size - pos);
+}
+
+enum method { M_MEMCPY, M_BYTES, M_SCALAR, M_SIMD };
+
+static double run(const char *buf, size_t size, enum method m, size_t *sink) {
+    static char copy[1 << 16];
+    uint64_t t0 = now_ns();
+    size_t pos = 0, acc = 0;
+    while (pos < size) {
+        const char *start = buf + pos;
+        const char *nl = memchr(start, '\n', size - pos);
+        size_t len = (size_t)(nl - start), cps = 0;
+        switch (m) {
+        case M_MEMCPY: memcpy(copy, start, len); acc += (unsigned char)copy[0]; break;
+        case M_BYTES: acc += len <= 4096; break;
+        case M_SCALAR: acc += utf8_count_scalar(start, len, &cps) == 0 && cps <= 4096; break;
+        case M_SIMD: acc += utf8_count(start, len, &cps) == 0 && cps <= 4096; break;
+        }
+        pos += len + 1;
+    }
+    *sink += acc;
+    return (double)size / (double)(now_ns() - t0);     // bytes per ns = GB/s
+}
+
+int main(int argc, char **argv) {
+    size_t mb = argc > 1 ? (size_t)atol(argv[1]) : 256;
+    size_t size = mb << 20;
+    char *buf = malloc(size);
+    if (!buf || mb == 0) {
+        fprintf(stderr, "usage: %s [MB]\n", argv[0]);
+        return 1;
+    }
+    utf8_init();
+    printf("utf8 validator: %s, %zu MiB per run, GB/s (higher is better)\n", utf8_impl(), mb);
+    printf("%-6s %6s %8s %8s %8s %8s %10s\n", "text", "line", "memcpy", "bytes", "scalar",
+           "simd", "simd/bytes");
+
+    static const size_t lines[] = {20, 256, 4096};
+    size_t sink = 0;
+    for (int mixed = 0; mixed <= 1; mixed++) {
+        for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+            fill(buf, size, lines[i], mixed);
+            double r[4];
+            for (int m = M_MEMCPY; m <= M_SIMD; m++) {
+                run(buf, size, (enum method)m, &sink);     // warm-up
+                r[m] = run(buf, size, (enum method)m, &sink);
+            }
+            printf("%-6s %6zu %8.2f %8.2f %8.2f %8.2f %9.0f%%\n", mixed ? "mixed" : "ascii",
+                   lines[i], r[M_MEMCPY], r[M_BYTES], r[M_SCALAR], r[M_SIMD],
+                   100.0 * r[M_SIMD] / r[M_BYTES]);
+        }
+    }
+    free(buf);
+    return sink == 0;       // keeps the loops from being optimized away
+}